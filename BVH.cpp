@@ -0,0 +1,228 @@
+//
+//  Bounding volume hierarchy over axis-aligned boxes
+//
+#include "BVH.h"
+
+#include <algorithm>
+
+Frustum Frustum::fromMatrix(const QMatrix4x4& M)
+{
+    // Gribb/Hartmann: -w <= x,y,z <= w, i.e. row 4 +- row k of M
+    Frustum f;
+    const QVector4D w = M.row(3);
+    for (int k = 0; k < 3; k++) {
+        f.planes[2*k  ] = w + M.row(k);
+        f.planes[2*k+1] = w - M.row(k);
+    }
+    return f;
+}
+
+int Frustum::classify(const QVector3D& bbMin, const QVector3D& bbMax) const
+{
+    int result = 1;
+    for (const QVector4D& p: planes) {
+        // corners farthest in resp. against the direction of the plane's normal
+        QVector3D inner, outer;
+        for (int k = 0; k < 3; k++) {
+            inner[k] = p[k] >= 0.0f ? bbMax[k] : bbMin[k];
+            outer[k] = p[k] >= 0.0f ? bbMin[k] : bbMax[k];
+        }
+        if (QVector3D::dotProduct(p.toVector3D(), inner) + p.w() < 0.0f) return -1;
+        if (QVector3D::dotProduct(p.toVector3D(), outer) + p.w() < 0.0f) result = 0;
+    }
+    return result;
+}
+
+PickRay PickRay::fromMatrix(const QMatrix4x4& M, float x, float y, float halfWidth)
+{
+    // the cone's axis and its side in x, both from the near (z = -1) to the far plane (z = 1)
+    const QMatrix4x4 inv = M.inverted();
+    const QVector3D  n0  = inv.map(QVector3D(x,             y, -1.0f)), f0 = inv.map(QVector3D(x,             y, 1.0f));
+    const QVector3D  n1  = inv.map(QVector3D(x + halfWidth, y, -1.0f)), f1 = inv.map(QVector3D(x + halfWidth, y, 1.0f));
+    const float      len = (f0 - n0).length();
+
+    PickRay ray;
+    ray.origin = n0;
+    ray.dir    = (f0 - n0).normalized();
+
+    // distances of the side to the axis at both planes, the radius grows linearly in between
+    const auto  across = [&ray](const QVector3D& v) { return (v - QVector3D::dotProduct(v, ray.dir) * ray.dir).length(); };
+    const float width  = across(f1 - f0);
+    ray.radius = across(n1 - n0);
+    ray.spread = len > 0.0f ? std::max(width - ray.radius, 0.0f) / len : 0.0f;
+    return ray;
+}
+
+float PickRay::farthest(const QVector3D& bbMin, const QVector3D& bbMax) const
+{
+    float t = 0.0f;
+    for (int k = 0; k < 3; k++) t += ((dir[k] >= 0.0f ? bbMax[k] : bbMin[k]) - origin[k]) * dir[k];
+    return t;
+}
+
+bool PickRay::clip(const QVector3D& bbMin, const QVector3D& bbMax, float margin, float& t0, float& t1) const
+{
+    // slabs of the grown box
+    for (int k = 0; k < 3; k++) {
+        const float lo = bbMin[k] - margin, hi = bbMax[k] + margin;
+        if (dir[k] == 0.0f) {
+            if (origin[k] < lo || origin[k] > hi) return false;
+            continue;
+        }
+        float a = (lo - origin[k]) / dir[k], b = (hi - origin[k]) / dir[k];
+        if (a > b) std::swap(a, b);
+        t0 = std::max(t0, a);
+        t1 = std::min(t1, b);
+        if (t0 > t1) return false;
+    }
+    return true;
+}
+
+namespace {
+bool overlaps(const QVector3D& aMin, const QVector3D& aMax, const QVector3D& bMin, const QVector3D& bMax)
+{
+    for (int k = 0; k < 3; k++)
+        if (aMax[k] < bMin[k] || bMax[k] < aMin[k]) return false;
+    return true;
+}
+}
+
+void BVH::clear()
+{
+    nodes.clear();
+    items.clear();
+}
+
+void BVH::build(std::vector<BVHItem> _items, int leafSize)
+{
+    items = std::move(_items);
+    nodes.clear();
+    if (items.empty()) return;
+    nodes.reserve(2 * items.size());
+    build(0, quint32(items.size()), std::max(leafSize, 1));
+}
+
+// subtree over items [first,last), returns its node index
+quint32 BVH::build(quint32 first, quint32 last, int leafSize)
+{
+    const quint32 index = quint32(nodes.size());
+    nodes.push_back({ items[first].bbMin, items[first].bbMax, first, last - first });
+
+    QVector3D cMin = items[first].bbMin + items[first].bbMax, cMax = cMin;    // of the doubled centers
+    for (quint32 i = first; i < last; i++) {
+        const QVector3D c = items[i].bbMin + items[i].bbMax;
+        for (int k = 0; k < 3; k++) {
+            nodes[index].bbMin[k] = std::min(nodes[index].bbMin[k], items[i].bbMin[k]);
+            nodes[index].bbMax[k] = std::max(nodes[index].bbMax[k], items[i].bbMax[k]);
+            cMin[k] = std::min(cMin[k], c[k]);
+            cMax[k] = std::max(cMax[k], c[k]);
+        }
+    }
+    if (last - first <= quint32(leafSize)) return index;
+
+    // median of the centers along the axis of their largest extent
+    const QVector3D e    = cMax - cMin;
+    const int       axis = (e.x() >= e.y() && e.x() >= e.z()) ? 0 : (e.y() >= e.z() ? 1 : 2);
+    const quint32   mid  = first + (last - first) / 2;
+    std::nth_element(items.begin() + first, items.begin() + mid, items.begin() + last, [axis](const BVHItem& a, const BVHItem& b) {
+        return a.bbMin[axis] + a.bbMax[axis] < b.bbMin[axis] + b.bbMax[axis];
+    });
+
+    build(first, mid, leafSize);
+    const quint32 right = build(mid, last, leafSize);
+    nodes[index].first = right;
+    nodes[index].count = 0;
+    return index;
+}
+
+bool BVH::bounds(QVector3D& bbMin, QVector3D& bbMax) const
+{
+    if (nodes.empty()) return false;
+    bbMin = nodes[0].bbMin;
+    bbMax = nodes[0].bbMax;
+    return true;
+}
+
+// the items of a subtree are contiguous: from its leftmost to its rightmost leaf
+void BVH::appendSubtree(quint32 node, std::vector<quint32>& ids) const
+{
+    quint32 first = node, last = node;
+    while (nodes[first].count == 0) first++;
+    while (nodes[last ].count == 0) last = nodes[last].first;
+    for (quint32 i = nodes[first].first; i < nodes[last].first + nodes[last].count; i++) ids.push_back(items[i].id);
+}
+
+void BVH::overlapping(const QVector3D& bbMin, const QVector3D& bbMax, std::vector<quint32>& ids) const
+{
+    if (nodes.empty()) return;
+    std::vector<quint32> stack = { 0 };
+    while (!stack.empty()) {
+        const quint32 i = stack.back();
+        const Node&   n = nodes[i];
+        stack.pop_back();
+        if (!overlaps(n.bbMin, n.bbMax, bbMin, bbMax)) continue;
+        if (n.count == 0) {
+            stack.push_back(n.first);
+            stack.push_back(i + 1);
+            continue;
+        }
+        for (quint32 k = n.first; k < n.first + n.count; k++)
+            if (overlaps(items[k].bbMin, items[k].bbMax, bbMin, bbMax)) ids.push_back(items[k].id);
+    }
+}
+
+void BVH::visible(const Frustum& frustum, std::vector<quint32>& ids) const
+{
+    if (nodes.empty()) return;
+    std::vector<quint32> stack = { 0 };
+    while (!stack.empty()) {
+        const quint32 i = stack.back();
+        const Node&   n = nodes[i];
+        stack.pop_back();
+        const int c = frustum.classify(n.bbMin, n.bbMax);
+        if (c < 0) continue;
+        if (c > 0) {
+            appendSubtree(i, ids);
+            continue;
+        }
+        if (n.count == 0) {
+            stack.push_back(n.first);
+            stack.push_back(i + 1);
+            continue;
+        }
+        for (quint32 k = n.first; k < n.first + n.count; k++)
+            if (frustum.classify(items[k].bbMin, items[k].bbMax) >= 0) ids.push_back(items[k].id);
+    }
+}
+
+void BVH::alongRay(const PickRay& ray, float tMax, std::vector<std::pair<float, quint32>>& hits) const
+{
+    if (nodes.empty()) return;
+    const float  margin = ray.width(tMax);
+    const size_t first  = hits.size();
+    std::vector<quint32> stack = { 0 };
+    while (!stack.empty()) {
+        const quint32 i = stack.back();
+        const Node&   n = nodes[i];
+        stack.pop_back();
+        float t0 = 0.0f, t1 = tMax;
+        if (!ray.clip(n.bbMin, n.bbMax, margin, t0, t1)) continue;
+        if (n.count == 0) {
+            stack.push_back(n.first);
+            stack.push_back(i + 1);
+            continue;
+        }
+        for (quint32 k = n.first; k < n.first + n.count; k++) {
+            t0 = 0.0f; t1 = tMax;
+            if (ray.clip(items[k].bbMin, items[k].bbMax, margin, t0, t1)) hits.emplace_back(t0, items[k].id);
+        }
+    }
+    std::sort(hits.begin() + first, hits.end());
+}
+
+MemoryUsage BVH::memoryUsage() const
+{
+    MemoryUsage usage = containerUsage(nodes);
+    usage += containerUsage(items);
+    return usage;
+}
@@ -0,0 +1,98 @@
+//
+//  Bounding volume hierarchy over axis-aligned boxes
+//
+//  The scene keeps one over the world bounds of its visible objects (e.g. dozens of point
+//  cloud tiles, each with its own kd-tree), so queries for a region or the view frustum
+//  visit only the objects they can reach. The tree is built top-down by median splits of
+//  the box centers along the longest axis and stored flat in depth-first order: the left
+//  child of an inner node directly follows it, so traversals walk an array.
+//
+//  Picking casts a cone (a ray widened by the size of a point on screen) through it: the
+//  objects are returned front to back by where the cone enters their boxes, so a search can
+//  stop at the first box behind the nearest hit found so far.
+//
+#pragma once
+
+#include "MemoryTracker.h"
+
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+
+#include <utility>
+#include <vector>
+
+// box of an item, id is returned by the queries
+struct BVHItem {
+    QVector3D bbMin, bbMax;
+    quint32   id;
+};
+
+// six planes (a,b,c,d) of a view volume, points with a*x+b*y+c*z+d >= 0 are inside
+struct Frustum {
+    QVector4D planes[6];
+
+    // view volume of the clip space of M, i.e. the points mapped into [-1,1]^3
+    static Frustum fromMatrix(const QMatrix4x4& M);
+
+    // -1: box outside, 0: intersecting (conservative), 1: box inside
+    int classify(const QVector3D& bbMin, const QVector3D& bbMax) const;
+};
+
+// cone around the ray origin + t*dir (dir normalized) with radius width(t) at t, e.g. the
+// pixels around the mouse position unprojected into the world
+struct PickRay {
+    QVector3D origin, dir;
+    float     radius = 0.0f;                // at t = 0
+    float     spread = 0.0f;                // growth of the radius per unit of t
+
+    // cone of M^-1 through the point (x,y) of [-1,1]^2 from the near to the far plane of the
+    // clip space of M, with the radius of halfWidth in x
+    static PickRay fromMatrix(const QMatrix4x4& M, float x, float y, float halfWidth);
+
+    float width(float t) const { return radius + spread * t; }
+
+    // largest t of a point in the box, i.e. the far end of a search through it
+    float farthest(const QVector3D& bbMin, const QVector3D& bbMax) const;
+
+    // clips [t0,t1] to the parameters where the ray is inside the box grown by margin,
+    // returns false if nothing remains
+    bool clip(const QVector3D& bbMin, const QVector3D& bbMax, float margin, float& t0, float& t1) const;
+};
+
+class BVH
+{
+private:
+    struct Node {
+        QVector3D bbMin, bbMax;
+        quint32   first;                    // leaf: first item, inner: index of the right child
+        quint32   count;                    // leaf: number of items, inner: 0
+    };
+
+    std::vector<Node>    nodes;             // nodes[0] is the root, empty if there are no items
+    std::vector<BVHItem> items;             // in leaf order
+
+    quint32 build(quint32 first, quint32 last, int leafSize);
+    void    appendSubtree(quint32 node, std::vector<quint32>& ids) const;
+
+public:
+    // rebuilds the hierarchy over items, with at most leafSize items per leaf
+    void build(std::vector<BVHItem> items, int leafSize = 2);
+    void clear();
+
+    bool isEmpty() const { return items.empty(); }
+    bool bounds(QVector3D& bbMin, QVector3D& bbMax) const;
+
+    // appends the ids of the items whose boxes overlap [bbMin,bbMax] (touching counts)
+    void overlapping(const QVector3D& bbMin, const QVector3D& bbMax, std::vector<quint32>& ids) const;
+
+    // appends the ids of the items whose boxes are at least partially inside the frustum;
+    // subtrees completely inside are taken without testing their items
+    void visible(const Frustum& frustum, std::vector<quint32>& ids) const;
+
+    // appends (entry t, id) of the items whose boxes the cone enters within [0,tMax] (its
+    // radius at tMax taken as margin), sorted by entry t
+    void alongRay(const PickRay& ray, float tMax, std::vector<std::pair<float, quint32>>& hits) const;
+
+    MemoryUsage memoryUsage() const;
+};
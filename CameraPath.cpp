@@ -0,0 +1,139 @@
+//
+//  Camera paths for offscreen rendering
+//
+#include "CameraPath.h"
+
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+namespace {
+constexpr float ELEVATION = 25.0f;          // of overview and turntable, in degrees
+constexpr float AZIMUTH   = -60.0f;         // of the overview, in degrees
+constexpr int   TURN_KEYS = 36;             // keyframes of a turntable
+
+// uniform Catmull-Rom spline through p1 (u=0) and p2 (u=1)
+QVector3D catmullRom(const QVector3D& p0, const QVector3D& p1, const QVector3D& p2, const QVector3D& p3, float u)
+{
+    const float u2 = u*u, u3 = u2*u;
+    return 0.5f * (2.0f*p1 + (p2 - p0)*u + (2.0f*p0 - 5.0f*p1 + 4.0f*p2 - p3)*u2 + (3.0f*p1 - p0 - 3.0f*p2 + p3)*u3);
+}
+
+// eye on the sphere of radius distance around center, angles in degrees
+QVector3D orbit(const QVector3D& center, float distance, float azimuth, float elevation)
+{
+    const float a = qDegreesToRadians(azimuth), e = qDegreesToRadians(elevation);
+    return center + distance * QVector3D(cosf(e)*cosf(a), cosf(e)*sinf(a), sinf(e));
+}
+
+// center, radius and viewing distance of a box filling the field of view
+void frame(const QVector3D& bbMin, const QVector3D& bbMax, float fov, QVector3D& center, float& distance)
+{
+    center         = 0.5f * (bbMin + bbMax);
+    const float r  = std::max(0.5f * (bbMax - bbMin).length(), 1e-6f);
+    distance       = r / sinf(0.5f * qDegreesToRadians(fov));
+}
+}
+
+QMatrix4x4 CameraPose::projection(float aspect, const QVector3D& c, float r) const
+{
+    const float d    = (eye - c).length();
+    const float far  = d + r;
+    const float near = std::max(d - r, 1e-3f * far);
+    QMatrix4x4 P;
+    P.perspective(fov, aspect, near, far);
+    return P;
+}
+
+void CameraPath::addKey(float time, const CameraPose& pose)
+{
+    auto it = std::lower_bound(keys.begin(), keys.end(), time, [](const Key& k, float t) { return k.time < t; });
+    if (it != keys.end() && it->time == time) it->pose = pose;
+    else                                      keys.insert(it, Key{ time, pose });
+}
+
+CameraPose CameraPath::at(float t) const
+{
+    if (t <= keys.first().time) return keys.first().pose;
+    if (t >= keys.last ().time) return keys.last ().pose;
+
+    // segment [i,i+1] containing t, its neighbours clamped at the ends
+    const qsizetype n = keys.size();
+    const qsizetype i = std::upper_bound(keys.begin(), keys.end(), t, [](float t, const Key& k) { return t < k.time; }) - keys.begin() - 1;
+    const Key&  k0 = keys[std::max<qsizetype>(i-1, 0)];
+    const Key&  k1 = keys[i];
+    const Key&  k2 = keys[i+1];
+    const Key&  k3 = keys[std::min<qsizetype>(i+2, n-1)];
+    const float u  = (t - k1.time) / (k2.time - k1.time);
+
+    CameraPose p;
+    p.eye    = catmullRom(k0.pose.eye,    k1.pose.eye,    k2.pose.eye,    k3.pose.eye,    u);
+    p.center = catmullRom(k0.pose.center, k1.pose.center, k2.pose.center, k3.pose.center, u);
+    p.up     = ((1.0f-u)*k1.pose.up + u*k2.pose.up).normalized();
+    p.fov    = (1.0f-u)*k1.pose.fov + u*k2.pose.fov;
+    return p;
+}
+
+CameraPose CameraPath::overview(const QVector3D& bbMin, const QVector3D& bbMax, float fov)
+{
+    CameraPose p;
+    float      distance;
+    frame(bbMin, bbMax, fov, p.center, distance);
+    p.eye = orbit(p.center, distance, AZIMUTH, ELEVATION);
+    p.fov = fov;
+    return p;
+}
+
+CameraPath CameraPath::turntable(const QVector3D& bbMin, const QVector3D& bbMax, float seconds, float fov)
+{
+    CameraPose p;
+    float      distance;
+    frame(bbMin, bbMax, fov, p.center, distance);
+    p.fov = fov;
+
+    // dense keys, so the spline stays within 0.1% of the circle
+    CameraPath path;
+    for (int i = 0; i <= TURN_KEYS; i++) {
+        p.eye = orbit(p.center, distance, AZIMUTH + 360.0f * float(i) / TURN_KEYS, ELEVATION);
+        path.addKey(seconds * float(i) / TURN_KEYS, p);
+    }
+    return path;
+}
+
+CameraPath CameraPath::load(const QString& filePath)
+{
+    ifstream is(filePath.toStdString());
+    if (!is) throw runtime_error("cannot read " + filePath.toStdString());
+
+    CameraPath path;
+    string     line;
+    for (int number = 1; getline(is, line); number++) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == string::npos) continue;
+
+        stringstream ss(line);
+        float        t;
+        CameraPose   p;
+        ss >> t >> p.eye[0] >> p.eye[1] >> p.eye[2] >> p.center[0] >> p.center[1] >> p.center[2];
+        if (!ss) throw runtime_error(filePath.toStdString() + ":" + to_string(number) + ": expected time, eye and center");
+
+        // optional field of view and up vector
+        vector<float> rest;
+        for (float v; ss >> v; ) rest.push_back(v);
+        if (rest.size() >= 1) p.fov = rest[0];
+        if (rest.size() == 4) p.up  = QVector3D(rest[1], rest[2], rest[3]);
+        if (!ss.eof() || (rest.size() != 0 && rest.size() != 1 && rest.size() != 4) ||
+            p.fov <= 0.0f || p.fov >= 180.0f || p.up.isNull())
+            throw runtime_error(filePath.toStdString() + ":" + to_string(number) + ": malformed keyframe");
+        path.addKey(t, p);
+    }
+    if (path.isEmpty()) throw runtime_error(filePath.toStdString() + ": no keyframes");
+    return path;
+}
@@ -0,0 +1,58 @@
+//
+//  Camera paths for offscreen rendering
+//
+//  A path interpolates keyframes (time, eye, center, up, field of view): eye and center
+//  along Catmull-Rom splines, the up vector and the field of view linearly. Paths are
+//  built in code (addKey, turntable) or loaded from a script with one keyframe per line
+//
+//      # time  eye.x eye.y eye.z  center.x center.y center.z  [fov [up.x up.y up.z]]
+//      0.0     10 0 3             0 0 0                        45
+//      2.5     0 10 3             0 0 0
+//
+//  All positions are world coordinates, times are in seconds.
+//
+#pragma once
+
+#include <QMatrix4x4>
+#include <QString>
+#include <QVector>
+#include <QVector3D>
+
+struct CameraPose {
+    QVector3D eye;
+    QVector3D center;
+    QVector3D up  = QVector3D(0,0,1);
+    float     fov = 45.0f;                  // vertical field of view in degrees
+
+    // perspective projection with near and far plane enclosing the sphere (c,r)
+    QMatrix4x4 projection(float aspect, const QVector3D& c, float r) const;
+};
+
+class CameraPath
+{
+private:
+    struct Key {
+        float      time;
+        CameraPose pose;
+    };
+    QVector<Key> keys;                      // sorted by time
+
+public:
+    // inserts a keyframe, replacing one at the same time
+    void addKey(float time, const CameraPose& pose);
+
+    bool  isEmpty () const { return keys.isEmpty(); }
+    float duration() const { return keys.isEmpty() ? 0.0f : keys.last().time - keys.first().time; }
+
+    // pose at time t (clamped to the keyframes), the path must not be empty
+    CameraPose at(float t) const;
+
+    // pose that shows the whole box from the front/above, e.g. for thumbnails
+    static CameraPose overview(const QVector3D& bbMin, const QVector3D& bbMax, float fov = 45.0f);
+
+    // one full turn around the box's vertical axis (z) in the given time, starting at the overview pose
+    static CameraPath turntable(const QVector3D& bbMin, const QVector3D& bbMax, float seconds, float fov = 45.0f);
+
+    // Reads a script (see above). Throws runtime_error for unreadable files and malformed lines.
+    static CameraPath load(const QString& filePath);
+};
@@ -0,0 +1,129 @@
+//
+//  Euclidean cluster extraction
+//
+#include "EuclideanClustering.h"
+#include "Parallel.h"
+
+#include <atomic>
+#include <cfloat>
+#include <memory>
+
+using namespace std;
+
+namespace {
+
+// Lock-free union-find: roots are linked only by CAS on their own parent entry and
+// always from the larger to the smaller index, so no cycles can arise and the root
+// of each set is its smallest element. find uses path halving.
+class ConcurrentUnionFind
+{
+    unique_ptr<atomic<int>[]> parent;
+
+public:
+    explicit ConcurrentUnionFind(qsizetype n): parent(new atomic<int>[n]) {
+        parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+            for (qsizetype i = b; i < e; ++i) parent[i].store(int(i), memory_order_relaxed);
+        });
+    }
+
+    int find(int x) const {
+        for (;;) {
+            int p = parent[x].load(memory_order_relaxed);
+            if (p == x) return x;
+            int g = parent[p].load(memory_order_relaxed);
+            if (g != p) parent[x].compare_exchange_weak(p, g, memory_order_relaxed);
+            x = g;
+        }
+    }
+
+    void unite(int a, int b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return;
+            if (a < b) swap(a, b);
+            int expected = a;
+            if (parent[a].compare_exchange_strong(expected, b, memory_order_acq_rel)) return;
+        }
+    }
+};
+
+} // namespace
+
+Hexahedron* Cluster::toHexahedron() const
+{
+    QVector3D d = bbMax - bbMin;
+    return new Hexahedron(QVector4D(bbMin, 1.0f), d.x(), d.y(), d.z());
+}
+
+PointCloud* Cluster::toPointCloud(const PointCloud& cloud) const
+{
+    PointCloud* result = new PointCloud;
+    result->setPointSize(cloud.getPointSize());
+    result->assignSubset(cloud, indices);
+    return result;
+}
+
+vector<Cluster> euclideanClusters(const PointCloud&    cloud,
+                                  const KdNode*        kdRoot,
+                                  const ClusterParams& params,
+                                  QVector<int>*        labels)
+{
+    const qsizetype n = cloud.size();
+    vector<Cluster> clusters;
+    if (labels) labels->fill(-1, n);
+    if (n == 0 || !kdRoot) return clusters;
+
+    // 1) link each point with its neighbours, every edge is needed only once (j > i)
+    ConcurrentUnionFind sets(n);
+    parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+        vector<int> nn;
+        for (qsizetype i = b; i < e; ++i) {
+            radiusSearch(kdRoot, cloud[i], params.tolerance, nn);
+            for (int j: nn)
+                if (j > i) sets.unite(int(i), j);
+        }
+    }, 1024);
+
+    // 2) root of each point, roots are the smallest indices of their components
+    QVector<int> root(n);
+    parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i) root[i] = sets.find(int(i));
+    });
+
+    // 3) component sizes and cluster ids of the components within the size limits
+    QVector<int> size(n, 0);
+    for (qsizetype i = 0; i < n; ++i) ++size[root[i]];
+
+    QVector<int> id(n, -1);
+    for (qsizetype i = 0; i < n; ++i)
+        if (root[i] == i && size[i] >= params.minSize && size[i] <= params.maxSize) {
+            id[i] = int(clusters.size());
+            clusters.emplace_back();
+            clusters.back().indices.reserve(size[i]);
+        }
+
+    // 4) distribute the points (ascending) and compute the AABBs in parallel
+    for (qsizetype i = 0; i < n; ++i)
+        if (int c = id[root[i]]; c >= 0) clusters[c].indices.append(int(i));
+
+    parallelFor(qsizetype(clusters.size()), [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype c = b; c < e; ++c) {
+            Cluster& cl = clusters[c];
+            cl.bbMin = QVector3D( FLT_MAX, FLT_MAX, FLT_MAX);
+            cl.bbMax = QVector3D(-FLT_MAX,-FLT_MAX,-FLT_MAX);
+            for (int i: cl.indices)
+                for (int k = 0; k < 3; ++k) {
+                    cl.bbMin[k] = min(cl.bbMin[k], cloud[i][k]);
+                    cl.bbMax[k] = max(cl.bbMax[k], cloud[i][k]);
+                }
+        }
+    }, 16);
+
+    if (labels)
+        parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+            for (qsizetype i = b; i < e; ++i) (*labels)[i] = id[root[i]];
+        });
+
+    return clusters;
+}
@@ -0,0 +1,38 @@
+//
+//  Euclidean cluster extraction
+//
+//  Clusters are the connected components of the graph that links all points closer
+//  than a distance tolerance. The neighbourhoods come from the kd-tree's radius search,
+//  the components are merged by a lock-free union-find, so all points are processed
+//  in parallel.
+//
+#pragma once
+
+#include <climits>
+#include <vector>
+
+#include "PointCloud.h"
+#include "KdTree.h"
+#include "Hexahedron.h"
+
+struct ClusterParams {
+    float tolerance = 0.01f;        // max. distance of neighbouring points within a cluster
+    int   minSize   = 100;          // smaller clusters are discarded
+    int   maxSize   = INT_MAX;      // larger clusters are discarded
+};
+
+struct Cluster {
+    QVector<int> indices;           // indices of the cluster's points in the point cloud, ascending
+    QVector3D    bbMin, bbMax;      // AABB of the cluster
+
+    Hexahedron* toHexahedron() const;                       // new scene object for the AABB
+    PointCloud* toPointCloud(const PointCloud& cloud) const;// new point cloud of the cluster's points
+};
+
+// Extracts the clusters of cloud, ordered by their smallest point index.
+// kdRoot has to be built over cloud. If labels is given, it receives the cluster
+// of each point, or -1 for points of discarded clusters.
+std::vector<Cluster> euclideanClusters(const PointCloud&    cloud,
+                                       const KdNode*        kdRoot,
+                                       const ClusterParams& params,
+                                       QVector<int>*        labels = nullptr);
@@ -0,0 +1,173 @@
+//
+//  Eye-dome lighting of the rendered scene
+//
+#include "EyeDomeLighting.h"
+#include "Profiler.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QVector2D>
+
+namespace {
+// the full-screen quad is given in clip coordinates
+const char* edlVertexShader = R"(
+#version 120
+void main()
+{
+    gl_Position = gl_Vertex;
+}
+)";
+
+// darkens by the log depth differences to 8 neighbors on a circle; the background lies on the far plane
+const char* edlFragmentShader = R"(
+#version 120
+uniform sampler2D colorTexture;
+uniform sampler2D depthTexture;
+uniform mat4      inverseProjection;
+uniform vec2      texel;                    // size of a pixel in texture coordinates
+uniform float     radius;
+uniform float     strength;
+float logDepth(vec2 uv)
+{
+    vec4 e = inverseProjection * vec4(0.0, 0.0, 2.0*texture2D(depthTexture, uv).r - 1.0, 1.0);
+    return log2(max(abs(e.z/e.w), 1e-6));
+}
+void main()
+{
+    vec2  uv    = gl_FragCoord.xy * texel;
+    float depth = logDepth(uv);
+    float sum   = 0.0;
+    for (int i = 0; i < 8; i++) {
+        float a = 0.7853982*float(i);
+        sum += max(0.0, depth - logDepth(uv + radius*texel*vec2(cos(a), sin(a))));
+    }
+    gl_FragColor = vec4(exp(-300.0*strength*sum/8.0) * texture2D(colorTexture, uv).rgb, 1.0);
+    gl_FragDepth = texture2D(depthTexture, uv).r;
+}
+)";
+}
+
+bool EyeDomeLighting::init()
+{
+    if (supported >= 0) return supported > 0;
+    supported = 0;
+
+    const QOpenGLContext* context = QOpenGLContext::currentContext();
+    if (!context) return false;
+    if (context->isOpenGLES() || context->format().version() < qMakePair(3,0)) return false;
+
+    program = new QOpenGLShaderProgram();
+    if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex,   edlVertexShader  ) ||
+        !program->addShaderFromSourceCode(QOpenGLShader::Fragment, edlFragmentShader) ||
+        !program->link()) {
+        qWarning() << "EyeDomeLighting: disabled," << program->log();
+        delete program;
+        program = nullptr;
+        return false;
+    }
+
+    supported = 1;
+    return true;
+}
+
+// nearest filtering, the pass reads single pixels
+bool EyeDomeLighting::createTargets()
+{
+    QOpenGLExtraFunctions* gl = QOpenGLContext::currentContext()->extraFunctions();
+    const auto texture = [gl, this](unsigned& id, GLint format, GLenum layout, GLenum type) {
+        gl->glGenTextures(1, &id);
+        gl->glBindTexture(GL_TEXTURE_2D, id);
+        gl->glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, layout, type, nullptr);
+        gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+    };
+    texture(colorTexture, GL_RGBA8,             GL_RGBA,            GL_UNSIGNED_BYTE);
+    texture(depthTexture, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT);
+    gl->glBindTexture(GL_TEXTURE_2D, 0);
+
+    gl->glGenFramebuffers(1, &fbo);
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,  GL_TEXTURE_2D, depthTexture, 0);
+    const bool complete = gl->glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous));
+    return complete;
+}
+
+void EyeDomeLighting::releaseTargets()
+{
+    QOpenGLExtraFunctions* gl = QOpenGLContext::currentContext()->extraFunctions();
+    if (fbo)          gl->glDeleteFramebuffers(1, &fbo);
+    if (colorTexture) gl->glDeleteTextures    (1, &colorTexture);
+    if (depthTexture) gl->glDeleteTextures    (1, &depthTexture);
+    fbo = colorTexture = depthTexture = 0;
+    width = height = 0;
+}
+
+bool EyeDomeLighting::begin(int _width, int _height)
+{
+    if (!init() || _width <= 0 || _height <= 0) return false;
+
+    QOpenGLExtraFunctions* gl = QOpenGLContext::currentContext()->extraFunctions();
+    gl->glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previous);
+    if (_width != width || _height != height) {
+        releaseTargets();
+        width  = _width;
+        height = _height;
+        if (!createTargets()) {
+            qWarning() << "EyeDomeLighting: disabled, incomplete framebuffer";
+            releaseTargets();
+            supported = 0;
+            return false;
+        }
+    }
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    gl->glViewport(0, 0, width, height);
+    return true;
+}
+
+void EyeDomeLighting::end(const QMatrix4x4& projection)
+{
+    PROFILE_SCOPE("eye-dome lighting");
+
+    QOpenGLExtraFunctions* gl = QOpenGLContext::currentContext()->extraFunctions();
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, GLuint(previous));
+    gl->glActiveTexture(GL_TEXTURE1);
+    gl->glBindTexture  (GL_TEXTURE_2D, depthTexture);
+    gl->glActiveTexture(GL_TEXTURE0);
+    gl->glBindTexture  (GL_TEXTURE_2D, colorTexture);
+
+    program->bind();
+    program->setUniformValue("colorTexture",      0);
+    program->setUniformValue("depthTexture",      1);
+    program->setUniformValue("inverseProjection", projection.inverted());
+    program->setUniformValue("texel",             QVector2D(1.0f / float(width), 1.0f / float(height)));
+    program->setUniformValue("radius",            radius);
+    program->setUniformValue("strength",          strength);
+
+    // every pixel is replaced, including its depth (written only while the depth test is on)
+    glDisable(GL_BLEND);
+    glEnable (GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glBegin(GL_QUADS);
+    glVertex2f(-1.0f, -1.0f);
+    glVertex2f( 1.0f, -1.0f);
+    glVertex2f( 1.0f,  1.0f);
+    glVertex2f(-1.0f,  1.0f);
+    glEnd();
+    glDepthFunc(GL_LESS);
+    glEnable(GL_BLEND);
+
+    program->release();
+    gl->glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void EyeDomeLighting::releaseGL()
+{
+    if (fbo || colorTexture || depthTexture) releaseTargets();
+    delete program; program = nullptr;
+    supported = -1;
+}
@@ -0,0 +1,54 @@
+//
+//  Eye-dome lighting of the rendered scene
+//
+//  Dense point clouds without normals drawn in flat colors look like noise. Eye-dome lighting
+//  shades them in screen space from depth alone: the scene is drawn into a framebuffer with a
+//  color and a depth texture, then a full-screen pass darkens each pixel by how much closer to
+//  the eye (in log depth) its neighbors a few pixels away are. This outlines silhouettes and
+//  brings out the shape of surfaces at the cost of one pass over the pixels, independent of
+//  the number of points, so sparse (e.g. downsampled) clouds stay legible.
+//
+//  Needs desktop GL 3.0 (framebuffers with depth textures, in a compatibility context as the
+//  rest is immediate mode). Without it, begin returns false and the scene is drawn directly.
+//
+#pragma once
+
+#include <QMatrix4x4>
+
+class QOpenGLShaderProgram;
+
+class EyeDomeLighting
+{
+private:
+    QOpenGLShaderProgram* program      = nullptr;
+    unsigned              fbo          = 0;
+    unsigned              colorTexture = 0;
+    unsigned              depthTexture = 0;
+    int                   previous     = 0;         // framebuffer bound before begin
+    int                   width        = 0;
+    int                   height       = 0;
+    int                   supported    = -1;        // -1: not yet checked, 0: draw directly
+    float                 radius       = 1.5f;      // distance to the neighbors in pixels
+    float                 strength     = 1.0f;
+
+    bool init();
+    bool createTargets();
+    void releaseTargets();
+
+public:
+    void  setRadius  (float r) { radius = r; }
+    float getRadius  () const  { return radius; }
+    void  setStrength(float s) { strength = s; }
+    float getStrength() const  { return strength; }
+
+    // Redirects the drawing into the framebuffer, (re)created with width x height pixels, which has
+    // to be cleared afterwards. Returns false if not supported, then nothing changed.
+    bool begin(int width, int height);
+
+    // Draws the shaded image with its depth into the framebuffer bound before begin, so more can be
+    // drawn on top. projection is that of the render matrix (for linear depth).
+    void end(const QMatrix4x4& projection);
+
+    // frees the GL resources, the context has to be current
+    void releaseGL();
+};
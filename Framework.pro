@@ -26,14 +26,31 @@ HEADERS += ./glwidget.h \
     ./GLConvenience.h \
     ./QtConvenience.h \
     Axes.h \
+    BVH.h \
     Cube.h \
+    EuclideanClustering.h \
+    EyeDomeLighting.h \
     Hexahedron.h \
+    InstancedBoxes.h \
     KdTree.h \
+    NormalEstimation.h \
+    MemoryTracker.h \
     OctTree.h \
+    Parallel.h \
+    PerspectiveCamera.h \
+    PLYWriter.h \
     Plane.h \
+    PlaneSegmentation.h \
+    PointCloudFilters.h \
+    PointKernels.h \
+    Profiler.h \
+    Registration.h \
     RenderCamera.h \
     SceneManager.h \
-    SceneObject.h
+    SceneObject.h \
+    StereoCamera.h \
+    StereoMatching.h \
+    StereoRectification.h
 
 SOURCES += ./glwidget.cpp \
      ./mainwindow.cpp \
@@ -42,13 +59,29 @@ SOURCES += ./glwidget.cpp \
     ./GLConvenience.cpp \
     ./QtConvenience.cpp \
     Axes.cpp \
+    BVH.cpp \
     Cube.cpp \
+    EuclideanClustering.cpp \
+    EyeDomeLighting.cpp \
     Hexahedron.cpp \
+    InstancedBoxes.cpp \
     KdTree.cpp \
+    NormalEstimation.cpp \
+    MemoryTracker.cpp \
     OctTree.cpp \
+    PerspectiveCamera.cpp \
+    PLYWriter.cpp \
     Plane.cpp \
+    PlaneSegmentation.cpp \
+    PointCloudFilters.cpp \
+    PointKernels.cpp \
+    Profiler.cpp \
+    Registration.cpp \
     RenderCamera.cpp \
     SceneManager.cpp \
-    SceneObject.cpp
+    SceneObject.cpp \
+    StereoCamera.cpp \
+    StereoMatching.cpp \
+    StereoRectification.cpp
 
 FORMS += ./mainwindow.ui
@@ -5,6 +5,9 @@
 //
 #include "Hexahedron.h"
 #include "QtConvenience.h"
+#include "PointKernels.h"
+
+#include <algorithm>
 
 Hexahedron::Hexahedron(QVector4D _origin,
                        float     _dx,
@@ -50,7 +53,19 @@ Hexahedron::Hexahedron(const Hexahedron&& hex):
 void Hexahedron::affineMap(const QMatrix4x4& M)
 {
     origin = M*origin;
-    for (auto& p: *this) p = M^p;
+    transformPoints(this->data(), qsizetype(this->size()), M);
+}
+
+bool Hexahedron::getBounds(QVector3D& bbMin, QVector3D& bbMax) const
+{
+    if (empty()) return false;
+    bbMin = bbMax = front();
+    for (const QVector3D& p: *this)
+        for (int k = 0; k < 3; k++) {
+            bbMin[k] = std::min(bbMin[k], p[k]);
+            bbMax[k] = std::max(bbMax[k], p[k]);
+        }
+    return true;
 }
 
 void Hexahedron::draw(const RenderCamera& renderer,
@@ -31,12 +31,15 @@ public:
     virtual void draw      (const RenderCamera& renderer,
                             const QColor      & color     = COLOR_SCENE,
                             float               lineWidth = 3.0f       ) const override;
+    // AABB of the corners
+    virtual bool getBounds (QVector3D& bbMin, QVector3D& bbMax) const override;
+    // corner array
+    virtual MemoryUsage memoryUsage() const override { return containerUsage(static_cast<const std::vector<QVector3D>&>(*this)); }
     // draws the corners of the hexahedron
             void drawPoints(const RenderCamera& renderer,
                             const QColor      & color     = COLOR_SCENE,
                             float               pointSize = 1) const;
 
-protected:
     // Some convenience members to iterate a hexahedron's vertices and edges
     constexpr static unsigned edgeCount = 12;
     constexpr static unsigned faceCount = 6;
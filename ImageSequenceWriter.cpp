@@ -0,0 +1,76 @@
+//
+//  Parallel writer of numbered image files
+//
+#include "ImageSequenceWriter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace std;
+
+ImageSequenceWriter::ImageSequenceWriter(const QString& _prefix, const QString& _format, int threads, int _maxQueued, int _quality)
+    : prefix(_prefix), format(_format), quality(_quality), maxQueued(std::max(_maxQueued, 1))
+{
+    for (int t = 0; t < std::max(threads, 1); t++) workers.emplace_back([this] { work(); });
+}
+
+ImageSequenceWriter::~ImageSequenceWriter()
+{
+    try {
+        finish();
+    }
+    catch (const exception&) {}
+}
+
+void ImageSequenceWriter::write(int frame, const QImage& image)
+{
+    write(QString("%1%2.%3").arg(prefix).arg(frame, 4, 10, QChar('0')).arg(format), image);
+}
+
+void ImageSequenceWriter::write(const QString& filePath, const QImage& image)
+{
+    unique_lock<std::mutex> lock(mutex);
+    if (closing) throw runtime_error("image writer is finished");
+    taken.wait(lock, [this] { return qsizetype(queue.size()) < maxQueued; });
+    queue.push_back({ filePath, image });
+    queued.notify_one();
+}
+
+void ImageSequenceWriter::work()
+{
+    for (;;) {
+        Item item;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            queued.wait(lock, [this] { return closing || !queue.empty(); });
+            if (queue.empty()) return;
+            item = std::move(queue.front());
+            queue.pop_front();
+            taken.notify_one();
+        }
+
+        // encoding runs unlocked, QImage::save is reentrant
+        if (!item.image.save(item.filePath, format.toLatin1().constData(), quality)) {
+            lock_guard<std::mutex> lock(mutex);
+            failed.append(item.filePath);
+        }
+    }
+}
+
+void ImageSequenceWriter::finish()
+{
+    {
+        lock_guard<std::mutex> lock(mutex);
+        closing = true;
+    }
+    queued.notify_all();
+    for (thread& t: workers) t.join();
+    workers.clear();
+
+    if (!failed.isEmpty()) {
+        const QString first = failed.first();
+        const qsizetype n   = failed.size();
+        failed.clear();
+        throw runtime_error("cannot write " + first.toStdString() + (n > 1 ? " and " + to_string(n-1) + " more images" : ""));
+    }
+}
@@ -0,0 +1,64 @@
+//
+//  Parallel writer of numbered image files
+//
+//  Frames are queued by the render thread and encoded by a pool of worker threads, so
+//  compressing PNGs does not stall rendering. The queue is bounded: write blocks while
+//  maxQueued images wait, which keeps the memory of a fast renderer bounded as well.
+//  The files are named <prefix><frame, 4 digits>.<format>, e.g. frame_0042.png; a single
+//  image is written with an explicit file name.
+//
+#pragma once
+
+#include <QImage>
+#include <QString>
+#include <QStringList>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ImageSequenceWriter
+{
+private:
+    struct Item {
+        QString filePath;
+        QImage  image;
+    };
+
+    QString                  prefix;
+    QString                  format;
+    int                      quality;
+    int                      maxQueued;
+
+    std::mutex               mutex;
+    std::condition_variable  queued, taken;
+    std::deque<Item>         queue;
+    std::vector<std::thread> workers;
+    bool                     closing = false;
+    QStringList              failed;
+
+    void work();
+
+public:
+    // prefix includes the directory, format is a QImageWriter format ("png", "jpg"),
+    // quality is passed to QImage::save (-1: default)
+    ImageSequenceWriter(const QString& prefix,
+                        const QString& format    = "png",
+                        int            threads   = 2,
+                        int            maxQueued = 8,
+                        int            quality   = -1);
+    ~ImageSequenceWriter();
+
+    ImageSequenceWriter(const ImageSequenceWriter&)            = delete;
+    ImageSequenceWriter& operator=(const ImageSequenceWriter&) = delete;
+
+    // queues frame number frame resp. an image with its own file name
+    void write(int frame, const QImage& image);
+    void write(const QString& filePath, const QImage& image);
+
+    // waits until all queued images are written, no images can be queued afterwards.
+    // Throws runtime_error if any of them could not be written.
+    void finish();
+};
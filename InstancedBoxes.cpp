@@ -0,0 +1,50 @@
+//
+//  Many axis-aligned boxes drawn with a single instanced draw call
+//
+#include "InstancedBoxes.h"
+
+#include <algorithm>
+
+InstancedBoxes::InstancedBoxes(QVector<BoxInstance> _boxes, BoxStyle _style)
+    : boxes(std::move(_boxes)), style(_style)
+{
+    type = SceneObjectType::ST_INSTANCED_BOXES;
+
+    if (boxes.isEmpty()) return;
+    boxesMin = boxes.front().bbMin;
+    boxesMax = boxes.front().bbMax;
+    for (const BoxInstance& b: boxes)
+        for (int k = 0; k < 3; k++) {
+            boxesMin[k] = std::min(boxesMin[k], b.bbMin[k]);
+            boxesMax[k] = std::max(boxesMax[k], b.bbMax[k]);
+        }
+}
+
+void InstancedBoxes::affineMap(const QMatrix4x4& M)
+{
+    model = M * model;
+}
+
+void InstancedBoxes::draw(const RenderCamera& renderer, const QColor& /*color*/, float lineWidth) const
+{
+    renderer.renderBoxes(boxes, model, style, lineWidth);
+}
+
+bool InstancedBoxes::getBounds(QVector3D& bbMin, QVector3D& bbMax) const
+{
+    if (boxes.isEmpty()) return false;
+
+    // AABB of the mapped corners of the overall box
+    for (int i = 0; i < 8; i++) {
+        const QVector3D c(i & 1 ? boxesMax.x() : boxesMin.x(),
+                          i & 2 ? boxesMax.y() : boxesMin.y(),
+                          i & 4 ? boxesMax.z() : boxesMin.z());
+        const QVector3D p = model.map(c);
+        if (i == 0) { bbMin = bbMax = p; continue; }
+        for (int k = 0; k < 3; k++) {
+            bbMin[k] = std::min(bbMin[k], p[k]);
+            bbMax[k] = std::max(bbMax[k], p[k]);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+//
+//  Many axis-aligned boxes drawn with a single instanced draw call
+//
+//  Used for the tree visualizations: the octree cells as wireframe cubes and the kd-tree
+//  split planes as flat boxes, i.e. rectangles. Instead of one scene object per node, the
+//  boxes are kept as a flat instance array that is generated directly from the tree and
+//  rendered by RenderCamera::renderBoxes. The boxes stay axis-aligned in their own frame;
+//  affine maps accumulate in a model matrix applied when drawing.
+//
+#pragma once
+
+#include "SceneObject.h"
+
+#include <QVector>
+
+class InstancedBoxes: public SceneObject
+{
+private:
+    QVector<BoxInstance> boxes;
+    BoxStyle             style;
+    QMatrix4x4           model;
+    QVector3D            boxesMin, boxesMax;        // AABB of all boxes before the model matrix
+
+public:
+    InstancedBoxes(QVector<BoxInstance> _boxes, BoxStyle _style = BoxStyle::BS_EDGES);
+    virtual ~InstancedBoxes() override {}
+
+    virtual void affineMap(const QMatrix4x4  & matrix) override;
+    // draws all boxes in their own colors, color is ignored
+    virtual void draw     (const RenderCamera& renderer,
+                           const QColor      & color     = COLOR_SCENE,
+                           float               lineWidth = 2.0f       ) const override;
+    virtual bool getBounds(QVector3D& bbMin, QVector3D& bbMax) const override;
+    virtual MemoryUsage memoryUsage() const override { return containerUsage(boxes); }
+
+    const QVector<BoxInstance>& instances() const { return boxes; }
+    qsizetype                   size     () const { return boxes.size(); }
+};
@@ -1,172 +1,336 @@
 #include "KdTree.h"
-#include "Plane.h"
+#include "InstancedBoxes.h"
+#include "Parallel.h"
+#include "Profiler.h"
 #include <QMatrix4x4>
 #include <algorithm>
+#include <numeric>
+#include <thread>
 
 
 
-// Hilfsklasse: speichert Farbe + Transparenz, ruft dann Plane::draw mit genau diesen Parametern auf
-class KdPlane : public Plane {
-public:
-    QColor    col;
-    float     transp;
-    KdPlane(const QVector4D& origin,
-            const QVector4D& normal,
-            const QColor&    c,
-            float            t)
-        : Plane(origin, normal),
-        col(c),
-        transp(t)
-    {
-        // sorgt dafür, dass SceneManager::draw() uns als Plane behandelt
-        type = SceneObjectType::ST_PLANE;
-    }
-
-    // Überschreibt draw und ignoriert die übergebenen Default-Parameter
-    virtual void draw(const RenderCamera& renderer,
-                      const QColor&        /*color*/,
-                      float                /*transparency*/) const override
-    {
-        Plane::draw(renderer, col, transp);
-    }
-};
-
-
 // ------------------------------------------------------------------
-// Partitioniere idx[l..r] in-place entlang pts[*][axis] <= split
+// Partitioniere idx[l..r] stabil: erst alle Indizes, die entlang axis
+// kleiner als median sind, dann median selbst, dann alle größeren.
+// Die Sortierung innerhalb beider Teile bleibt dabei erhalten.
 // ------------------------------------------------------------------
 void partitionIndex(QVector<int>& idx,
                     const QVector<QVector4D>& pts,
-                    int axis, float split, int l, int r)
+                    int axis, int median, int l, int r,
+                    QVector<int>& tmp)
 {
-    int i = l, j = r;
-    while (i <= j) {
-        // suche von links den ersten, der > split ist
-        while (i <= j && pts[idx[i]][axis] <= split) ++i;
-        // suche von rechts den ersten, der ≤ split ist
-        while (i <= j && pts[idx[j]][axis] >  split) --j;
-        // tausche beide, falls sie sich überschneiden
-        if (i < j) {
-            std::swap(idx[i], idx[j]);
-            ++i; --j;
-        }
+    int lo = l, hi = 0;
+    for (int i = l; i <= r; ++i) {
+        int j = idx[i];
+        if (j == median)                         continue;
+        if (kdLess(pts, axis, j, median)) idx[lo++] = j;   // kleinere nach vorne (überholt i nie)
+        else                              tmp[hi++] = j;   // größere zwischenspeichern
     }
+    idx[lo++] = median;
+    std::copy(tmp.begin(), tmp.begin() + hi, idx.begin() + lo);
 }
 
-// ------------------------------------------------------------------
-// Rekursiver Aufbau eines balancierten kd-Trees
-// ------------------------------------------------------------------
+namespace {
+
+// Rekursiver Aufbau; tmp ist Zwischenspeicher für partitionIndex, die obersten
+// Ebenen bauen ihre beiden Teilbäume parallel (die Index-Bereiche sind disjunkt)
 KdNode* buildKdTree(const QVector<QVector4D>& pts,
                     QVector<int>& idxX,
                     QVector<int>& idxY,
                     QVector<int>& idxZ,
-                    int l, int r, int depth)
+                    int l, int r, int depth,
+                    QVector<int>& tmp)
 {
     if (l > r) return nullptr;
     int axis = depth % 3;
     auto& idx = (axis == 0 ? idxX : axis == 1 ? idxY : idxZ);
     int m    = (l + r) / 2;                                 // Median-Index im gewählten Array
-    float split = pts[idx[m]][axis];                        // Median
+    int med  = idx[m];
+    float split = pts[med][axis];                           // Median
 
-     // 1) Erzeuge neuen Knoten mit diesem Median
-    auto* node = new KdNode{ pts[idx[m]], split, axis };
+    // 1) Erzeuge neuen Knoten mit diesem Median
+    auto* node = new KdNode{ pts[med], split, axis, med };
 
-    // 2) Partitioniere alle drei Index-Arrays entlang dieser Achse --> Damit in jedem Array rechts/links konsistent aufgeteilt bleibt
-    partitionIndex(idxX, pts, axis, split, l, r);
-    partitionIndex(idxY, pts, axis, split, l, r);
-    partitionIndex(idxZ, pts, axis, split, l, r);
+    // 2) Partitioniere die beiden anderen Index-Arrays entlang dieser Achse --> Damit in jedem Array rechts/links konsistent aufgeteilt bleibt
+    //    (das Array der Split-Achse ist bereits sortiert und damit schon partitioniert)
+    if (axis != 0) partitionIndex(idxX, pts, axis, med, l, r, tmp);
+    if (axis != 1) partitionIndex(idxY, pts, axis, med, l, r, tmp);
+    if (axis != 2) partitionIndex(idxZ, pts, axis, med, l, r, tmp);
 
     // 3) Rekursiv linkes und rechtes Teil-Unterbäume bauen
-    node->left  = buildKdTree(pts, idxX, idxY, idxZ, l,   m-1, depth+1);
-    node->right = buildKdTree(pts, idxX, idxY, idxZ, m+1, r,   depth+1);
+    if (r - l > (1 << 16) && (1 << depth) < int(workerCount())) {
+        QVector<int> tmpRight(tmp.size());
+        std::thread right = workerThread([&] { node->right = buildKdTree(pts, idxX, idxY, idxZ, m+1, r, depth+1, tmpRight); });
+        node->left = buildKdTree(pts, idxX, idxY, idxZ, l, m-1, depth+1, tmp);
+        right.join();
+    } else {
+        node->left  = buildKdTree(pts, idxX, idxY, idxZ, l,   m-1, depth+1, tmp);
+        node->right = buildKdTree(pts, idxX, idxY, idxZ, m+1, r,   depth+1, tmp);
+    }
 
     return node;
 }
 
+} // namespace
+
+// ------------------------------------------------------------------
+// Rekursiver Aufbau eines balancierten kd-Trees
+// ------------------------------------------------------------------
+KdNode* buildKdTree(const QVector<QVector4D>& pts,
+                    QVector<int>& idxX,
+                    QVector<int>& idxY,
+                    QVector<int>& idxZ,
+                    int l, int r, int depth)
+{
+    QVector<int> tmp(r - l + 1);
+    return buildKdTree(pts, idxX, idxY, idxZ, l, r, depth, tmp);
+}
+
+KdNode* buildKdTree(const QVector<QVector4D>& pts)
+{
+    const int N = int(pts.size());
+    TrackedBytes indices(MemoryCategory::MC_KD_INDICES, 4 * qint64(N) * qint64(sizeof(int)));   // idxX/Y/Z und tmp
+    QVector<int> idxX(N), idxY(N), idxZ(N);
+    std::iota(idxX.begin(), idxX.end(), 0);
+    std::iota(idxY.begin(), idxY.end(), 0);
+    std::iota(idxZ.begin(), idxZ.end(), 0);
+
+    // sortiere idxX/idxY/idxZ so, dass die x-/y-/z-Koordinaten monoton steigen
+    { PROFILE_SCOPE("kd sort x"); parallelSort(idxX.begin(), idxX.end(), [&](int a, int b){ return kdLess(pts, 0, a, b); }); }
+    { PROFILE_SCOPE("kd sort y"); parallelSort(idxY.begin(), idxY.end(), [&](int a, int b){ return kdLess(pts, 1, a, b); }); }
+    { PROFILE_SCOPE("kd sort z"); parallelSort(idxZ.begin(), idxZ.end(), [&](int a, int b){ return kdLess(pts, 2, a, b); }); }
+
+    // jetzt den Median‐Split starten
+    PROFILE_SCOPE("kd median split");
+    return buildKdTree(pts, idxX, idxY, idxZ, /*l=*/0, /*r=*/N-1, /*depth=*/0);
+}
+
+// ------------------------------------------------------------------
+// Speicher des Baums: ein KdNode je Punkt
+// ------------------------------------------------------------------
+MemoryUsage kdTreeMemory(const KdNode* root)
+{
+    qint64 nodes = 0;
+    std::vector<const KdNode*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        const KdNode* n = stack.back();
+        stack.pop_back();
+        nodes++;
+        if (n->left)  stack.push_back(n->left);
+        if (n->right) stack.push_back(n->right);
+    }
+    const qint64 bytes = nodes * qint64(sizeof(KdNode));
+    return { bytes, bytes };
+}
+
+// ------------------------------------------------------------------
+// k-nächste-Nachbarn-Suche
+// ------------------------------------------------------------------
+namespace {
+
+// heap ist ein Max-Heap über die bisher besten k Kandidaten
+void searchKNearest(const KdNode* node, const QVector4D& q, size_t k,
+                   std::vector<std::pair<float,int>>& heap)
+{
+    while (node) {
+        float d2 = (node->point - q).toVector3D().lengthSquared();
+        if (heap.size() < k) {
+            heap.emplace_back(d2, node->index);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (d2 < heap.front().first) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = { d2, node->index };
+            std::push_heap(heap.begin(), heap.end());
+        }
+
+        // zuerst die Seite des Anfragepunktes, die andere nur, wenn die Split-Ebene nah genug ist
+        float diff = q[node->axis] - node->splitValue;
+        const KdNode* nearSide = diff < 0 ? node->left  : node->right;
+        const KdNode* farSide  = diff < 0 ? node->right : node->left;
+        searchKNearest(nearSide, q, k, heap);
+        if (heap.size() < k || diff*diff < heap.front().first)
+            node = farSide;
+        else
+            node = nullptr;
+    }
+}
+
+} // namespace
+
+void kNearestNeighbors(const KdNode*                      root,
+                       const QVector4D&                   q,
+                       int                                k,
+                       std::vector<std::pair<float,int>>& result)
+{
+    result.clear();
+    if (k <= 0) return;
+    result.reserve(k + 1);
+    searchKNearest(root, q, size_t(k), result);
+    std::sort_heap(result.begin(), result.end());
+}
+
+QVector<int> kNearestNeighbors(const KdNode*             root,
+                               const QVector<QVector4D>& queries,
+                               int                       k)
+{
+    QVector<int> result(queries.size() * k, -1);
+    int* out = result.data();
+
+    parallelFor(queries.size(), [&](unsigned, qsizetype b, qsizetype e) {
+        std::vector<std::pair<float,int>> nn;
+        for (qsizetype i = b; i < e; ++i) {
+            kNearestNeighbors(root, queries[i], k, nn);
+            for (size_t j = 0; j < nn.size(); ++j) out[i*k + j] = nn[j].second;
+        }
+    }, 1024);
+
+    return result;
+}
+
+// ------------------------------------------------------------------
+// Radius-Suche
+// ------------------------------------------------------------------
+namespace {
+
+// besucht alle Knoten, deren Punkt im Radius liegt; visit liefert false für Abbruch
+template <class Visit>
+void searchRadius(const KdNode* root, const QVector4D& q, float radius, Visit&& visit)
+{
+    const float r2 = radius * radius;
+    const KdNode* stack[64];
+    int top = 0;
+    if (root) stack[top++] = root;
+
+    while (top > 0) {
+        const KdNode* node = stack[--top];
+        if ((node->point - q).toVector3D().lengthSquared() <= r2 && !visit(node->index))
+            return;
+
+        // Teilbäume nur betreten, wenn die Kugel die Split-Ebene erreicht
+        float diff = q[node->axis] - node->splitValue;
+        if (node->left  && diff <=  radius) stack[top++] = node->left;
+        if (node->right && diff >= -radius) stack[top++] = node->right;
+    }
+}
+
+} // namespace
+
+void radiusSearch(const KdNode*     root,
+                  const QVector4D&  q,
+                  float             radius,
+                  std::vector<int>& result)
+{
+    result.clear();
+    searchRadius(root, q, radius, [&](int i) { result.push_back(i); return true; });
+}
+
+int countInRadius(const KdNode*    root,
+                  const QVector4D& q,
+                  float            radius,
+                  int              maxCount)
+{
+    int count = 0;
+    searchRadius(root, q, radius, [&](int) { return ++count < maxCount; });
+    return count;
+}
+
+// ------------------------------------------------------------------
+// Picking: Kegel von vorn nach hinten durch die Zellen des Baums
+// ------------------------------------------------------------------
+int rayPick(const KdNode*    root,
+            const PickRay&   ray,
+            const QVector3D& bbMin,
+            const QVector3D& bbMax,
+            float&           tMax)
+{
+    struct Cell { const KdNode* node; QVector3D bbMin, bbMax; };
+    Cell  stack[128];                                   // je Ebene höchstens eine zurückgestellte Zelle
+    int   top  = 0;
+    int   hit  = -1;
+    float best = std::min(tMax, ray.farthest(bbMin, bbMax));
+    if (root) stack[top++] = { root, bbMin, bbMax };
+
+    while (top > 0) {
+        const Cell c = stack[--top];
+
+        // 1) Zelle überspringen, wenn der Kegel sie nicht vor dem besten Treffer erreicht
+        float t0 = 0.0f, t1 = best;
+        if (!ray.clip(c.bbMin, c.bbMax, ray.width(best), t0, t1)) continue;
+
+        // 2) Median-Punkt des Knotens testen: Abstand zur Achse höchstens Kegelradius bei t
+        const KdNode*   node = c.node;
+        const QVector3D v    = node->point.toVector3D() - ray.origin;
+        const float     t    = QVector3D::dotProduct(v, ray.dir);
+        if (t >= 0.0f && t <= best && (v - t * ray.dir).lengthSquared() <= ray.width(t) * ray.width(t)) {
+            best = t;
+            hit  = node->index;
+        }
+
+        // 3) Kinderzellen: die auf der Seite des Ursprungs zuletzt auf den Stapel, damit sie zuerst dran ist
+        const int a = node->axis;
+        Cell front = { node->left,  c.bbMin, c.bbMax };
+        Cell back  = { node->right, c.bbMin, c.bbMax };
+        front.bbMax[a] = back.bbMin[a] = node->splitValue;
+        if (ray.origin[a] >= node->splitValue) std::swap(front, back);
+        if (back.node)  stack[top++] = back;
+        if (front.node) stack[top++] = front;
+    }
+    if (hit >= 0) tMax = best;
+    return hit;
+}
+
 // ------------------------------------------------------------------
-// Visualisiert die ersten maxDepth-Ebenen des kd-Trees
+// Split-Ebenen der Level minDepth…maxDepth als flache Boxen
 // ------------------------------------------------------------------
-void visualizeKdTree(KdNode*          node,
-                     int              depth,
-                     int              maxDepth,
-                     const QVector4D& bbMin,
-                     const QVector4D& bbMax,
-                     SceneManager&    scene)
+void kdTreeBoxes(const KdNode*         node,
+                 int                   depth,
+                 int                   minDepth,
+                 int                   maxDepth,
+                 const QVector4D&      bbMin,
+                 const QVector4D&      bbMax,
+                 QVector<BoxInstance>& boxes)
 {
     // 0) Abbruch: kein Knoten oder Tiefe überschritten
     if (!node || depth > maxDepth)
         return;
 
-    // 1) Ursprung, Normalenvektor und Skalierungsfaktoren berechnen
-    QVector4D origin, normal;
-    float     sx, sy;
-    switch (node->axis) {
-    case 0:  // X-Split
-        origin = { node->splitValue,
-                  0.5f*(bbMin.y() + bbMax.y()),
-                  0.5f*(bbMin.z() + bbMax.z()),
-                  1.0f };
-        normal = {1,0,0,0};
-        sx     = 0.5f*(bbMax.y() - bbMin.y());
-        sy     = 0.5f*(bbMax.z() - bbMin.z());
-        break;
-    case 1:  // Y-Split
-        origin = { 0.5f*(bbMin.x() + bbMax.x()),
-                  node->splitValue,
-                  0.5f*(bbMin.z() + bbMax.z()),
-                  1.0f };
-        normal = {0,1,0,0};
-        sx     = 0.5f*(bbMax.x() - bbMin.x());
-        sy     = 0.5f*(bbMax.z() - bbMin.z());
-        break;
-    default: // Z-Split
-        origin = { 0.5f*(bbMin.x() + bbMax.x()),
-                  0.5f*(bbMin.y() + bbMax.y()),
-                  node->splitValue,
-                  1.0f };
-        normal = {0,0,1,0};
-        sx     = 0.5f*(bbMax.x() - bbMin.x());
-        sy     = 0.5f*(bbMax.y() - bbMin.y());
-        break;
-    }
+    // 1) Rechteck der Split-Ebene innerhalb der Zelle: Box mit Ausdehnung 0 entlang der Split-Achse
+    const int a = node->axis;
+    if (depth >= minDepth) {
+        QVector3D mn = bbMin.toVector3D(), mx = bbMax.toVector3D();
+        mn[a] = mx[a] = node->splitValue;
 
-    // 2) Plane-Mesh anlegen und skalieren
-    QMatrix4x4 M;
-    M.scale(sx, sy, 1.0f);
-
-    // 3) Transparenz t in [0.2 … 0.8] je nach Tiefe
-    float t = (255 - (depth * 200 / maxDepth)) / 255.0f;
-    t = qMax(0.2f, t);
-
-    // 4) Farbe je Achse: Rot=X, Grün=Y, Blau=Z
-    QColor col;
-    switch (node->axis) {
-    case 0:
-        col = QColor(255,   0,   0);  // X-Split → Rot
-        break;
-    case 1:
-        col = QColor(  0, 255,   0);  // Y-Split → Grün
-        break;
-    case 2:
-        col = QColor(  0,   0, 255);  // Z-Split → Blau
-        break;
+        // 2) Transparenz t in [0.2 … 1] je nach Tiefe, Farbe je Achse: Rot=X, Grün=Y, Blau=Z
+        const float t = qMax(0.2f, 1.0f - 0.1f * depth);
+        boxes.append({ mn, mx, QVector4D(a == 0, a == 1, a == 2, t) });
     }
 
-    // 5) Ebene erzeugen, transformieren und zur Szene hinzufügen
-    KdPlane* plane = new KdPlane(origin, normal, col, t);
-    plane->affineMap(M);
-    scene.push_back(plane);
-
-    // 6) Bounding-Box für linkes/rechtes Teilbaum splitten
-    QVector4D leftMin  = bbMin, leftMax  = bbMax;
-    QVector4D rightMin = bbMin, rightMax = bbMax;
-    if      (node->axis == 0) { leftMax.setX(node->splitValue);   rightMin.setX(node->splitValue); }
-    else if (node->axis == 1) { leftMax.setY(node->splitValue);   rightMin.setY(node->splitValue); }
-    else                      { leftMax.setZ(node->splitValue);   rightMin.setZ(node->splitValue); }
-
-    // 7) Rekursion für linkes und rechtes Teilbaum
-    visualizeKdTree(node->left,  depth+1, maxDepth, leftMin,  leftMax,  scene);
-    visualizeKdTree(node->right, depth+1, maxDepth, rightMin, rightMax, scene);
-}
+    // 3) Bounding-Box für linken/rechten Teilbaum splitten
+    QVector4D leftMax = bbMax, rightMin = bbMin;
+    leftMax[a]  = node->splitValue;
+    rightMin[a] = node->splitValue;
 
+    // 4) Rekursion für linken und rechten Teilbaum
+    kdTreeBoxes(node->left,  depth+1, minDepth, maxDepth, bbMin,    leftMax, boxes);
+    kdTreeBoxes(node->right, depth+1, minDepth, maxDepth, rightMin, bbMax,   boxes);
+}
 
+// ------------------------------------------------------------------
+// Visualisiert die Ebenen minDepth…maxDepth des kd-Trees
+// ------------------------------------------------------------------
+SceneHandle visualizeKdTree(const KdNode*    root,
+                            int              minDepth,
+                            int              maxDepth,
+                            const QVector4D& bbMin,
+                            const QVector4D& bbMax,
+                            SceneManager&    scene,
+                            SceneHandle      layer)
+{
+    // alle Ebenen in einem Objekt, das mit einem einzigen instanzierten Draw-Call gezeichnet wird
+    QVector<BoxInstance> boxes;
+    kdTreeBoxes(root, 0, minDepth, maxDepth, bbMin, bbMax, boxes);
+    if (boxes.isEmpty())
+        return SceneHandle();
+    return scene.add(new InstancedBoxes(std::move(boxes), BoxStyle::BS_QUADS), layer);
+}
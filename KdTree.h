@@ -1,36 +1,99 @@
 #pragma once
 #include <QVector>
 #include <QVector4D>
+#include <utility>
+#include <vector>
 #include "SceneManager.h"
+#include "MemoryTracker.h"
 
 // Knoten im 3d-kd-Tree
 struct KdNode {
     QVector4D point;                        // der „Median“-Punkt, an dem wir splitten
     float      splitValue;                  // die Koordinate dieses Punktes auf der Split-Achse
     int        axis;                        // 0 = X-Achse, 1 = Y-Achse, 2 = Z-Achse
+    int        index;                       // Index des Median-Punktes in der Punktwolke
     KdNode*    left  = nullptr;
     KdNode*    right = nullptr;
     ~KdNode() { delete left; delete right; }
+
+    TRACK_INSTANCES(MemoryCategory::MC_KD_TREE)
 };
 
-// Baumaufbau
+// Baumaufbau über alle Punkte (sortiert die drei Index-Arrays selbst vor)
+KdNode* buildKdTree(const QVector<QVector4D>& pts);
+
+// Baumaufbau über idxX/idxY/idxZ[l..r]; die Arrays müssen nach kdLess sortiert sein
 KdNode* buildKdTree(const QVector<QVector4D>& pts,
                     QVector<int>& idxX,
                     QVector<int>& idxY,
                     QVector<int>& idxZ,
                     int l, int r, int depth);
 
-// Partitionierung (Hilfsfunktion)
+// Ordnung entlang einer Achse; gleiche Koordinaten werden über den Index eindeutig sortiert
+inline bool kdLess(const QVector<QVector4D>& pts, int axis, int a, int b)
+{
+    return pts[a][axis] < pts[b][axis] || (pts[a][axis] == pts[b][axis] && a < b);
+}
+
+// Partitionierung (Hilfsfunktion): ordnet idx[l..r] stabil in „kleiner als median“, median, „größer als median“
 void partitionIndex(QVector<int>& idx,
                     const QVector<QVector4D>& pts,
-                    int axis, float split, int l, int r);
+                    int axis, int median, int l, int r,
+                    QVector<int>& tmp);
 
-// Freie Funktion zur Visualisierung der Splitting-Ebenen
-// Zeichnet Level 0…maxDepth über SceneManager
-void visualizeKdTree(KdNode*   node,
-                     int       depth,
-                     int       maxDepth,
-                     const QVector4D& bbMin,
-                     const QVector4D& bbMax,
-                     SceneManager&    scene);
+// k nächste Nachbarn von q als (quadrierter Abstand, Punktindex), aufsteigend nach Abstand
+void kNearestNeighbors(const KdNode*                 root,
+                       const QVector4D&              q,
+                       int                           k,
+                       std::vector<std::pair<float,int>>& result);
+
+// Speicher des Baums (Knoten)
+MemoryUsage kdTreeMemory(const KdNode* root);
+
+// Batch-Variante: k nächste Nachbarn aller Anfragepunkte, parallel über alle Kerne.
+// Ergebnis enthält je Anfragepunkt k Punktindizes hintereinander (-1, falls weniger Punkte existieren).
+QVector<int> kNearestNeighbors(const KdNode*             root,
+                               const QVector<QVector4D>& queries,
+                               int                       k);
 
+// Radius-Suche: Indizes aller Punkte mit Abstand <= radius zu q (unsortiert)
+void radiusSearch(const KdNode*     root,
+                  const QVector4D&  q,
+                  float             radius,
+                  std::vector<int>& result);
+
+// Zählt die Punkte mit Abstand <= radius zu q, bricht ab, sobald maxCount erreicht ist
+int countInRadius(const KdNode*    root,
+                  const QVector4D& q,
+                  float            radius,
+                  int              maxCount);
+
+// Picking: Index des Punktes im Kegel ray mit dem kleinsten Strahlparameter t in [0, tMax] (-1, falls keiner);
+// bbMin/bbMax ist die Bounding-Box der Punkte. Besucht nur die Zellen, die der Kegel vor dem bisher besten
+// Treffer erreicht, die vordere zuerst. Bei einem Treffer erhält tMax dessen t.
+int rayPick(const KdNode*    root,
+            const PickRay&   ray,
+            const QVector3D& bbMin,
+            const QVector3D& bbMax,
+            float&           tMax);
+
+// Hängt die Splitting-Ebenen der Level minDepth…maxDepth als flache Boxen (Rechtecke in ihren Zellen,
+// Farbe je Achse, Transparenz je Tiefe) an boxes an; node liegt in der Tiefe depth
+void kdTreeBoxes(const KdNode*         node,
+                 int                   depth,
+                 int                   minDepth,
+                 int                   maxDepth,
+                 const QVector4D&      bbMin,
+                 const QVector4D&      bbMax,
+                 QVector<BoxInstance>& boxes);
+
+// Freie Funktion zur Visualisierung der Splitting-Ebenen
+// Zeichnet Level minDepth…maxDepth über SceneManager als ein InstancedBoxes-Objekt (Kind des Knotens layer)
+// und gibt dessen Handle zurück (ungültig, falls der Baum keine solchen Level hat)
+SceneHandle visualizeKdTree(const KdNode*    root,
+                            int              minDepth,
+                            int              maxDepth,
+                            const QVector4D& bbMin,
+                            const QVector4D& bbMax,
+                            SceneManager&    scene,
+                            SceneHandle      layer = SceneHandle());
@@ -0,0 +1,109 @@
+//
+//  Memory accounting of point clouds, trees and scene objects
+//
+#include "MemoryTracker.h"
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+
+namespace {
+constexpr int    COUNT = int(MemoryCategory::MC_COUNT);
+constexpr qint64 BATCH = 1 << 20;               // publish after 1MB of pending change
+
+struct Totals {
+    qint64 current = 0, peak = 0, allocations = 0, releases = 0;
+};
+
+struct Global {
+    std::mutex              mutex;
+    std::array<Totals, COUNT> totals;
+};
+
+Global& global()
+{
+    static Global g;
+    return g;
+}
+
+// counts of the calling thread not yet published, published when the thread ends
+struct Pending {
+    std::array<Totals, COUNT> delta;            // current holds the change of the bytes held
+
+    void publish(int c)
+    {
+        Totals& d = delta[c];
+        Global& g = global();
+        {
+            std::lock_guard<std::mutex> lock(g.mutex);
+            Totals& t = g.totals[c];
+            t.current     += d.current;
+            t.peak         = std::max(t.peak, t.current);
+            t.allocations += d.allocations;
+            t.releases    += d.releases;
+        }
+        d = Totals();
+    }
+    void publishAll() { for (int c = 0; c < COUNT; c++) publish(c); }
+    ~Pending() { publishAll(); }
+};
+
+Pending& pending()
+{
+    thread_local Pending p;
+    return p;
+}
+}
+
+void MemoryTracker::allocate(MemoryCategory c, qint64 bytes)
+{
+    Pending& p = pending();
+    Totals&  d = p.delta[int(c)];
+    d.current += bytes;
+    d.allocations++;
+    if (d.current >= BATCH) p.publish(int(c));
+}
+
+void MemoryTracker::release(MemoryCategory c, qint64 bytes)
+{
+    Pending& p = pending();
+    Totals&  d = p.delta[int(c)];
+    d.current -= bytes;
+    d.releases++;
+    if (d.current <= -BATCH) p.publish(int(c));
+}
+
+std::vector<MemoryTracker::CategoryStats> MemoryTracker::stats()
+{
+    pending().publishAll();
+
+    Global& g = global();
+    std::lock_guard<std::mutex> lock(g.mutex);
+    std::vector<CategoryStats> result;
+    for (int c = 0; c < COUNT; c++) {
+        const Totals& t = g.totals[c];
+        result.push_back({ categoryName(MemoryCategory(c)), t.current, t.peak, t.allocations, t.releases });
+    }
+    return result;
+}
+
+void MemoryTracker::resetPeaks()
+{
+    pending().publishAll();
+
+    Global& g = global();
+    std::lock_guard<std::mutex> lock(g.mutex);
+    for (Totals& t: g.totals) t.peak = t.current;
+}
+
+QString MemoryTracker::categoryName(MemoryCategory c)
+{
+    switch (c) {
+    case MemoryCategory::MC_KD_TREE:       return "kd-tree nodes";
+    case MemoryCategory::MC_KD_INDICES:    return "kd-tree build indices";
+    case MemoryCategory::MC_OCT_TREE:      return "octree nodes";
+    case MemoryCategory::MC_OCT_INDICES:   return "octree indices";
+    case MemoryCategory::MC_SCENE_OBJECTS: return "scene objects";
+    default:                               return "unknown";
+    }
+}
@@ -0,0 +1,86 @@
+//
+//  Memory accounting of point clouds, trees and scene objects
+//
+//  Two complementary views: MemoryTracker counts allocations per category as they happen
+//  (bytes currently held, peak, number of allocations and releases), e.g. every KdNode or
+//  the presorted index arrays of a kd-tree build, which live only during the build and thus
+//  show up in the peak only. MemoryUsage reports, computed on demand by walking a structure,
+//  split its memory into bytes reserved (capacities) and bytes used (sizes).
+//
+//  Allocations are summed per thread and published in batches, so tracking a node costs no
+//  more than a thread-local add; the peak is exact up to the batch size per thread.
+//
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+#include <cstddef>
+#include <vector>
+
+// point and normal arrays of clouds are not tracked, PointCloud::memoryUsage reports them
+enum class MemoryCategory {MC_KD_TREE,              // KdNodes
+                           MC_KD_INDICES,           // presorted index arrays of kd-tree builds
+                           MC_OCT_TREE,             // OctNodes
+                           MC_OCT_INDICES,          // point indices held by OctNodes
+                           MC_SCENE_OBJECTS,        // SceneObject instances (without their arrays)
+                           MC_COUNT};
+
+// reserved >= used, both in bytes
+struct MemoryUsage {
+    qint64 reserved = 0;
+    qint64 used     = 0;
+
+    MemoryUsage& operator+=(const MemoryUsage& m) { reserved += m.reserved; used += m.used; return *this; }
+};
+
+// usage of a Qt or std container of trivially sized elements
+template <class Container>
+MemoryUsage containerUsage(const Container& c)
+{
+    using T = typename Container::value_type;
+    return { qint64(c.capacity() * sizeof(T)), qint64(c.size() * sizeof(T)) };
+}
+
+namespace MemoryTracker {
+    void allocate(MemoryCategory c, qint64 bytes);  // counts one allocation of bytes
+    void release (MemoryCategory c, qint64 bytes);  // counts one release of bytes
+
+    struct CategoryStats {
+        QString name;
+        qint64  current     = 0;
+        qint64  peak        = 0;
+        qint64  allocations = 0;
+        qint64  releases    = 0;
+    };
+
+    // all categories (publishes the calling thread's pending counts first)
+    std::vector<CategoryStats> stats();
+
+    // restarts peak tracking at the current values, e.g. before a benchmark
+    void resetPeaks();
+
+    QString categoryName(MemoryCategory c);
+}
+
+// accounts bytes for the lifetime of the guard, e.g. of a temporary array
+class TrackedBytes
+{
+private:
+    MemoryCategory category;
+    qint64         bytes;
+
+public:
+    TrackedBytes(MemoryCategory c, qint64 b): category(c), bytes(b) { MemoryTracker::allocate(category, bytes); }
+    ~TrackedBytes() { MemoryTracker::release(category, bytes); }
+
+    TrackedBytes(const TrackedBytes&)            = delete;
+    TrackedBytes& operator=(const TrackedBytes&) = delete;
+};
+
+// class-specific operator new/delete that account every instance in category
+#define TRACK_INSTANCES(category)                                                                           \
+    static void* operator new(std::size_t size)            { MemoryTracker::allocate(category, qint64(size)); \
+                                                             return ::operator new(size); }                  \
+    static void  operator delete(void* p, std::size_t size) { MemoryTracker::release(category, qint64(size));  \
+                                                             ::operator delete(p); }
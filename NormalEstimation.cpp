@@ -0,0 +1,45 @@
+//
+//  Normal estimation for point clouds
+//
+#include "NormalEstimation.h"
+#include "Parallel.h"
+
+#include <Eigen/Eigenvalues>
+
+void estimateNormals(PointCloud& cloud, const KdNode* kdRoot, int k, const QVector3D& sensorOrigin)
+{
+    QVector<QVector3D> normals(cloud.size(), QVector3D(0,0,0));
+    QVector3D*         out = normals.data();
+
+    parallelFor(cloud.size(), [&](unsigned, qsizetype b, qsizetype e) {
+        std::vector<std::pair<float,int>>               nn;
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix3f>  solver;
+
+        for (qsizetype i = b; i < e; ++i) {
+            kNearestNeighbors(kdRoot, cloud[i], k, nn);
+            if (nn.size() < 3) continue;
+
+            // centered covariance of the neighbourhood
+            Eigen::Vector3f mean = Eigen::Vector3f::Zero();
+            for (const auto& n: nn) mean += Eigen::Vector3f(cloud[n.second][0], cloud[n.second][1], cloud[n.second][2]);
+            mean /= float(nn.size());
+
+            Eigen::Matrix3f cov = Eigen::Matrix3f::Zero();
+            for (const auto& n: nn) {
+                Eigen::Vector3f d = Eigen::Vector3f(cloud[n.second][0], cloud[n.second][1], cloud[n.second][2]) - mean;
+                cov.noalias() += d * d.transpose();
+            }
+
+            // eigenvalues come in increasing order, i.e. column 0 is the normal
+            solver.computeDirect(cov);
+            Eigen::Vector3f n = solver.eigenvectors().col(0);
+            QVector3D normal(n.x(), n.y(), n.z());
+
+            // orient towards the sensor
+            if (QVector3D::dotProduct(normal, sensorOrigin - QVector3D(cloud[i])) < 0.0f) normal = -normal;
+            out[i] = normal.normalized();
+        }
+    }, 1024);
+
+    cloud.setNormals(std::move(normals));
+}
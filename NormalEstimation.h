@@ -0,0 +1,18 @@
+//
+//  Normal estimation for point clouds
+//
+//  For every point the covariance of its k nearest neighbours (from the kd-tree)
+//  is decomposed in closed form; the eigenvector of the smallest eigenvalue is the
+//  normal. Normals are oriented towards the sensor origin.
+//
+#pragma once
+
+#include "PointCloud.h"
+#include "KdTree.h"
+
+// Estimates the normals of all points of cloud in parallel and stores them in the cloud.
+// kdRoot has to be built over exactly these points.
+void estimateNormals(PointCloud&      cloud,
+                     const KdNode*    kdRoot,
+                     int              k            = 16,
+                     const QVector3D& sensorOrigin = QVector3D(0,0,0));
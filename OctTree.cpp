@@ -1,6 +1,5 @@
 #include "OctTree.h"
-#include "Cube.h"
-#include <QMatrix4x4>
+#include "InstancedBoxes.h"
 #include <algorithm>
 
 // ------------------------------------------------------------------
@@ -26,6 +25,7 @@ OctNode* buildOctTree(const QVector<QVector4D>& pts,
 
     // Knoten mit aktueller Indexliste und AABB anlegen
     auto* node = new OctNode{ indices, bbMin, bbMax, {} };
+    MemoryTracker::allocate(MemoryCategory::MC_OCT_INDICES, node->indices.capacity() * qint64(sizeof(int)));
 
     // Abbruch, wenn maxDepth erreicht oder zu wenige Punkte
     if (depth == maxDepth || indices.size() <= 5)
@@ -62,48 +62,74 @@ OctNode* buildOctTree(const QVector<QVector4D>& pts,
 
 
 // ------------------------------------------------------------------
-// 2) Visualisierung der ersten Ebenen des Oct-Trees
+// Speicher des Baums
+// ------------------------------------------------------------------
+MemoryUsage octTreeMemory(const OctNode* root)
+{
+    MemoryUsage usage;
+    std::vector<const OctNode*> stack;
+    if (root) stack.push_back(root);
+    while (!stack.empty()) {
+        const OctNode* n = stack.back();
+        stack.pop_back();
+        usage += { qint64(sizeof(OctNode)), qint64(sizeof(OctNode)) };
+        usage += containerUsage(n->indices);
+        for (const OctNode* c: n->children)
+            if (c) stack.push_back(c);
+    }
+    return usage;
+}
+
+
+// ------------------------------------------------------------------
+// 2) Boxen der Oct-Tree-Zellen
 // ------------------------------------------------------------------
 // node     : aktueller Knoten im Oct-Tree
 // depth    : aktuelle Rekursionstiefe (0 = Root)
+// minDepth : minimale darzustellende Tiefe
 // maxDepth : maximale darzustellende Tiefe (inklusive)
-// scene    : SceneManager, der die Cubes rendert
-void visualizeOctTree(OctNode* node,
-                      int depth,
-                      int maxDepth,
-                      SceneManager& scene)
+// boxes    : Instanzen (AABB, Farbe, Transparenz), an die angehängt wird
+void octTreeBoxes(const OctNode*        node,
+                  int                   depth,
+                  int                   minDepth,
+                  int                   maxDepth,
+                  QVector<BoxInstance>& boxes)
 {
     // Abbruch, wenn kein Knoten oder Tiefe überschritten
     if (!node || depth > maxDepth)
         return;
 
-    // AABB-Koordinaten auslesen
-    QVector4D mn = node->bbMin;
-    QVector4D mx = node->bbMax;
-
-    // Volle Kantenlänge des AABB berechnen
-    QVector3D size3(
-        mx.x() - mn.x(),
-        mx.y() - mn.y(),
-        mx.z() - mn.z()
-        );
-
-    // Unit-Cube um den Ursprung anlegen (Eckpunkte [0..1]^3)
-    Cube* cube = new Cube(QVector4D(0,0,0,1), 1.0f);
+    // AABB direkt als Instanz übernehmen; tiefere Ebenen werden transparenter
+    if (depth >= minDepth) {
+        const float t = qMax(0.2f, 1.0f - 0.1f * depth);
+        boxes.append({ node->bbMin.toVector3D(), node->bbMax.toVector3D(),
+                       QVector4D(COLOR_SCENE.redF(), COLOR_SCENE.greenF(), COLOR_SCENE.blueF(), t) });
+    }
 
-    // Transformationsmatrix:
-    //  a) Translate zum AABB-Min (untere Ecke)
-    //  b) Scale auf volle Kantenlänge
-    QMatrix4x4 M;
-    M.translate(mn.x(), mn.y(), mn.z());
-    M.scale(size3.x(), size3.y(), size3.z());
-    cube->affineMap(M);
+    // Rekursion über alle vorhandenen 8 Kinder
+    for (const OctNode* child: node->children)
+        octTreeBoxes(child, depth + 1, minDepth, maxDepth, boxes);
+}
 
-    // Cube in die Szene einhängen
-    scene.push_back(cube);
 
-    // Rekursive Visualisierung aller vorhandenen 8 Kinder
-    for (int i = 0; i < 8; ++i) {
-        visualizeOctTree(node->children[i], depth + 1, maxDepth, scene);
-    }
+// ------------------------------------------------------------------
+// 3) Visualisierung der Ebenen minDepth…maxDepth des Oct-Trees
+// ------------------------------------------------------------------
+// root     : Wurzel des Oct-Trees
+// minDepth : minimale darzustellende Tiefe
+// maxDepth : maximale darzustellende Tiefe (inklusive)
+// scene    : SceneManager, der die Würfel rendert
+// layer    : Gruppenknoten, unter dem die Würfel eingehängt werden
+SceneHandle visualizeOctTree(const OctNode* root,
+                             int            minDepth,
+                             int            maxDepth,
+                             SceneManager&  scene,
+                             SceneHandle    layer)
+{
+    // alle Zellen in einem Objekt, das mit einem einzigen instanzierten Draw-Call gezeichnet wird
+    QVector<BoxInstance> boxes;
+    octTreeBoxes(root, 0, minDepth, maxDepth, boxes);
+    if (boxes.isEmpty())
+        return SceneHandle();
+    return scene.add(new InstancedBoxes(std::move(boxes), BoxStyle::BS_EDGES), layer);
 }
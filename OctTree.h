@@ -2,7 +2,7 @@
 #include <QVector>
 #include <QVector4D>
 #include "SceneManager.h"
-#include "Cube.h"
+#include "MemoryTracker.h"
 
 // Ein Oct-Tree–Knoten
 struct OctNode {
@@ -14,7 +14,10 @@ struct OctNode {
     ~OctNode() {
         for (auto*& c : children)
             delete c;
+        MemoryTracker::release(MemoryCategory::MC_OCT_INDICES, indices.capacity() * qint64(sizeof(int)));
     }
+
+    TRACK_INSTANCES(MemoryCategory::MC_OCT_TREE)
 };
 
 // Rekursiver Aufbau bis maxDepth
@@ -25,9 +28,20 @@ OctNode* buildOctTree(const QVector<QVector4D>& pts,
                       int depth,
                       int maxDepth);
 
-// Zeichnet alle Knoten bis Tiefe maxDepth als Würfel in den SceneManager
-// (nur Deklaration – keine Implementierung im Header!)
-void visualizeOctTree(OctNode* node,
-                      int depth,
-                      int maxDepth,
-                      SceneManager& scene);
+// Speicher des Baums: Knoten und ihre Index-Listen (reserviert = Kapazitäten)
+MemoryUsage octTreeMemory(const OctNode* root);
+
+// Hängt die AABBs aller Knoten der Tiefe minDepth…maxDepth als Instanzen an boxes an; node liegt in der Tiefe depth
+void octTreeBoxes(const OctNode*        node,
+                  int                   depth,
+                  int                   minDepth,
+                  int                   maxDepth,
+                  QVector<BoxInstance>& boxes);
+
+// Zeichnet alle Knoten der Tiefe minDepth…maxDepth als Würfel in den SceneManager, und zwar als ein
+// InstancedBoxes-Objekt (Kind des Knotens layer), und gibt dessen Handle zurück (ungültig, falls leer)
+SceneHandle visualizeOctTree(const OctNode* root,
+                             int            minDepth,
+                             int            maxDepth,
+                             SceneManager&  scene,
+                             SceneHandle    layer = SceneHandle());
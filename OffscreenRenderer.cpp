@@ -0,0 +1,201 @@
+//
+//  Offscreen rendering of scenes into images, without window or display
+//
+#include "OffscreenRenderer.h"
+#include "SceneManager.h"
+#include "Profiler.h"
+
+#include <QDebug>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QSurfaceFormat>
+
+#include <algorithm>
+#include <cstring>
+
+OffscreenRenderer::OffscreenRenderer()
+{}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+    if (!fbo || !context.makeCurrent(&surface)) return;
+    flush();
+    releaseTargets();
+    renderCamera.releaseGL();
+    context.doneCurrent();
+}
+
+bool OffscreenRenderer::create(int _width, int _height, int _samples, int pbos)
+{
+    QSurfaceFormat format;
+    format.setVersion(3, 2);
+    format.setProfile(QSurfaceFormat::CompatibilityProfile);    // RenderCamera draws in immediate mode
+    format.setDepthBufferSize(24);
+    surface.setFormat(format);
+    surface.create();
+    context.setFormat(format);
+    if (!surface.isValid() || !context.create() || !context.makeCurrent(&surface)) return false;
+    if (context.isOpenGLES() || context.format().version() < qMakePair(3,2)) return false;
+
+    width   = std::max(_width,  1);
+    height  = std::max(_height, 1);
+    samples = std::max(_samples, 0);
+    readbacks.resize(std::max(pbos, 1));
+    createTargets();
+    return fbo->isValid();
+}
+
+void OffscreenRenderer::createTargets()
+{
+    QOpenGLFramebufferObjectFormat format;
+    format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    format.setSamples(samples);
+    fbo = std::make_unique<QOpenGLFramebufferObject>(width, height, format);
+    if (fbo->format().samples() > 0) resolved = std::make_unique<QOpenGLFramebufferObject>(width, height);
+
+    QOpenGLExtraFunctions* gl = context.extraFunctions();
+    for (Readback& r: readbacks) {
+        gl->glGenBuffers(1, &r.pbo);
+        gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+        gl->glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(4) * width * height, nullptr, GL_STREAM_READ);
+    }
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    nextReadback = 0;
+}
+
+void OffscreenRenderer::releaseTargets()
+{
+    QOpenGLExtraFunctions* gl = context.extraFunctions();
+    for (Readback& r: readbacks) {
+        if (r.fence) gl->glDeleteSync(static_cast<GLsync>(r.fence));
+        gl->glDeleteBuffers(1, &r.pbo);
+        r = Readback();
+    }
+    resolved.reset();
+    fbo     .reset();
+}
+
+void OffscreenRenderer::resize(int _width, int _height)
+{
+    if (!fbo || (_width == width && _height == height)) return;
+    context.makeCurrent(&surface);
+    flush();
+    releaseTargets();
+    width  = std::max(_width,  1);
+    height = std::max(_height, 1);
+    createTargets();
+}
+
+void OffscreenRenderer::setPose(const CameraPose& pose, const QVector3D& center, float radius)
+{
+    renderCamera.setProjectionMatrix(pose.projection(float(width) / float(height), center, radius));
+    renderCamera.lookAt(pose.eye, pose.center, pose.up);
+}
+
+void OffscreenRenderer::complete(Readback& r)
+{
+    PROFILE_SCOPE("offscreen readback");
+    QOpenGLExtraFunctions* gl    = context.extraFunctions();
+    GLsync                 fence = static_cast<GLsync>(r.fence);
+    while (gl->glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+    gl->glDeleteSync(fence);
+
+    // GL's rows run bottom-up; RGBX, since blending leaves the framebuffer's alpha below one
+    const qsizetype stride = qsizetype(4) * width;
+    QImage          image(width, height, QImage::Format_RGBX8888);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+    const uchar* pixels = static_cast<const uchar*>(gl->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, stride * height, GL_MAP_READ_BIT));
+    if (pixels) {
+        for (int y = 0; y < height; y++) std::memcpy(image.scanLine(height - 1 - y), pixels + y * stride, size_t(stride));
+        gl->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    const int frame = r.frame;
+    r.fence = nullptr;
+    r.frame = -1;
+
+    // a failed readback is skipped rather than delivering uninitialized pixels
+    if (!pixels) {
+        qWarning() << "OffscreenRenderer: readback of frame" << frame << "failed, skipped";
+        return;
+    }
+    if (sink) sink(frame, image);
+}
+
+void OffscreenRenderer::renderFrame(const SceneManager& scene, int frame)
+{
+    renderFrame([&scene](const RenderCamera& camera) { scene.draw(camera); }, frame);
+}
+
+void OffscreenRenderer::renderFrame(const std::function<void(const RenderCamera&)>& draw, int frame)
+{
+    PROFILE_SCOPE("offscreen frame");
+    context.makeCurrent(&surface);
+    QOpenGLExtraFunctions* gl = context.extraFunctions();
+    const int              n  = int(readbacks.size());
+
+    // the PBO of the oldest frame is reused, that frame has to be delivered first
+    Readback& r  = readbacks[nextReadback];
+    nextReadback = (nextReadback + 1) % n;
+    if (r.frame >= 0) complete(r);
+
+    // same state as the GLWidget
+    fbo->bind();
+    gl->glViewport(0, 0, width, height);
+    gl->glClearColor(background.redF(), background.greenF(), background.blueF(), 1.0f);
+    gl->glEnable(GL_BLEND);
+    gl->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    gl->glEnable(GL_DEPTH_TEST);
+    gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    renderCamera.releaseStaleBuffers();
+    draw(renderCamera);
+
+    // asynchronous readback into the PBO, fenced
+    const QOpenGLFramebufferObject* source = fbo.get();
+    if (resolved) {
+        QOpenGLFramebufferObject::blitFramebuffer(resolved.get(), fbo.get());
+        source = resolved.get();
+    }
+    gl->glBindFramebuffer(GL_READ_FRAMEBUFFER, source->handle());
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, r.pbo);
+    gl->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl->glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    r.fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    r.frame = frame;
+    gl->glFlush();
+
+    // deliver older frames, which are done already, in order
+    for (int k = 0; k < n - 1; k++) {
+        Readback& o = readbacks[(nextReadback + k) % n];
+        if (o.frame < 0) continue;
+        const GLenum status = gl->glClientWaitSync(static_cast<GLsync>(o.fence), 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+        complete(o);
+    }
+}
+
+void OffscreenRenderer::flush()
+{
+    if (!fbo) return;
+    context.makeCurrent(&surface);
+    const int n = int(readbacks.size());
+    for (int k = 0; k < n; k++) {
+        Readback& r = readbacks[(nextReadback + k) % n];
+        if (r.frame >= 0) complete(r);
+    }
+}
+
+QImage OffscreenRenderer::renderImage(const SceneManager& scene)
+{
+    flush();
+
+    QImage    image;
+    FrameSink saved = std::move(sink);
+    sink = [&image](int, const QImage& i) { image = i; };
+    renderFrame(scene, 0);
+    flush();
+    sink = std::move(saved);
+    return image;
+}
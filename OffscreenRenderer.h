@@ -0,0 +1,93 @@
+//
+//  Offscreen rendering of scenes into images, without window or display
+//
+//  Owns an OpenGL context on a QOffscreenSurface, a framebuffer object (multisampled, plus
+//  a resolve target) and a RenderCamera. Frames are read back asynchronously: glReadPixels
+//  goes into one of several pixel buffer objects and is fenced, the pixels are mapped only
+//  when the PBO is reused or flushed, so the GPU (or llvmpipe's rasterizer threads) works on
+//  the next frames meanwhile. Finished frames are handed to the frame sink in order, e.g.
+//  an ImageSequenceWriter that encodes them on other threads.
+//
+//  Needs a compatibility context of OpenGL 3.2 (fences), as provided by Mesa's llvmpipe.
+//  Without display, run with QT_QPA_PLATFORM=offscreen (with Xvfb) or eglfs on surfaceless
+//  EGL; LIBGL_ALWAYS_SOFTWARE=1 forces llvmpipe. The renderer must be created, used and
+//  destroyed on the thread of the QGuiApplication.
+//
+#pragma once
+
+#include "CameraPath.h"
+#include "RenderCamera.h"
+
+#include <QColor>
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class QOpenGLFramebufferObject;
+class SceneManager;
+
+class OffscreenRenderer
+{
+public:
+    using FrameSink = std::function<void(int frame, const QImage& image)>;
+
+private:
+    struct Readback {
+        unsigned pbo   = 0;
+        void*    fence = nullptr;               // GLsync
+        int      frame = -1;                    // -1 if idle
+    };
+
+    QOffscreenSurface                         surface;
+    QOpenGLContext                            context;
+    std::unique_ptr<QOpenGLFramebufferObject> fbo;          // render target
+    std::unique_ptr<QOpenGLFramebufferObject> resolved;     // single-sampled copy for readback, if multisampled
+    std::vector<Readback>                     readbacks;    // ring of PBOs
+    int                                       nextReadback = 0;
+    int                                       width = 0, height = 0, samples = 0;
+    QColor                                    background = QColor(255, 255, 255);
+    FrameSink                                 sink;
+    RenderCamera                              renderCamera;
+
+    void createTargets();
+    void releaseTargets();
+    void complete(Readback& r);                 // waits for r, delivers its frame and makes it idle
+
+public:
+    OffscreenRenderer();
+    ~OffscreenRenderer();
+
+    // Creates the context and a framebuffer of width x height with up to samples samples per pixel
+    // and pbos pixel buffers. Returns false if there is no suitable OpenGL.
+    bool create(int width, int height, int samples = 4, int pbos = 3);
+
+    // resizes the framebuffer, pending frames are flushed first
+    void resize(int width, int height);
+
+    int  getWidth () const { return width;  }
+    int  getHeight() const { return height; }
+    void setBackground(const QColor& c) { background = c; }
+    void setFrameSink (FrameSink s)     { sink = std::move(s); }
+
+    // camera used by all render calls; setPose sets projection and view for a pose looking at
+    // the sphere (center,radius), whose extent bounds the near and far plane
+    RenderCamera& camera() { return renderCamera; }
+    void setPose(const CameraPose& pose, const QVector3D& center, float radius);
+
+    // Draws into the cleared framebuffer and queues the asynchronous readback of the result
+    // as frame; frames completed in the meantime are delivered to the sink. Frames whose
+    // readback fails (the PBO cannot be mapped) are skipped with a warning.
+    void renderFrame(const SceneManager& scene, int frame);
+    void renderFrame(const std::function<void(const RenderCamera&)>& draw, int frame);
+
+    // waits for all queued frames and delivers them
+    void flush();
+
+    // draws and reads back synchronously, e.g. for a single thumbnail; bypasses the sink, null
+    // if the readback failed
+    QImage renderImage(const SceneManager& scene);
+};
@@ -0,0 +1,180 @@
+//
+//  Export of point clouds as PLY
+//
+#include "PLYWriter.h"
+#include "Parallel.h"
+#include "Profiler.h"
+
+#include <QFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+const char* const typeNames[] = { "uchar", "int", "float" };
+const int         typeSizes[] = { 1, 4, 4 };
+
+// layout of a vertex record
+struct Layout {
+    const PointCloud&          cloud;
+    QVector<PLYChannel>        channels;        // of the cloud, then the given ones
+    bool                       global;          // double global instead of float local positions
+    bool                       normals;
+    int                        size;            // bytes of a binary record
+    int                        normalOffset;
+    QVector<int>               offsets;         // of the channels in a record
+
+    Layout(const PointCloud& c, const QVector<PLYChannel>& ch, bool g, bool n, bool attributes)
+        : cloud(c), global(g), normals(n), size(g ? 24 : 12), normalOffset(size)
+    {
+        if (attributes && cloud.hasChannel(PointChannel::PC_COLOR)) {
+            // alpha only if some point is not opaque
+            const char* const names[] = { "red", "green", "blue", "alpha" };
+            const uchar*      rgba    = reinterpret_cast<const uchar*>(cloud.getColors().constData());
+            bool              alpha   = false;
+            for (qsizetype i = 0; i < cloud.size() && !alpha; i++) alpha = rgba[4*i + 3] != 255;
+            for (int k = 0; k < (alpha ? 4 : 3); k++) channels.append({ names[k], PLYChannel::PC_UCHAR, rgba + k, 4, {} });
+        }
+        if (attributes && cloud.hasChannel(PointChannel::PC_INTENSITY)) channels.append(PLYChannel::floats("intensity", cloud.getIntensities()));
+        if (attributes && cloud.hasChannel(PointChannel::PC_LABEL))     channels.append(PLYChannel::ints  ("label",     cloud.getLabels()));
+        channels.append(ch);
+
+        if (normals) size += 12;
+        for (const PLYChannel& channel: channels) {
+            offsets.append(size);
+            size += typeSizes[channel.type];
+        }
+    }
+
+    // records of [begin,end), one strided pass per channel
+    void binary(char* out, qsizetype begin, qsizetype end) const
+    {
+        const QVector4D* p = cloud.constData();
+        if (global)
+            for (qsizetype i = begin; i < end; i++) {
+                const GlobalPoint g = cloud.getFrame().toGlobal(p[i].toVector3D());
+                memcpy(out + (i - begin) * size, g.data(), 24);
+            }
+        else
+            for (qsizetype i = begin; i < end; i++) memcpy(out + (i - begin) * size, &p[i], 12);
+        if (normals) {
+            const QVector3D* nrm = cloud.getNormals().constData();
+            for (qsizetype i = begin; i < end; i++) memcpy(out + (i - begin) * size + normalOffset, &nrm[i], 12);
+        }
+        for (int c = 0; c < channels.size(); c++) {
+            const int   bytes  = typeSizes[channels[c].type];
+            const int   stride = channels[c].stride > 0 ? channels[c].stride : bytes;
+            const char* src    = static_cast<const char*>(channels[c].data);
+            for (qsizetype i = begin; i < end; i++) memcpy(out + (i - begin) * size + offsets[c], src + i * stride, size_t(bytes));
+        }
+    }
+
+    // lines of [begin,end), %.9g resp. %.17g keep floats resp. doubles exact
+    QByteArray ascii(qsizetype begin, qsizetype end) const
+    {
+        QByteArray text;
+        text.reserve((end - begin) * ((global ? 64 : 40) + (normals ? 40 : 0) + 12 * channels.size()));
+        char line[96];
+        for (qsizetype i = begin; i < end; i++) {
+            const QVector4D& p = cloud[i];
+            if (global) {
+                const GlobalPoint g = cloud.getFrame().toGlobal(p.toVector3D());
+                text.append(line, snprintf(line, sizeof(line), "%.17g %.17g %.17g", g[0], g[1], g[2]));
+            }
+            else text.append(line, snprintf(line, sizeof(line), "%.9g %.9g %.9g", p.x(), p.y(), p.z()));
+            if (normals) {
+                const QVector3D& n = cloud.getNormals()[i];
+                text.append(line, snprintf(line, sizeof(line), " %.9g %.9g %.9g", n.x(), n.y(), n.z()));
+            }
+            for (const PLYChannel& channel: channels) {
+                const int   stride = channel.stride > 0 ? channel.stride : typeSizes[channel.type];
+                const char* value  = static_cast<const char*>(channel.data) + i * stride;
+                int         len    = 0;
+                switch (channel.type) {
+                case PLYChannel::PC_UCHAR: len = snprintf(line, sizeof(line), " %u",   unsigned(*reinterpret_cast<const uchar*>(value))); break;
+                case PLYChannel::PC_INT:   len = snprintf(line, sizeof(line), " %d",   *reinterpret_cast<const int*  >(value));           break;
+                case PLYChannel::PC_FLOAT: len = snprintf(line, sizeof(line), " %.9g", *reinterpret_cast<const float*>(value));           break;
+                }
+                text.append(line, len);
+            }
+            text.append('\n');
+        }
+        return text;
+    }
+};
+}
+
+PLYEncoding encodingForFile(const QString& filePath)
+{
+    return filePath.endsWith(".plyz", Qt::CaseInsensitive) ? PLYEncoding::PE_COMPRESSED : PLYEncoding::PE_BINARY;
+}
+
+void writePLY(const QString& filePath, const PointCloud& cloud, const QVector<PLYChannel>& channels, const PLYWriteOptions& options)
+{
+    PROFILE_SCOPE("writePLY");
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        throw runtime_error("cannot write " + filePath.toStdString());
+
+    const qsizetype n     = cloud.size();
+    const qsizetype chunk = std::max(options.chunkPoints, 1);
+    const auto&     frame = cloud.getFrame();
+    const Layout    layout(cloud, channels, options.originalUnits, options.normals && cloud.hasNormals(), options.attributes);
+
+    // header
+    QByteArray header = "ply\nformat ";
+    if (options.encoding == PLYEncoding::PE_ASCII) header += "ascii";
+    else header += Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? "binary_little_endian" : "binary_big_endian";
+    if (options.encoding == PLYEncoding::PE_COMPRESSED) header += "_zlib";     // rejected by other readers
+    header += " 1.0\n";
+    if (!options.originalUnits) {                   // also the identity, else loadPLY takes the file as foreign
+        header += "comment framework scale " + QByteArray::number(frame.scale, 'g', 17) + "\n";
+        header += "comment framework origin " + QByteArray::number(frame.origin[0], 'g', 17) + " " +
+                  QByteArray::number(frame.origin[1], 'g', 17) + " " + QByteArray::number(frame.origin[2], 'g', 17) + "\n";
+    }
+    if (options.encoding == PLYEncoding::PE_COMPRESSED)
+        header += "comment framework chunks " + QByteArray::number(chunk) + " zlib\n";
+    header += "element vertex " + QByteArray::number(n) + "\n";
+    header += options.originalUnits ? "property double x\nproperty double y\nproperty double z\n"
+                                    : "property float x\nproperty float y\nproperty float z\n";
+    if (layout.normals) header += "property float nx\nproperty float ny\nproperty float nz\n";
+    for (const PLYChannel& channel: layout.channels) header += QByteArray("property ") + typeNames[channel.type] + " " + channel.name + "\n";
+    header += "end_header\n";
+    if (file.write(header) != header.size()) throw runtime_error("cannot write " + filePath.toStdString());
+
+    // batches of one chunk per worker, serialized (and compressed) in parallel, written in order
+    const qsizetype     chunks = (n + chunk - 1) / chunk;
+    const qsizetype     batch  = workerCount();
+    QVector<QByteArray> buffers(batch);
+    for (qsizetype b = 0; b < chunks; b += batch) {
+        const qsizetype m = std::min(batch, chunks - b);
+        parallelFor(m, [&](unsigned, qsizetype begin, qsizetype end) {
+            for (qsizetype c = begin; c < end; c++) {
+                const qsizetype first = (b + c) * chunk;
+                const qsizetype last  = std::min(first + chunk, n);
+                if (options.encoding == PLYEncoding::PE_ASCII) {
+                    buffers[c] = layout.ascii(first, last);
+                    continue;
+                }
+                QByteArray records(layout.size * (last - first), Qt::Uninitialized);
+                layout.binary(records.data(), first, last);
+                if (options.encoding == PLYEncoding::PE_BINARY) {
+                    buffers[c] = std::move(records);
+                    continue;
+                }
+                const QByteArray compressed = qCompress(records, options.level);
+                const quint32    bytes      = qToLittleEndian(quint32(compressed.size()));
+                buffers[c] = QByteArray(reinterpret_cast<const char*>(&bytes), sizeof(bytes)) + compressed;
+            }
+        }, 1);
+        for (qsizetype c = 0; c < m; c++) {
+            if (file.write(buffers[c]) != buffers[c].size()) throw runtime_error("cannot write " + filePath.toStdString());
+            buffers[c].clear();
+        }
+    }
+}
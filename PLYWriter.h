@@ -0,0 +1,73 @@
+//
+//  Export of point clouds as PLY
+//
+//  Binary PLY stores the vertices as interleaved records, so the per-point channels
+//  (positions, normals, colors, ...) are transposed into records chunk by chunk: each
+//  channel is copied with one strided pass per chunk, the chunks are serialized on all
+//  cores and written in order. ASCII output is formatted the same way.
+//
+//  Compressed files (".plyz") have the PLY header of a binary file with the format
+//  "binary_little_endian_zlib" (or big endian), which other PLY readers reject instead of
+//  reading garbage, followed by chunks of chunkPoints records, each compressed with zlib
+//  (qCompress) in parallel and prefixed by its compressed size as little-endian uint32.
+//  PointCloud::loadPLY reads all three kinds.
+//
+//  Clouds store float coordinates local to a double-precision frame (PointCloud::getFrame).
+//  The writer keeps the points as they are and records the frame as "comment framework scale
+//  <s>" and "comment framework origin <x> <y> <z>", so a saved cloud is loaded again bit for
+//  bit; with originalUnits the global coordinates are reconstructed in double precision and
+//  written as doubles instead, for tools that do not know the comments.
+//
+#pragma once
+
+#include "PointCloud.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+enum class PLYEncoding {PE_ASCII, PE_BINARY, PE_COMPRESSED};
+
+// an additional per-point property with one value per point; the factories keep (a shallow copy of)
+// the vector alive with the channel, so temporaries are fine, data given directly has to outlive it
+struct PLYChannel {
+    enum Type {PC_UCHAR, PC_INT, PC_FLOAT};
+
+    QByteArray                  name;
+    Type                        type;
+    const void*                 data;
+    int                         stride = 0;     // bytes from one point's value to the next, 0: packed
+    std::shared_ptr<const void> owner;          // of data, if held by the channel
+
+    static PLYChannel uchars(const QByteArray& name, QVector<uchar> v) { return held(name, PC_UCHAR, std::move(v)); }
+    static PLYChannel ints  (const QByteArray& name, QVector<int>   v) { return held(name, PC_INT,   std::move(v)); }
+    static PLYChannel floats(const QByteArray& name, QVector<float> v) { return held(name, PC_FLOAT, std::move(v)); }
+
+private:
+    template<class T> static PLYChannel held(const QByteArray& name, Type type, QVector<T> v)
+    {
+        auto owned = std::make_shared<const QVector<T>>(std::move(v));
+        return { name, type, owned->constData(), 0, owned };
+    }
+};
+
+struct PLYWriteOptions {
+    PLYEncoding encoding      = PLYEncoding::PE_BINARY;
+    bool        normals       = true;       // writes the normals, if the cloud has them
+    bool        attributes    = true;       // writes the cloud's colors, intensities and labels
+    bool        originalUnits = false;      // writes global coordinates instead of recording the frame
+    int         chunkPoints   = 1 << 16;    // records per chunk
+    int         level         = -1;         // zlib level of PE_COMPRESSED, -1: default
+};
+
+// encoding by the file's extension, ".plyz" is compressed
+PLYEncoding encodingForFile(const QString& filePath);
+
+// Writes the cloud with its normals, its attribute channels as red, green, blue (alpha, if not
+// opaque), intensity and label, and the given channels. Throws runtime_error on failure.
+void writePLY(const QString&              filePath,
+              const PointCloud&           cloud,
+              const QVector<PLYChannel>&  channels = {},
+              const PLYWriteOptions&      options  = {});
@@ -0,0 +1,110 @@
+//
+//  Minimal helpers to spread loops over all cores
+//
+//  parallelFor splits [0,n) into at most workerCount() contiguous chunks and runs
+//  f(chunk, begin, end) for each of them on its own thread. The chunk index lets
+//  the caller keep per-thread accumulators without any locking.
+//
+//  A ThreadBudget limits workerCount() for the calling thread, e.g. when several
+//  files are processed concurrently; threads started by parallelFor or workerThread
+//  inherit the budget of the thread that started them.
+//
+#pragma once
+
+#include <QtGlobal>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// thread budget of the calling thread, 0 for all cores
+inline thread_local unsigned threadBudget = 0;
+
+// number of threads used by the parallel kernels
+inline unsigned workerCount()
+{
+    if (threadBudget) return threadBudget;
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// limits the parallel kernels called by this thread to n threads while in scope
+class ThreadBudget
+{
+private:
+    unsigned previous;
+
+public:
+    explicit ThreadBudget(unsigned n): previous(threadBudget) { threadBudget = std::max(n, 1u); }
+    ~ThreadBudget() { threadBudget = previous; }
+
+    ThreadBudget(const ThreadBudget&)            = delete;
+    ThreadBudget& operator=(const ThreadBudget&) = delete;
+};
+
+// starts a thread running f under the budget of the calling thread
+template <class F>
+std::thread workerThread(F&& f)
+{
+    return std::thread([budget = threadBudget, f = std::forward<F>(f)]() mutable {
+        threadBudget = budget;
+        f();
+    });
+}
+
+// number of chunks parallelFor will use for n items with the given grain size
+inline unsigned parallelChunks(qsizetype n, qsizetype grain = 1 << 14)
+{
+    return unsigned(std::clamp<qsizetype>(n / std::max<qsizetype>(grain, 1), 1, workerCount()));
+}
+
+// calls f(chunk, begin, end) on disjoint chunks of [0,n), small ranges stay on the calling thread
+template <class F>
+void parallelFor(qsizetype n, F&& f, qsizetype grain = 1 << 14)
+{
+    const unsigned chunks = parallelChunks(n, grain);
+    if (chunks == 1) {
+        f(0u, qsizetype(0), n);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    threads.reserve(chunks - 1);
+    for (unsigned c = 1; c < chunks; ++c)
+        threads.push_back(workerThread([&f, n, c, chunks] { f(c, n * c / chunks, n * (c + 1) / chunks); }));
+    f(0u, qsizetype(0), n / chunks);
+    for (auto& t: threads) t.join();
+}
+
+// sorts [first,last): chunks are sorted in parallel and then merged pairwise
+template <class It, class Cmp>
+void parallelSort(It first, It last, Cmp comp)
+{
+    const qsizetype n      = last - first;
+    const unsigned  chunks = parallelChunks(n);
+    if (chunks == 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    std::vector<qsizetype> bounds(chunks + 1);
+    for (unsigned c = 0; c <= chunks; ++c) bounds[c] = n * c / chunks;
+
+    parallelFor(chunks, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype c = b; c < e; ++c)
+            std::sort(first + bounds[c], first + bounds[c+1], comp);
+    }, 1);
+
+    for (qsizetype width = 1; width < chunks; width *= 2) {
+        const qsizetype pairs = (chunks + 2*width - 1) / (2*width);
+        parallelFor(pairs, [&](unsigned, qsizetype b, qsizetype e) {
+            for (qsizetype p = b; p < e; ++p) {
+                const qsizetype lo  = 2*width*p;
+                const qsizetype mid = std::min<qsizetype>(lo +   width, chunks);
+                const qsizetype hi  = std::min<qsizetype>(lo + 2*width, chunks);
+                if (mid < hi)
+                    std::inplace_merge(first + bounds[lo], first + bounds[mid], first + bounds[hi], comp);
+            }
+        }, 1);
+    }
+}
@@ -0,0 +1,161 @@
+//
+//  A class for perspective (pinhole) cameras
+//
+#include "PerspectiveCamera.h"
+#include "Hexahedron.h"
+#include "PointCloud.h"
+#include "PointKernels.h"
+#include "QtConvenience.h"
+
+#include <cmath>
+
+PerspectiveCamera::PerspectiveCamera(const QVector4D&  _origin,
+                                     const QMatrix4x4& _rotation,
+                                     float             _focalLength,
+                                     float             _imageWidth,
+                                     float             _imageHeight,
+                                     float             _zNear):
+    origin(_origin), rotation(_rotation),
+    focalLength(_focalLength),
+    imageWidth(_imageWidth), imageHeight(_imageHeight),
+    zNear(_zNear)
+{
+    type = SceneObjectType::ST_PERSPECTIVE_CAMERA;
+    updateProjectionMatrix();
+}
+
+void PerspectiveCamera::updateProjectionMatrix()
+{
+    // K [R^T | -R^T c] with K = diag(f,f,1)
+    const QVector3D c(origin);
+    for (int r = 0; r < 3; r++) {
+        const QVector3D axis(rotation.column(r));
+        const float     k = (r < 2) ? focalLength : 1.0f;
+        for (int j = 0; j < 3; j++) P(r,j) = k * axis[j];
+        P(r,3) = -k * QVector3D::dotProduct(axis, c);
+    }
+}
+
+void PerspectiveCamera::affineMap(const QMatrix4x4& M)
+{
+    QMatrix4x4 T = M; T.setColumn(3,E0);
+    origin       = M * origin;
+    rotation     = T * rotation;
+    for (int c = 0; c < 3; c++) rotation.setColumn(c, rotation.column(c).normalized());
+    updateProjectionMatrix();
+}
+
+QMatrix4x4 PerspectiveCamera::imagePlaneMatrix() const
+{
+    QMatrix4x4 M = rotation;
+    M.setColumn(3, QVector4D(center(), 1.0f));
+    return M;
+}
+
+bool PerspectiveCamera::inImage(const QVector3D& p) const
+{
+    return p[2] >= zNear && fabsf(p[0]) <= 0.5f * imageWidth && fabsf(p[1]) <= 0.5f * imageHeight;
+}
+
+void PerspectiveCamera::project(const QVector<QVector4D>& pts, QVector<QVector3D>& uvDepth, QVector<int>* index) const
+{
+    uvDepth.resize(pts.size());
+    if (index) index->resize(pts.size());
+    qsizetype n = projectPointsClipped(pts.constData(), pts.size(), P, zNear, uvDepth.data(), index ? index->data() : nullptr);
+    uvDepth.resize(n);
+    if (index) index->resize(n);
+}
+
+void PerspectiveCamera::projectSegments(const QVector<QVector4D>& a,
+                                        const QVector<QVector4D>& b,
+                                        QVector<QVector3D>&       uvA,
+                                        QVector<QVector3D>&       uvB) const
+{
+    // project all end points in one batch, only segments crossing the near plane need more work
+    const qsizetype  n = std::min(a.size(), b.size());
+    QVector<QVector3D> pa(n), pb(n);
+    QVector3D* const outA[1] = { pa.data() };
+    QVector3D* const outB[1] = { pb.data() };
+    projectPoints(a.constData(), n, &P, outA, 1);
+    projectPoints(b.constData(), n, &P, outB, 1);
+
+    uvA.clear();
+    uvB.clear();
+    for (qsizetype i = 0; i < n; i++) {
+        const bool ina = pa[i][2] >= zNear, inb = pb[i][2] >= zNear;
+        if (!ina && !inb) continue;
+        if (ina && inb) {
+            uvA.append(pa[i]);
+            uvB.append(pb[i]);
+            continue;
+        }
+
+        // replace the end point behind the near plane by the intersection with it
+        const float     t = (zNear - pa[i][2]) / (pb[i][2] - pa[i][2]);
+        const QVector4D x = a[i] + t * (b[i] - a[i]);
+        const QVector3D h = P * x;
+        const QVector3D px(h[0]/h[2], h[1]/h[2], h[2]);
+        uvA.append(ina ? pa[i] : px);
+        uvB.append(inb ? pb[i] : px);
+    }
+}
+
+void PerspectiveCamera::draw(const RenderCamera& renderer, const QColor& color, float lineWidth) const
+{
+    const QVector3D x(rotation.column(0)), y(rotation.column(1)), z(rotation.column(2));
+    const QVector3D w = 0.5f * imageWidth * x, h = 0.5f * imageHeight * y;
+    const QVector3D c = center(), p = c + focalLength * z;
+    const QVector3D corner[4] = { p-w-h, p+w-h, p+w+h, p-w+h };
+
+    renderer.renderPoint(c, color, 5.0f);
+    renderer.renderLine (c, c + 2.0f * focalLength * z, color, lineWidth);
+    for (int k = 0; k < 4; k++) {
+        renderer.renderLine(c, corner[k], color, lineWidth);
+        renderer.renderLine(corner[k], corner[(k+1)%4], color, lineWidth);
+    }
+    renderer.renderPlane(corner[0], corner[1], corner[2], corner[3], color, 0.1f);
+}
+
+void PerspectiveCamera::drawProjections(const RenderCamera& renderer, const std::vector<SceneObject*>& scene) const
+{
+    const QMatrix4x4   M = imagePlaneMatrix();
+    QVector<QVector4D> a, b;                        // edges of all hexahedra
+    QVector3D          bbMin, bbMax;
+
+    for (const SceneObject* obj: scene) {
+        switch (obj->getType()) {
+        case SceneObjectType::ST_POINT_CLOUD: {
+            QVector<QVector3D> uv;
+            project(*static_cast<const PointCloud*>(obj), uv);
+
+            // visible projections as points on the image plane
+            QVector<QVector4D> img;
+            img.reserve(uv.size());
+            for (const QVector3D& p: uv)
+                if (inImage(p)) img.append(QVector4D(p[0], p[1], focalLength, 1.0f));
+            transformPoints(img.data(), img.size(), M, bbMin, bbMax);
+            renderer.renderPCL(img, COLOR_POINT_CLOUD, 1.0f);
+            break;
+        }
+        case SceneObjectType::ST_HEXAHEDRON:
+        case SceneObjectType::ST_CUBE: {
+            const Hexahedron& hex = *static_cast<const Hexahedron*>(obj);
+            for (unsigned i = 0; i < 2*Hexahedron::edgeCount; i += 2) {
+                a.append(QVector4D(hex[Hexahedron::edgeList[i  ]], 1.0f));
+                b.append(QVector4D(hex[Hexahedron::edgeList[i+1]], 1.0f));
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // all edges in one batch
+    QVector<QVector3D> uvA, uvB;
+    projectSegments(a, b, uvA, uvB);
+    for (qsizetype i = 0; i < uvA.size(); i++)
+        renderer.renderLine(M * QVector4D(uvA[i][0], uvA[i][1], focalLength, 1.0f),
+                            M * QVector4D(uvB[i][0], uvB[i][1], focalLength, 1.0f),
+                            COLOR_SCENE);
+}
@@ -0,0 +1,67 @@
+//
+//  A class for perspective (pinhole) cameras
+//
+//  The camera owns its 3x4 projection matrix P = K [R^T | -R^T c], built from its pose
+//  (center c, rotation R with the columns image right, image up and viewing direction)
+//  and the intrinsics K = diag(f,f,1). Image coordinates are metric coordinates on the
+//  image plane at distance f, centered on the view axis. Everything closer than the near
+//  plane is clipped before the perspective divide.
+//
+#pragma once
+
+#include <QGenericMatrix>
+
+#include "SceneObject.h"
+#include "Axes.h"
+
+#include <vector>
+
+class PerspectiveCamera : public SceneObject
+{
+private:
+    QVector4D  origin;                          // center of projection, homogeneous
+    QMatrix4x4 rotation;                        // columns: image right, image up and view direction
+    float      focalLength;                     // distance of the image plane to the center
+    float      imageWidth, imageHeight;         // extent of the image plane
+    float      zNear;                           // near plane distance, must be > 0
+    QMatrix4x3 P;                               // projection matrix, updated with the pose
+
+    void updateProjectionMatrix();
+
+public:
+    PerspectiveCamera(const QVector4D&  _origin      = E0+3*E1,
+                      const QMatrix4x4& _rotation    = QMatrix4x4(0,0,-1,0, 0,1,0,0, 1,0,0,0, 0,0,0,1),
+                      float             _focalLength = 0.5f,
+                      float             _imageWidth  = 0.6f,
+                      float             _imageHeight = 0.4f,
+                      float             _zNear       = 0.05f);
+    virtual ~PerspectiveCamera() override {}
+
+    virtual void affineMap(const QMatrix4x4  & matrix) override;
+    // draws center, view axis, image plane and viewing frustum
+    virtual void draw     (const RenderCamera& renderer,
+                           const QColor      & color     = COLOR_CAMERA,
+                           float               lineWidth = 1.0f        ) const override;
+
+    const QMatrix4x3& projectionMatrix() const { return P; }
+    QMatrix4x4        imagePlaneMatrix() const;             // (u,v,focalLength,1) -> world point on the image plane
+    QVector3D         center          () const { return QVector3D(origin); }
+    bool              inImage         (const QVector3D& uvDepth) const;
+
+    // Projects the points in front of the near plane; uvDepth receives their (u,v,depth),
+    // index (optional) their indices in pts.
+    void project(const QVector<QVector4D>& pts,
+                 QVector<QVector3D>&       uvDepth,
+                 QVector<int>*             index = nullptr) const;
+
+    // Projects the segments (a[i],b[i]) clipped at the near plane. Segments completely behind it
+    // are dropped; uvA/uvB receive the (u,v,depth) of the remaining (clipped) end points.
+    void projectSegments(const QVector<QVector4D>& a,
+                         const QVector<QVector4D>& b,
+                         QVector<QVector3D>&       uvA,
+                         QVector<QVector3D>&       uvB) const;
+
+    // Projects the other scene objects (point clouds, hexahedra) and draws the projections on the image plane
+    void drawProjections(const RenderCamera&              renderer,
+                         const std::vector<SceneObject*>& scene) const;
+};
@@ -0,0 +1,158 @@
+//
+//  Multi-plane RANSAC segmentation of point clouds
+//
+#include "PlaneSegmentation.h"
+#include "Parallel.h"
+#include "PointKernels.h"
+
+#include <Eigen/Eigenvalues>
+
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+namespace {
+
+// plane through three points or a null vector, if they are (nearly) collinear
+QVector4D planeFrom(const QVector4D& a, const QVector4D& b, const QVector4D& c)
+{
+    QVector3D n = QVector3D::crossProduct(QVector3D(b - a), QVector3D(c - a));
+    float     l = n.length();
+    if (l < 1e-12f) return QVector4D();
+    n /= l;
+    return QVector4D(n, -QVector3D::dotProduct(n, QVector3D(a)));
+}
+
+// indices (into pts) of all points within threshold of plane
+QVector<int> collectInliers(const QVector<QVector4D>& pts, const QVector4D& plane, float threshold)
+{
+    const unsigned       chunks = parallelChunks(pts.size());
+    vector<QVector<int>> parts(chunks);
+
+    parallelFor(pts.size(), [&](unsigned c, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i)
+            if (fabsf(QVector4D::dotProduct(pts[i], plane)) <= threshold) parts[c].append(int(i));
+    });
+
+    QVector<int> result;
+    for (const auto& p: parts) result.append(p);
+    return result;
+}
+
+// least-squares plane (and centroid) of pts[idx]
+QVector4D fitPlane(const QVector<QVector4D>& pts, const QVector<int>& idx, QVector4D& centroid)
+{
+    const unsigned          chunks = parallelChunks(idx.size());
+    vector<Eigen::Vector3d> sum (chunks, Eigen::Vector3d::Zero());
+    vector<Eigen::Matrix3d> sum2(chunks, Eigen::Matrix3d::Zero());
+
+    parallelFor(idx.size(), [&](unsigned c, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i) {
+            const QVector4D& p = pts[idx[i]];
+            Eigen::Vector3d  v(p[0], p[1], p[2]);
+            sum [c] += v;
+            sum2[c].noalias() += v * v.transpose();
+        }
+    });
+
+    Eigen::Vector3d s  = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d s2 = Eigen::Matrix3d::Zero();
+    for (unsigned c = 0; c < chunks; ++c) { s += sum[c]; s2 += sum2[c]; }
+
+    const double    n    = double(idx.size());
+    Eigen::Vector3d mean = s / n;
+    Eigen::Matrix3d cov  = s2 / n - mean * mean.transpose();
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver;
+    solver.computeDirect(cov);
+    Eigen::Vector3d normal = solver.eigenvectors().col(0);
+
+    centroid = QVector4D(float(mean.x()), float(mean.y()), float(mean.z()), 1.0f);
+    return QVector4D(float(normal.x()), float(normal.y()), float(normal.z()), float(-normal.dot(mean)));
+}
+
+// RANSAC over pts: best plane hypothesis or a null vector, if all samples were degenerate
+QVector4D ransacPlane(const QVector<QVector4D>& pts, const PlaneRansacParams& params, mt19937& rng)
+{
+    const qsizetype n     = pts.size();
+    const int       batch = int(workerCount()) * 4;
+    uniform_int_distribution<qsizetype> pick(0, n - 1);
+
+    QVector4D best;
+    qsizetype bestCount = 0;
+    int       needed    = params.maxIterations;
+
+    vector<QVector4D> hypotheses(batch);
+    vector<qsizetype> counts    (batch);
+
+    for (int done = 0; done < needed; done += batch) {
+        // draw the samples sequentially (deterministic), score them in parallel
+        for (auto& h: hypotheses) h = planeFrom(pts[pick(rng)], pts[pick(rng)], pts[pick(rng)]);
+
+        parallelFor(batch, [&](unsigned, qsizetype b, qsizetype e) {
+            for (qsizetype h = b; h < e; ++h)
+                counts[h] = hypotheses[h].isNull() ? 0 : countPlaneInliers(pts.constData(), n, hypotheses[h], params.threshold);
+        }, 1);
+
+        for (int h = 0; h < batch; ++h)
+            if (counts[h] > bestCount) { bestCount = counts[h]; best = hypotheses[h]; }
+
+        // adaptive number of iterations: log(1-p) / log(1-w^3) with inlier ratio w
+        const double w = double(bestCount) / double(n);
+        const double q = 1.0 - w*w*w;
+        if (q <= 0.0) break;
+        if (q < 1.0)  needed = int(min<double>(params.maxIterations, ceil(log(1.0 - params.confidence) / log(q))));
+    }
+
+    return best;
+}
+
+} // namespace
+
+Plane* PlaneSegment::toPlane() const
+{
+    return new Plane(centroid, QVector4D(plane.toVector3D(), 0.0f));
+}
+
+vector<PlaneSegment> segmentPlanes(const PointCloud& cloud, const PlaneRansacParams& params)
+{
+    vector<PlaneSegment> segments;
+    mt19937              rng(4711);
+
+    // points not yet assigned to a plane, compact for the SIMD kernel, plus their cloud indices
+    QVector<QVector4D> rest(cloud);
+    QVector<int>       restIdx(cloud.size());
+    for (qsizetype i = 0; i < restIdx.size(); ++i) restIdx[i] = int(i);
+
+    while (int(segments.size()) < params.maxPlanes && rest.size() >= max(3, params.minInliers)) {
+        QVector4D plane = ransacPlane(rest, params, rng);
+        if (plane.isNull()) break;
+
+        // refine by a least-squares fit to the inliers and collect them again
+        QVector<int> in = collectInliers(rest, plane, params.threshold);
+        if (in.size() < params.minInliers) break;
+        PlaneSegment seg;
+        seg.plane = fitPlane(rest, in, seg.centroid);
+        in        = collectInliers(rest, seg.plane, params.threshold);
+        if (in.size() < params.minInliers) break;
+
+        seg.inliers.reserve(in.size());
+        for (int i: in) seg.inliers.append(restIdx[i]);
+
+        // remove the inliers from the remaining points
+        qsizetype m = 0, j = 0;
+        for (qsizetype i = 0; i < rest.size(); ++i) {
+            if (j < in.size() && in[j] == i) { ++j; continue; }
+            rest   [m] = rest   [i];
+            restIdx[m] = restIdx[i];
+            ++m;
+        }
+        rest   .resize(m);
+        restIdx.resize(m);
+
+        segments.push_back(std::move(seg));
+    }
+
+    return segments;
+}
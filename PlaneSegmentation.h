@@ -0,0 +1,35 @@
+//
+//  Multi-plane RANSAC segmentation of point clouds
+//
+//  Planes are extracted one after the other from the points not yet assigned
+//  to a plane. Each round scores batches of random hypotheses in parallel with
+//  the SIMD inlier kernel (see PointKernels.h) and stops as soon as the best
+//  hypothesis so far is found with the requested confidence. The winner is
+//  refined by a least-squares fit to its inliers.
+//
+#pragma once
+
+#include <vector>
+
+#include "PointCloud.h"
+#include "Plane.h"
+
+struct PlaneRansacParams {
+    float threshold     = 0.005f;   // max. point-to-plane distance of inliers
+    int   maxPlanes     = 5;        // max. number of extracted planes
+    int   minInliers    = 1000;     // planes with fewer inliers end the segmentation
+    float confidence    = 0.99f;    // probability to draw at least one all-inlier sample
+    int   maxIterations = 2000;     // max. hypotheses per plane
+};
+
+struct PlaneSegment {
+    QVector4D    plane;             // (a,b,c,d) with unit normal (a,b,c), i.e. a*x+b*y+c*z+d = 0
+    QVector4D    centroid;          // centroid of the inliers
+    QVector<int> inliers;           // indices of the inliers in the point cloud
+
+    Plane* toPlane() const;         // new scene object for the segment
+};
+
+// Extracts up to params.maxPlanes planes, ordered by extraction
+std::vector<PlaneSegment> segmentPlanes(const PointCloud&        cloud,
+                                        const PlaneRansacParams& params = PlaneRansacParams());
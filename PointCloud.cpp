@@ -7,93 +7,533 @@
 #include <sstream>
 #include <iostream>
 #include <math.h>
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_set>
+
+#include <QtEndian>
 
 #include "GLConvenience.h"
 #include "QtConvenience.h"
+#include "KdTree.h"
+#include "Parallel.h"
+#include "PointKernels.h"
+#include "Profiler.h"
 
 using namespace std;
 
+namespace {
+// ids of the clouds alive, and the counter for ids and revisions
+std::mutex                  registryMutex;
+std::unordered_set<quint64> registry;
+std::atomic<quint64>        counter = 0;
+}
+
+PointCloud::Identity::Identity(): value(++counter)
+{
+    lock_guard<std::mutex> lock(registryMutex);
+    registry.insert(value);
+}
+
+PointCloud::Identity::Identity(const Identity&): Identity()
+{}
+
+PointCloud::Identity::~Identity()
+{
+    lock_guard<std::mutex> lock(registryMutex);
+    registry.erase(value);
+}
+
+bool PointCloud::isAlive(quint64 id)
+{
+    lock_guard<std::mutex> lock(registryMutex);
+    return registry.count(id) > 0;
+}
+
+void PointCloud::touch(PointChannel c)
+{
+    revisions[int(c)] = ++counter;
+}
+
+PointCloud::Index::~Index()
+{
+    delete root;
+}
+
+const KdNode* PointCloud::getKdTree() const
+{
+    const quint64 r = getRevision(PointChannel::PC_POSITION);
+    if (kdIndex.revision != r) {
+        PROFILE_SCOPE("kd-tree build");
+        delete kdIndex.root;
+        kdIndex.root     = isEmpty() ? nullptr : buildKdTree(*this);
+        kdIndex.revision = r;
+    }
+    return kdIndex.root;
+}
+
+MemoryUsage PointCloud::indexMemory() const
+{
+    return kdTreeMemory(kdIndex.root);
+}
+
 PointCloud::PointCloud()
 {
     type      = SceneObjectType::ST_POINT_CLOUD;
     pointSize = 3.0f;
+    for (int c = 0; c < int(PointChannel::PC_COUNT); c++) touch(PointChannel(c));
 }
 
 PointCloud::~PointCloud()
 {}
 
-bool PointCloud::loadPLY(const QString& filePath)
+namespace {
+// scalar types of ply properties
+enum PLYType {PT_INT8, PT_UINT8, PT_INT16, PT_UINT16, PT_INT32, PT_UINT32, PT_FLOAT32, PT_FLOAT64};
+
+const int plyTypeSizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+bool plyType(const string& name, PLYType& type)
+{
+    static const pair<const char*, PLYType> names[] = {
+        {"char",  PT_INT8 }, {"int8",   PT_INT8  }, {"uchar", PT_UINT8  }, {"uint8",   PT_UINT8  },
+        {"short", PT_INT16}, {"int16",  PT_INT16 }, {"ushort",PT_UINT16 }, {"uint16",  PT_UINT16 },
+        {"int",   PT_INT32}, {"int32",  PT_INT32 }, {"uint",  PT_UINT32 }, {"uint32",  PT_UINT32 },
+        {"float", PT_FLOAT32}, {"float32", PT_FLOAT32}, {"double", PT_FLOAT64}, {"float64", PT_FLOAT64}};
+    for (const auto& n: names)
+        if (name == n.first) { type = n.second; return true; }
+    return false;
+}
+
+template <class T>
+double plyCast(const char* bytes)
+{
+    T v;
+    memcpy(&v, bytes, sizeof(T));
+    return double(v);
+}
+
+// value of a binary property, byte-swapped if the file's byte order is not the host's
+double plyValue(const char* p, PLYType type, bool swap)
 {
+    char bytes[8];
+    if (swap) reverse_copy(p, p + plyTypeSizes[type], bytes);
+    else      memcpy(bytes, p, size_t(plyTypeSizes[type]));
+    switch (type) {
+    case PT_INT8:    return plyCast<int8_t  >(bytes);
+    case PT_UINT8:   return plyCast<uint8_t >(bytes);
+    case PT_INT16:   return plyCast<int16_t >(bytes);
+    case PT_UINT16:  return plyCast<uint16_t>(bytes);
+    case PT_INT32:   return plyCast<int32_t >(bytes);
+    case PT_UINT32:  return plyCast<uint32_t>(bytes);
+    case PT_FLOAT32: return plyCast<float   >(bytes);
+    case PT_FLOAT64: return plyCast<double  >(bytes);
+    }
+    return 0.0;
+}
+
+// color component as byte: floats are in [0,1], 16 bit integers in [0,65535]
+uchar plyColor(double v, PLYType type)
+{
+    if (type == PT_FLOAT32 || type == PT_FLOAT64) v *= 255.0;
+    if (type == PT_UINT16  || type == PT_INT16)   v /= 257.0;
+    return uchar(std::clamp(std::lround(v), 0l, 255l));
+}
+
+struct PLYProperty {
+    string  name;
+    PLYType type;
+    int     offset;         // in a binary record
+};
+
+struct PLYElement {
+    string              name;
+    qsizetype           count = 0;
+    vector<PLYProperty> properties;
+    int                 size  = 0;      // bytes of a binary record
+    bool                list  = false;  // has list properties, i.e. records of varying size
+
+    // index of the first property with one of the names, -1 if there is none
+    int find(std::initializer_list<const char*> names) const
+    {
+        for (const char* n: names)
+            for (size_t i = 0; i < properties.size(); i++) if (properties[i].name == n) return int(i);
+        return -1;
+    }
+};
+}
+
+bool PointCloud::loadPLY(const QString& filePath, bool normalize)
+{
+    PROFILE_SCOPE("loadPLY");
+
     // open stream
     fstream is;
-    is.open(filePath.toStdString().c_str(), fstream::in);
+    is.open(filePath.toStdString().c_str(), fstream::in | fstream::binary);
+    if (!is.is_open()) throw runtime_error("cannot open " + filePath.toStdString());
 
     // ensure format with magic header
     string line;
     getline(is, line);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
     if (line != "ply") throw runtime_error("not a ply file");
 
-    // parse header looking only for 'element vertex' section size
-    unsigned pointsCount = 0;
-    while (is.good()) {
-        getline(is, line);
+    // parse header: format, elements with their properties, and the comments written by PLYWriter
+    string             format;
+    vector<PLYElement> elements;
+    CoordinateFrame    fileFrame;               // recorded by PLYWriter, if saved
+    bool               saved       = false;
+    qsizetype          chunkPoints = 0;
+    bool               ended       = false;
+    while (getline(is, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
         if (line == "end_header") {
+            ended = true;
             break;
-        } else {
-            stringstream ss(line);
-            string tag1, tag2, tag3;
-            ss >> tag1 >> tag2 >> tag3;
-            if (tag1 == "element" && tag2 == "vertex") {
-                pointsCount = unsigned(atoi(tag3.c_str()));
+        }
+        stringstream ss(line);
+        string tag1, tag2, tag3;
+        ss >> tag1;
+        if (tag1 == "format") {
+            ss >> format;
+        } else if (tag1 == "comment") {
+            ss >> tag2 >> tag3;
+            if (tag2 == "framework" && tag3 == "scale") {
+                ss >> fileFrame.scale;
+                saved = true;
+                if (!(fileFrame.scale > 0.0)) throw runtime_error("broken ply header");
+            }
+            if (tag2 == "framework" && tag3 == "origin") {
+                ss >> fileFrame.origin[0] >> fileFrame.origin[1] >> fileFrame.origin[2];
+                saved = true;
+            }
+            if (tag2 == "framework" && tag3 == "chunks") {
+                string codec;
+                ss >> chunkPoints >> codec;
+                if (codec != "zlib" || chunkPoints <= 0) throw runtime_error("unsupported ply compression");
             }
+        } else if (tag1 == "element") {
+            PLYElement e;
+            ss >> e.name >> e.count;
+            elements.push_back(e);
+        } else if (tag1 == "property") {
+            if (elements.empty()) throw runtime_error("broken ply header");
+            PLYElement& e = elements.back();
+            ss >> tag2 >> tag3;
+            PLYType type;
+            if (tag2 == "list") e.list = true;
+            else if (plyType(tag2, type)) {
+                e.properties.push_back({ tag3, type, e.size });
+                e.size += plyTypeSizes[type];
+            }
+            else throw runtime_error("unknown ply type " + tag2);
         }
     }
+    if (!ended) throw runtime_error("broken ply header");
+
+    // compressed files (PLYWriter) have the format of their records with the suffix "_zlib"
+    const string zlib       = "_zlib";
+    const bool   compressed = format.size() > zlib.size() && format.compare(format.size() - zlib.size(), zlib.size(), zlib) == 0;
+    if (compressed) format.resize(format.size() - zlib.size());
+    const bool ascii = format == "ascii";
+    const bool swap  = format == (Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? "binary_big_endian" : "binary_little_endian");
+    if (!ascii && !swap && format != (Q_BYTE_ORDER == Q_LITTLE_ENDIAN ? "binary_little_endian" : "binary_big_endian"))
+        throw runtime_error("unknown ply format " + format);
+    if (compressed != (chunkPoints > 0) || (ascii && compressed)) throw runtime_error("broken ply header");
+
+    // locate the 'element vertex' section, only ASCII files can be skipped up to it
+    size_t v = 0;
+    while (v < elements.size() && elements[v].name != "vertex") v++;
+    if (v == elements.size()) throw runtime_error("ply file without vertices");
+    if (!ascii && v > 0) throw runtime_error("binary ply files with elements before the vertices are not supported");
+    for (size_t e = 0; e < v; e++)
+        for (qsizetype i = 0; i < elements[e].count; i++) getline(is, line);
 
-    // read and parse 'element vertex' section
-    if (pointsCount > 0) {
-        this->resize(pointsCount);
-        float m = float(INT_MAX);
-        pointsBoundMin = QVector3D(m,m,m);
-        pointsBoundMax = -pointsBoundMin;
-
-        stringstream ss;
-        string line;
-        QVector4D *p = this->data();
-        for (size_t i = 0; is.good() && i < pointsCount; ++i) {
-            getline(is, line);
-            ss.str(line);
-            float x, y, z;
-            ss >> x >> y >> z;
-
-            *p++ = QVector4D(x, y, z, 1.0);
-
-            // updates for AABB
-            pointsBoundMax[0] = max(x, pointsBoundMax[0]);
-            pointsBoundMax[1] = max(y, pointsBoundMax[1]);
-            pointsBoundMax[2] = max(z, pointsBoundMax[2]);
-            pointsBoundMin[0] = min(x, pointsBoundMin[0]);
-            pointsBoundMin[1] = min(y, pointsBoundMin[1]);
-            pointsBoundMin[2] = min(z, pointsBoundMin[2]);
+    const PLYElement& vertex = elements[v];
+    const int x  = vertex.find({"x"}),  y  = vertex.find({"y"}),  z  = vertex.find({"z"});
+    const int nx = vertex.find({"nx"}), ny = vertex.find({"ny"}), nz = vertex.find({"nz"});
+    const int r  = vertex.find({"red",   "r", "diffuse_red"  });
+    const int g  = vertex.find({"green", "g", "diffuse_green"});
+    const int b  = vertex.find({"blue",  "b", "diffuse_blue" });
+    const int a  = vertex.find({"alpha", "a"});
+    const int in = vertex.find({"intensity", "scalar_intensity", "scalar_Intensity"});
+    const int lb = vertex.find({"label", "classification", "class", "scalar_label"});
+    if (x < 0 || y < 0 || z < 0) throw runtime_error("ply vertices without x, y, z");
+    if (vertex.list) throw runtime_error("ply vertices with list properties are not supported");
+    const bool hasNormals = nx >= 0 && ny >= 0 && nz >= 0;
+    const bool hasColors  = r  >= 0 && g  >= 0 && b  >= 0;
+    const qsizetype pointsCount = vertex.count;
+
+    frame = CoordinateFrame();
+    this->resize(pointsCount);
+    normals    .clear();
+    colors     .clear();
+    intensities.clear();
+    labels     .clear();
+    if (hasNormals) normals    .resize(pointsCount);
+    if (hasColors)  colors     .resize(pointsCount);
+    if (in >= 0)    intensities.resize(pointsCount);
+    if (lb >= 0)    labels     .resize(pointsCount);
+    for (int c = 0; c < int(PointChannel::PC_COUNT); c++) touch(PointChannel(c));
+    if (pointsCount == 0) return true;
+
+    // read and parse 'element vertex' section; the coordinates are parsed as doubles and stored
+    // relative to the first point, unless the file holds local coordinates with their frame already
+    QVector4D*  p     = this->data();
+    GlobalPoint shift = { 0.0, 0.0, 0.0 };
+    bool        first = !saved;
+
+    // stores point i with its channels, get(k) is the value of property k
+    const auto& props = vertex.properties;
+    const auto  store = [&, n = normals.data(), col = colors.data(), ins = intensities.data(), lab = labels.data()]
+                        (qsizetype i, const auto& get) {
+        p[i] = QVector4D(float(get(x) - shift[0]), float(get(y) - shift[1]), float(get(z) - shift[2]), 1.0f);
+        if (hasNormals) n[i] = QVector3D(float(get(nx)), float(get(ny)), float(get(nz)));
+        if (hasColors) {
+            const uchar rgba[4] = { plyColor(get(r), props[r].type), plyColor(get(g), props[g].type), plyColor(get(b), props[b].type),
+                                    a >= 0 ? plyColor(get(a), props[a].type) : uchar(255) };
+            memcpy(&col[i], rgba, 4);
+        }
+        if (in >= 0) ins[i] = float(get(in));
+        if (lb >= 0) lab[i] = int(get(lb));
+    };
+
+    if (ascii) {
+        // columns of the properties needed, in the order of the line
+        const int columns = 1 + std::max({ x, y, z, nx, ny, nz, r, g, b, a, in, lb });
+        vector<double> values(columns);
+        for (qsizetype i = 0; i < pointsCount; ++i) {
+            if (!getline(is, line)) throw runtime_error("broken ply file");
+            const char* c = line.c_str();
+            for (int k = 0; k < columns; k++) {
+                char* end;
+                values[k] = strtod(c, &end);
+                if (end == c) throw runtime_error("broken ply file");
+                c = end;
+            }
+            if (first) {
+                shift = { values[x], values[y], values[z] };
+                first = false;
+            }
+            store(i, [&values](int k) { return values[k]; });
         }
+    } else {
+        // records of [first,last) from consecutive memory
+        const int   size   = vertex.size;
+        const auto  value  = [&](const char* record, int k) { return plyValue(record + props[k].offset, props[k].type, swap); };
+        const auto  decode = [&](const char* records, qsizetype first, qsizetype last) {
+            for (qsizetype i = first; i < last; i++) {
+                const char* record = records + (i - first) * size;
+                store(i, [&](int k) { return value(record, k); });
+            }
+        };
+        const auto shiftTo = [&](const char* record) {
+            if (first) shift = { value(record, x), value(record, y), value(record, z) };
+            first = false;
+        };
 
-        // basic validation
-        if (p - this->data() < size()) throw runtime_error("broken ply file");
+        if (chunkPoints == 0) {
+            // plain binary: read in blocks, decoded in parallel
+            const qsizetype block = 1 << 18;
+            vector<char>    buffer(size_t(std::min(block, pointsCount) * size));
+            for (qsizetype b = 0; b < pointsCount; b += block) {
+                const qsizetype m = std::min(block, pointsCount - b);
+                if (!is.read(buffer.data(), m * size)) throw runtime_error("broken ply file");
+                shiftTo(buffer.data());
+                parallelFor(m, [&](unsigned, qsizetype begin, qsizetype end) {
+                    decode(buffer.data() + begin * size, b + begin, b + end);
+                });
+            }
+        } else {
+            // compressed: chunks are read in batches, decompressed and decoded in parallel
+            const qsizetype     chunks = (pointsCount + chunkPoints - 1) / chunkPoints;
+            const qsizetype     batch  = workerCount();
+            QVector<QByteArray> payloads(batch);
+            for (qsizetype b = 0; b < chunks; b += batch) {
+                const qsizetype m = std::min(batch, chunks - b);
+                for (qsizetype c = 0; c < m; c++) {
+                    quint32 bytes;
+                    if (!is.read(reinterpret_cast<char*>(&bytes), sizeof(bytes))) throw runtime_error("broken ply file");
+                    payloads[c].resize(qFromLittleEndian(bytes));
+                    if (!is.read(payloads[c].data(), payloads[c].size())) throw runtime_error("broken ply file");
+                }
+                atomic<bool> broken = false;
+                parallelFor(m, [&](unsigned, qsizetype begin, qsizetype end) {
+                    for (qsizetype c = begin; c < end; c++) {
+                        const qsizetype first = (b + c) * chunkPoints;
+                        const qsizetype last  = std::min(first + chunkPoints, pointsCount);
+                        payloads[c] = qUncompress(payloads[c]);
+                        if (payloads[c].size() != (last - first) * size) broken = true;
+                    }
+                }, 1);
+                if (broken) throw runtime_error("broken ply file");
+                shiftTo(payloads[0].constData());
+                parallelFor(m, [&](unsigned, qsizetype begin, qsizetype end) {
+                    for (qsizetype c = begin; c < end; c++) {
+                        const qsizetype first = (b + c) * chunkPoints;
+                        decode(payloads[c].constData(), first, std::min(first + chunkPoints, pointsCount));
+                    }
+                }, 1);
+            }
+        }
+    }
 
-        cout << "number of points: " + to_string(pointsCount) << endl;
+    updateBounds();
 
-        // rescale data
-        float a,s=0;
-        for (int i=0; i<3;i++) {
-            a = pointsBoundMax[i]-pointsBoundMin[i];
-            s+= a*a;
+    // files saved by the viewer hold local coordinates in its units already, the frame is recorded
+    if (saved) {
+        frame = fileFrame;
+        if (!normalize && frame.scale != 1.0) {
+            for (auto& q: *this) { q *= float(frame.scale); q[3] = 1.0; }
+            frame.scale = 1.0;
+            updateBounds();
         }
-        s = sqrt(s)/pointCloudScale;
-        for (auto& p: *this) { p /= s; p[3]=1.0; }
-      //  for (int i=0; i < size(); i++) { (*this)[i]/=s; (*this)[i][3] = 1.0; }
+        return true;
     }
+
+    // local coordinates around the AABB's center, rescale data
+    frame.origin = shift;
+    recenter();
+    if (normalize) rescale();
     return true;
 }
 
+void PointCloud::rescale()
+{
+    float a,s=0;
+    for (int i=0; i<3;i++) {
+        a = pointsBoundMax[i]-pointsBoundMin[i];
+        s+= a*a;
+    }
+    if (s <= 0.0f) return;
+    s = sqrt(s)/pointCloudScale;
+    frame.scale *= s;
+    for (auto& p: *this) { p /= s; p[3]=1.0; }
+  //  for (int i=0; i < size(); i++) { (*this)[i]/=s; (*this)[i][3] = 1.0; }
+
+    // keep the AABB in the same units as the points
+    pointsBoundMin /= s;
+    pointsBoundMax /= s;
+    touch(PointChannel::PC_POSITION);
+}
+
+void PointCloud::recenter()
+{
+    if (isEmpty()) return;
+    const QVector3D c = 0.5f * (pointsBoundMin + pointsBoundMax);
+    frame.origin = frame.toGlobal(c);
+    const QVector4D c4(c, 0.0f);
+    QVector4D*      p = this->data();
+    parallelFor(size(), [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i) p[i] -= c4;
+    });
+    pointsBoundMin -= c;
+    pointsBoundMax -= c;
+    touch(PointChannel::PC_POSITION);
+}
+
+void PointCloud::moveToFrame(const CoordinateFrame& f)
+{
+    // local -> global -> local of f, in double precision for each point; the normals are
+    // invariant under translation and uniform scaling
+    const CoordinateFrame from = frame;
+    QVector4D*            p    = this->data();
+    parallelFor(size(), [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i) p[i] = QVector4D(f.toLocal(from.toGlobal(p[i].toVector3D())), 1.0f);
+    });
+    frame = f;
+    updateBounds();
+}
+
+void PointCloud::updateBounds()
+{
+    computeBounds(this->constData(), size(), pointsBoundMin, pointsBoundMax);
+    touch(PointChannel::PC_POSITION);
+}
+
+bool PointCloud::hasChannel(PointChannel c) const
+{
+    switch (c) {
+    case PointChannel::PC_POSITION:  return true;
+    case PointChannel::PC_NORMAL:    return hasNormals();
+    case PointChannel::PC_COLOR:     return !colors     .isEmpty() && colors     .size() == size();
+    case PointChannel::PC_INTENSITY: return !intensities.isEmpty() && intensities.size() == size();
+    case PointChannel::PC_LABEL:     return !labels     .isEmpty() && labels     .size() == size();
+    default:                         return false;
+    }
+}
+
+namespace {
+template <class T>
+void gather(QVector<T>& out, const QVector<T>& in, const QVector<int>& indices, bool present)
+{
+    out.clear();
+    if (!present) return;
+    out.resize(indices.size());
+    T* o = out.data();
+    parallelFor(indices.size(), [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i) o[i] = in[indices[i]];
+    });
+}
+
+template <class T>
+void compactChannel(QVector<T>& v, const std::vector<char>& keep, qsizetype m)
+{
+    if (v.isEmpty()) return;
+    T* d = v.data();
+    qsizetype j = 0;
+    for (size_t i = 0; i < keep.size(); ++i) if (keep[i]) d[j++] = d[i];
+    v.resize(m);
+}
+}
+
+void PointCloud::assignSubset(const PointCloud& source, const QVector<int>& indices)
+{
+    gather(*this,      source,             indices, true);
+    gather(normals,    source.normals,     indices, source.hasNormals());
+    gather(colors,     source.colors,      indices, source.hasChannel(PointChannel::PC_COLOR));
+    gather(intensities,source.intensities, indices, source.hasChannel(PointChannel::PC_INTENSITY));
+    gather(labels,     source.labels,      indices, source.hasChannel(PointChannel::PC_LABEL));
+    frame = source.frame;
+    for (int c = 0; c < int(PointChannel::PC_COUNT); c++) touch(PointChannel(c));
+    updateBounds();
+}
+
+qsizetype PointCloud::compact(const std::vector<char>& keep)
+{
+    const qsizetype n = size();
+    const qsizetype m = std::count_if(keep.begin(), keep.end(), [](char k) { return k != 0; });
+    if (m == n) return 0;
+
+    compactChannel(static_cast<QVector<QVector4D>&>(*this), keep, m);
+    if (normals    .size() == n) compactChannel(normals,     keep, m); else normals    .clear();
+    if (colors     .size() == n) compactChannel(colors,      keep, m); else colors     .clear();
+    if (intensities.size() == n) compactChannel(intensities, keep, m); else intensities.clear();
+    if (labels     .size() == n) compactChannel(labels,      keep, m); else labels     .clear();
+    for (int c = 0; c < int(PointChannel::PC_COUNT); c++) touch(PointChannel(c));
+    updateBounds();
+    return n - m;
+}
+
+bool PointCloud::getBounds(QVector3D& bbMin, QVector3D& bbMax) const
+{
+    if (isEmpty()) return false;
+    bbMin = pointsBoundMin;
+    bbMax = pointsBoundMax;
+    return true;
+}
+
+MemoryUsage PointCloud::memoryUsage() const
+{
+    MemoryUsage usage = containerUsage(static_cast<const QVector<QVector4D>&>(*this));
+    usage += containerUsage(normals);
+    usage += containerUsage(colors);
+    usage += containerUsage(intensities);
+    usage += containerUsage(labels);
+    return usage;
+}
+
 void PointCloud::setPointSize(unsigned _pointSize)
 {
     pointSize = _pointSize;
@@ -101,10 +541,22 @@ void PointCloud::setPointSize(unsigned _pointSize)
 
 void PointCloud::affineMap(const QMatrix4x4& M)
 {
-    for (auto& p: *this) p=M.map(p);
+    // bulk kernel maps all points and recomputes the AABB in the same pass
+    transformPoints(this->data(), size(), M, pointsBoundMin, pointsBoundMax);
+    touch(PointChannel::PC_POSITION);
+
+    // normals are mapped by the inverse transpose
+    if (hasNormals()) {
+        QMatrix4x4 N = M.inverted().transposed();
+        N.setColumn(3, QVector4D(0,0,0,1));
+        N.setRow   (3, QVector4D(0,0,0,1));
+        transformPoints(normals.data(), normals.size(), N);
+        for (auto& n: normals) n.normalize();
+        touch(PointChannel::PC_NORMAL);
+    }
 }
 
 void PointCloud::draw(const RenderCamera& camera, const QColor& color, float ) const
 {
-    camera.renderPCL((*this),color,pointSize);
+    camera.renderPCL(*this, color, pointSize);
 }
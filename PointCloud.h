@@ -6,28 +6,149 @@
 #include "SceneObject.h"
 #include "RenderCamera.h"
 
+#include <array>
+#include <vector>
+
+using GlobalPoint = std::array<double, 3>;
+
+struct KdNode;
+
+// Double-precision placement of the float coordinates of a cloud: global = origin + scale * local.
+// Georeferenced scans (coordinates of 1e5..1e7 m) keep their precision, since only the small local
+// coordinates are stored as floats, and the hot paths run on them unchanged.
+struct CoordinateFrame {
+    GlobalPoint origin = {0.0, 0.0, 0.0};
+    double      scale  = 1.0;
+
+    GlobalPoint toGlobal(const QVector3D& local) const
+    {
+        return { origin[0] + scale * double(local.x()), origin[1] + scale * double(local.y()), origin[2] + scale * double(local.z()) };
+    }
+    QVector3D toLocal(const GlobalPoint& global) const
+    {
+        return QVector3D(float((global[0] - origin[0]) / scale), float((global[1] - origin[1]) / scale), float((global[2] - origin[2]) / scale));
+    }
+    bool isIdentity() const { return scale == 1.0 && origin == GlobalPoint{0.0, 0.0, 0.0}; }
+};
+
+// per-point data of a cloud, besides the positions every channel is optional
+enum class PointChannel {PC_POSITION,
+                         PC_NORMAL,             // unit normals, QVector3D
+                         PC_COLOR,              // RGBA8, packed r,g,b,a in memory order
+                         PC_INTENSITY,          // float, e.g. laser return strength
+                         PC_LABEL,              // int, e.g. plane or cluster id, -1 for none
+                         PC_COUNT};
+
 class PointCloud: public SceneObject, public QVector<QVector4D>
 {
 private:
     QVector3D    pointsBoundMin;
     QVector3D    pointsBoundMax;
 
+    QVector<QVector3D> normals;                 // per-point normals, empty if not estimated
+    QVector<quint32>   colors;                  // attribute channels, empty if not present
+    QVector<float>     intensities;
+    QVector<int>       labels;
+
+    // identity and change counters for caches of derived data, e.g. GPU buffers
+    struct Identity {
+        quint64 value;
+        Identity();
+        Identity(const Identity&);
+        ~Identity();
+        Identity& operator=(const Identity&) { return *this; }
+    };
+    Identity     id;
+    quint64      revisions[int(PointChannel::PC_COUNT)] = {};
+    void touch(PointChannel c);
+
+    // kd-tree over the points, built for one revision of the positions; copies build their own
+    struct Index {
+        KdNode* root     = nullptr;
+        quint64 revision = 0;
+        Index() = default;
+        Index(const Index&) {}
+        ~Index();
+        Index& operator=(const Index&) { return *this; }
+    };
+    mutable Index kdIndex;
+
     unsigned     pointSize       = 3;
     const float  pointCloudScale = 1.5f;
+    CoordinateFrame frame;                      // of the points in the file's coordinates
 
 public:
     PointCloud();
     virtual ~PointCloud();
 
-    bool loadPLY(const QString&);
+    // loads the vertices (and normals, if any) of an ASCII, binary or compressed ply file (see
+    // PLYWriter.h). The coordinates are read in double precision and stored relative to the
+    // center of their AABB, rescaled for the viewer unless normalize is false; the frame keeps
+    // origin and scale. Throws runtime_error.
+    bool loadPLY(const QString&, bool normalize = true);
+
+    // scales the points (and the AABB), such that the AABB's diagonal becomes pointCloudScale
+    void rescale();
+
+    // moves the local origin to the center of the AABB, the global coordinates are kept
+    void recenter();
+
+    // frame of the points, i.e. the double-precision transformation back to the file's coordinates
+    const CoordinateFrame& getFrame() const { return frame; }
+    void setFrame(const CoordinateFrame& f) { frame = f; }
+
+    // re-expresses the points in another frame (in double precision), e.g. the one of another
+    // cloud of the same survey, such that both share local coordinates
+    void moveToFrame(const CoordinateFrame& f);
+
+    // global coordinates of point i
+    GlobalPoint globalPoint(qsizetype i) const { return frame.toGlobal((*this)[i].toVector3D()); }
 
     virtual void affineMap(const QMatrix4x4&) override;
     virtual void draw     (const RenderCamera& camera,
                            const QColor      & color      = COLOR_POINT_CLOUD,
                            float               point_size = 3.0f) const override;
+    virtual bool getBounds(QVector3D& bbMin, QVector3D& bbMax) const override;
+    virtual MemoryUsage memoryUsage() const override;
     QVector3D getMin() const { return pointsBoundMin; }
     QVector3D getMax() const { return pointsBoundMax; }
 
+    // recomputes the AABB, e.g. after the points were filled or filtered; marks the positions
+    // as changed, i.e. must be called after modifying them through the QVector interface
+    void updateBounds();
+
+    // per-point normals, see NormalEstimation.h
+    const QVector<QVector3D>& getNormals() const { return normals; }
+    void setNormals(QVector<QVector3D> n) { normals = std::move(n); touch(PointChannel::PC_NORMAL); }
+    bool hasNormals() const { return !normals.isEmpty() && normals.size() == size(); }
+
+    // further attribute channels, each empty or with one value per point
+    const QVector<quint32>& getColors     () const { return colors;      }
+    const QVector<float>&   getIntensities() const { return intensities; }
+    const QVector<int>&     getLabels     () const { return labels;      }
+    void setColors     (QVector<quint32> c) { colors      = std::move(c); touch(PointChannel::PC_COLOR);     }
+    void setIntensities(QVector<float>   i) { intensities = std::move(i); touch(PointChannel::PC_INTENSITY); }
+    void setLabels     (QVector<int>     l) { labels      = std::move(l); touch(PointChannel::PC_LABEL);     }
+    bool hasChannel(PointChannel c) const;
+
+    // the points source[indices[i]] with all their channels, in the order of indices
+    void assignSubset(const PointCloud& source, const QVector<int>& indices);
+
+    // removes the points with keep[i]==0 and their channels (stable) and updates the bounds
+    qsizetype compact(const std::vector<char>& keep);
+
+    // kd-tree of the points, owned by the cloud: built on first use and again after the positions
+    // changed (see getRevision), so it never is stale. Building is not thread-safe, call it once
+    // before querying from several threads. indexMemory reports the tree, if any.
+    const KdNode* getKdTree() const;
+    MemoryUsage   indexMemory() const;
+
+    // unique id of this cloud (copies get their own) and revision of a channel, which changes
+    // with each modification, e.g. for caches of GPU buffers
+    quint64 getId() const { return id.value; }
+    quint64 getRevision(PointChannel c) const { return revisions[int(c)]; }
+    static bool isAlive(quint64 id);            // false once the cloud with this id is destroyed
+
     // setup point size
     void     setPointSize(unsigned s);
     unsigned getPointSize(          ) const { return pointSize; }
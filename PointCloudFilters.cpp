@@ -0,0 +1,239 @@
+//
+//  Filters that thin out or clean up point clouds
+//
+#include "PointCloudFilters.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// A voxel grid stored as point indices sorted by cell key. The points of cell c are
+// entries[cellStart[c] .. cellStart[c+1]), cellKeys[c] is the key of cell c.
+struct VoxelGrid {
+    QVector3D                     origin;
+    float                         size = 1.0f;
+    vector<pair<quint64,int>>     entries;      // (cell key, point index)
+    vector<quint64>               cellKeys;
+    vector<qsizetype>             cellStart;
+
+    static constexpr int     bits = 21;
+    static constexpr quint64 mask = (quint64(1) << bits) - 1;
+
+    static quint64 key(quint64 x, quint64 y, quint64 z) { return x | (y << bits) | (z << 2*bits); }
+
+    // cell coordinates, with a margin of two cells for neighbour lookups
+    void cellOf(const QVector4D& p, int c[3]) const {
+        for (int k = 0; k < 3; ++k) c[k] = int(floorf((p[k] - origin[k]) / size)) + 2;
+    }
+
+    // index of the cell with key k or -1, if the cell is empty
+    qsizetype find(quint64 k) const {
+        auto it = lower_bound(cellKeys.begin(), cellKeys.end(), k);
+        return (it != cellKeys.end() && *it == k) ? qsizetype(it - cellKeys.begin()) : -1;
+    }
+
+    qsizetype cellCount() const { return qsizetype(cellKeys.size()); }
+};
+
+VoxelGrid buildVoxelGrid(const PointCloud& cloud, float size)
+{
+    if (!(size > 0.0f)) throw runtime_error("voxel size must be positive");
+
+    VoxelGrid grid;
+    grid.origin = cloud.getMin();
+    grid.size   = size;
+
+    QVector3D extent = cloud.getMax() - cloud.getMin();
+    for (int k = 0; k < 3; ++k)
+        if (extent[k] / size + 5.0f >= float(VoxelGrid::mask))
+            throw runtime_error("voxel size too small for the point cloud's extent");
+
+    // cell keys of all points
+    const qsizetype n = cloud.size();
+    grid.entries.resize(n);
+    parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+        int c[3];
+        for (qsizetype i = b; i < e; ++i) {
+            grid.cellOf(cloud[i], c);
+            grid.entries[i] = { VoxelGrid::key(c[0], c[1], c[2]), int(i) };
+        }
+    });
+
+    // sorting groups each cell's points, sorted by index within the cell
+    parallelSort(grid.entries.begin(), grid.entries.end(),
+                 [](const pair<quint64,int>& a, const pair<quint64,int>& b) { return a < b; });
+
+    for (qsizetype i = 0; i < n; ++i)
+        if (i == 0 || grid.entries[i].first != grid.entries[i-1].first) {
+            grid.cellKeys .push_back(grid.entries[i].first);
+            grid.cellStart.push_back(i);
+        }
+    grid.cellStart.push_back(n);
+
+    return grid;
+}
+
+// result cloud with the same rendering settings and frame as the input
+PointCloud* makeResult(const PointCloud& cloud, qsizetype n)
+{
+    PointCloud* result = new PointCloud;
+    result->resize(n);
+    result->setPointSize(cloud.getPointSize());
+    result->setFrame(cloud.getFrame());
+    return result;
+}
+
+} // namespace
+
+PointCloud* voxelGridDownsample(const PointCloud& cloud, float leafSize, VoxelMode mode)
+{
+    if (cloud.isEmpty()) return makeResult(cloud, 0);
+
+    const VoxelGrid    grid = buildVoxelGrid(cloud, leafSize);
+    const bool         mean = mode == VoxelMode::VM_CENTROID;
+    QVector<int>       nearest(grid.cellCount());
+    QVector<QVector4D> centroids(mean ? grid.cellCount() : 0);
+
+    parallelFor(grid.cellCount(), [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype c = b; c < e; ++c) {
+            const qsizetype first = grid.cellStart[c], last = grid.cellStart[c+1];
+
+            // double sums, since a voxel may hold very many points
+            double s[3] = {0,0,0};
+            for (qsizetype j = first; j < last; ++j)
+                for (int k = 0; k < 3; ++k) s[k] += cloud[grid.entries[j].second][k];
+            const double     cnt = double(last - first);
+            const QVector4D  centroid(float(s[0]/cnt), float(s[1]/cnt), float(s[2]/cnt), 1.0f);
+
+            if (mean) centroids[c] = centroid;
+
+            float best = INFINITY;
+            for (qsizetype j = first; j < last; ++j) {
+                const int   idx = grid.entries[j].second;
+                const float d   = (cloud[idx] - centroid).toVector3D().lengthSquared();
+                if (d < best) { best = d; nearest[c] = idx; }
+            }
+        }
+    }, 1024);
+
+    // the nearest points with all channels, moved to the centroids
+    PointCloud* result = makeResult(cloud, 0);
+    result->assignSubset(cloud, nearest);
+    if (mean) {
+        std::copy(centroids.cbegin(), centroids.cend(), result->begin());
+        result->updateBounds();
+    }
+    return result;
+}
+
+PointCloud* poissonDiskDownsample(const PointCloud& cloud, float minDistance)
+{
+    if (cloud.isEmpty()) return makeResult(cloud, 0);
+
+    // with edge length r/sqrt(3) a cell holds at most one sample and
+    // conflicting samples are at most two cells apart
+    const float     r2   = minDistance * minDistance;
+    const VoxelGrid grid = buildVoxelGrid(cloud, minDistance / sqrtf(3.0f));
+    const qsizetype m    = grid.cellCount();
+
+    // cells whose coordinates agree modulo 3 are at least three cells apart and never conflict,
+    // so the 27 phases are processed one after the other and the cells of each phase in parallel
+    vector<vector<qsizetype>> phases(27);
+    for (qsizetype c = 0; c < m; ++c) {
+        const quint64 k = grid.cellKeys[c];
+        const int     x = int(k & VoxelGrid::mask), y = int((k >> VoxelGrid::bits) & VoxelGrid::mask), z = int(k >> 2*VoxelGrid::bits);
+        phases[(x%3) + 3*(y%3) + 9*(z%3)].push_back(c);
+    }
+
+    vector<int> sample(m, -1);   // accepted point per cell
+    for (const auto& phase: phases) {
+        parallelFor(qsizetype(phase.size()), [&](unsigned, qsizetype b, qsizetype e) {
+            for (qsizetype i = b; i < e; ++i) {
+                const qsizetype c = phase[i];
+                for (qsizetype j = grid.cellStart[c]; j < grid.cellStart[c+1] && sample[c] < 0; ++j) {
+                    const int        idx = grid.entries[j].second;
+                    const QVector4D& p   = cloud[idx];
+                    int cc[3];
+                    grid.cellOf(p, cc);
+
+                    bool free = true;
+                    for (int dz = -2; dz <= 2 && free; ++dz)
+                    for (int dy = -2; dy <= 2 && free; ++dy)
+                    for (int dx = -2; dx <= 2 && free; ++dx) {
+                        const qsizetype nc = grid.find(VoxelGrid::key(cc[0]+dx, cc[1]+dy, cc[2]+dz));
+                        if (nc < 0 || sample[nc] < 0) continue;
+                        free = (cloud[sample[nc]] - p).toVector3D().lengthSquared() >= r2;
+                    }
+                    if (free) sample[c] = idx;
+                }
+            }
+        }, 1024);
+    }
+
+    // collect the samples in cell order
+    QVector<int> kept;
+    kept.reserve(m);
+    for (int s: sample) if (s >= 0) kept.append(s);
+
+    PointCloud* result = makeResult(cloud, 0);
+    result->assignSubset(cloud, kept);
+    return result;
+}
+
+qsizetype removeStatisticalOutliers(PointCloud& cloud, const KdNode* kdRoot, int k, float stddevMul)
+{
+    const qsizetype n = cloud.size();
+    if (n == 0) return 0;
+
+    // mean distance of each point to its k nearest neighbours (the point itself excluded)
+    vector<float> meanDist(n);
+    const unsigned chunks = parallelChunks(n, 1024);
+    vector<double> sum(chunks, 0.0), sum2(chunks, 0.0);
+
+    parallelFor(n, [&](unsigned c, qsizetype b, qsizetype e) {
+        vector<pair<float,int>> nn;
+        for (qsizetype i = b; i < e; ++i) {
+            kNearestNeighbors(kdRoot, cloud[i], k + 1, nn);
+            float d = 0.0f;
+            for (const auto& x: nn) d += sqrtf(x.first);
+            d /= float(max<size_t>(nn.size() - 1, 1));
+            meanDist[i] = d;
+            sum [c] += d;
+            sum2[c] += double(d) * d;
+        }
+    }, 1024);
+
+    double s = 0.0, s2 = 0.0;
+    for (unsigned c = 0; c < chunks; ++c) { s += sum[c]; s2 += sum2[c]; }
+    const double mean   = s / double(n);
+    const double stddev = sqrt(max(0.0, s2 / double(n) - mean * mean));
+    const float  limit  = float(mean + stddevMul * stddev);
+
+    vector<char> keep(n);
+    parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i) keep[i] = meanDist[i] <= limit;
+    });
+
+    return cloud.compact(keep);
+}
+
+qsizetype removeRadiusOutliers(PointCloud& cloud, const KdNode* kdRoot, float radius, int minNeighbors)
+{
+    const qsizetype n = cloud.size();
+    if (n == 0) return 0;
+
+    // the point itself is always found, so minNeighbors+1 hits suffice
+    vector<char> keep(n);
+    parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i)
+            keep[i] = countInRadius(kdRoot, cloud[i], radius, minNeighbors + 1) > minNeighbors;
+    }, 1024);
+
+    return cloud.compact(keep);
+}
@@ -0,0 +1,44 @@
+//
+//  Filters that thin out or clean up point clouds
+//
+//  All filters run multithreaded. The downsampling filters return a new point cloud,
+//  the outlier filters work in place; either way the bounds are up-to-date afterwards,
+//  i.e. the result can directly be drawn and indexed. The points keep their channels
+//  (normals, colors, intensities, labels), see PointChannel.
+//
+#pragma once
+
+#include "PointCloud.h"
+#include "KdTree.h"
+
+// what represents the points of one voxel
+enum class VoxelMode { VM_CENTROID,                 // centroid of all points in the voxel
+                       VM_NEAREST_TO_CENTROID };    // input point closest to that centroid
+
+// Voxel-grid downsampling: one point per occupied voxel of edge length leafSize. The channels
+// of a voxel's point are those of the input point closest to the centroid, in both modes.
+PointCloud* voxelGridDownsample(const PointCloud& cloud,
+                                float             leafSize,
+                                VoxelMode         mode = VoxelMode::VM_CENTROID);
+
+// Poisson-disk (minimum-distance) subsampling: keeps a subset of the input points,
+// such that no two kept points are closer than minDistance.
+PointCloud* poissonDiskDownsample(const PointCloud& cloud,
+                                  float             minDistance);
+
+// Statistical outlier removal: removes all points whose mean distance to their k nearest
+// neighbours exceeds the global mean of these distances by more than stddevMul standard
+// deviations. Works in place and returns the number of removed points.
+// kdRoot has to be built over cloud and is stale afterwards.
+qsizetype removeStatisticalOutliers(PointCloud&   cloud,
+                                    const KdNode* kdRoot,
+                                    int           k         = 16,
+                                    float         stddevMul = 1.0f);
+
+// Radius outlier removal: removes all points with fewer than minNeighbors other points
+// within radius. Works in place and returns the number of removed points.
+// kdRoot has to be built over cloud and is stale afterwards.
+qsizetype removeRadiusOutliers(PointCloud&   cloud,
+                               const KdNode* kdRoot,
+                               float         radius,
+                               int           minNeighbors);
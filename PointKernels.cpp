@@ -0,0 +1,494 @@
+//
+//  Bulk kernels for large point sets
+//
+#include "PointKernels.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <bit>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+#if defined(POINTKERNELS_AVX2)
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+bool hasAVX2()
+{
+#if !defined(POINTKERNELS_AVX2)
+    return false;
+#elif defined(_MSC_VER) && !defined(__clang__)
+    static const bool has = [] {
+        int r[4];
+        __cpuid(r, 0);
+        if (r[0] < 7) return false;
+        // FMA, OSXSAVE and AVX, and the OS saves the ymm registers
+        const int bits = (1 << 12) | (1 << 27) | (1 << 28);
+        __cpuid(r, 1);
+        if ((r[2] & bits) != bits || (_xgetbv(0) & 6) != 6) return false;
+        __cpuidex(r, 7, 0);
+        return (r[1] & (1 << 5)) != 0;
+    }();
+    return has;
+#else
+    static const bool has = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    return has;
+#endif
+}
+
+bool isAffine(const QMatrix4x4& M)
+{
+    return M(3,0) == 0.0f && M(3,1) == 0.0f && M(3,2) == 0.0f && M(3,3) == 1.0f;
+}
+
+namespace {
+
+#if defined(POINTKERNELS_AVX2)
+// the vectorized part of transformChunk, returns the number of points done
+AVX2_TARGET qsizetype transformChunkAVX2(QVector4D* pts, qsizetype n, const float* m, bool affine, float* lo, float* hi)
+{
+    qsizetype i = 0;
+
+    // two points per 256 bit register: x0 y0 z0 w0 | x1 y1 z1 w1
+    const __m256 c0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m +  0));
+    const __m256 c1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m +  4));
+    const __m256 c2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m +  8));
+    const __m256 c3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m + 12));
+    __m256 vlo = _mm256_set1_ps( FLT_MAX);
+    __m256 vhi = _mm256_set1_ps(-FLT_MAX);
+    float* f = reinterpret_cast<float*>(pts);
+
+    for (; i + 2 <= n; i += 2) {
+        const __m256 p = _mm256_loadu_ps(f + 4*i);
+        __m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(p, 0x00));
+        r = _mm256_fmadd_ps(c1, _mm256_permute_ps(p, 0x55), r);
+        r = _mm256_fmadd_ps(c2, _mm256_permute_ps(p, 0xAA), r);
+        r = _mm256_fmadd_ps(c3, _mm256_permute_ps(p, 0xFF), r);
+        if (!affine) r = _mm256_div_ps(r, _mm256_permute_ps(r, 0xFF));
+        _mm256_storeu_ps(f + 4*i, r);
+        vlo = _mm256_min_ps(vlo, r);
+        vhi = _mm256_max_ps(vhi, r);
+    }
+
+    // fold both lanes into the scalar bounds
+    alignas(32) float l[8], h[8];
+    _mm256_store_ps(l, vlo);
+    _mm256_store_ps(h, vhi);
+    for (int k = 0; k < 3; ++k) {
+        lo[k] = std::min(lo[k], std::min(l[k], l[k+4]));
+        hi[k] = std::max(hi[k], std::max(h[k], h[k+4]));
+    }
+    return i;
+}
+#endif
+
+// one chunk of transformPoints, returns the chunk's AABB in lo/hi
+void transformChunk(QVector4D* pts, qsizetype n, const float* m, bool affine, float* lo, float* hi)
+{
+    qsizetype i = 0;
+
+#if defined(POINTKERNELS_AVX2)
+    if (hasAVX2()) i = transformChunkAVX2(pts, n, m, affine, lo, hi);
+#endif
+
+    for (; i < n; ++i) {
+        const QVector4D p = pts[i];
+        float r[4];
+        for (int k = 0; k < 4; ++k)
+            r[k] = m[k]*p[0] + m[4+k]*p[1] + m[8+k]*p[2] + m[12+k]*p[3];
+        if (!affine) { for (int k = 0; k < 3; ++k) r[k] /= r[3]; r[3] = 1.0f; }
+        pts[i] = QVector4D(r[0], r[1], r[2], r[3]);
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], r[k]);
+            hi[k] = std::max(hi[k], r[k]);
+        }
+    }
+}
+
+} // namespace
+
+void transformPoints(QVector4D* pts, qsizetype n, const QMatrix4x4& M, QVector3D& bbMin, QVector3D& bbMax)
+{
+    if (n <= 0) return;
+
+    const float* m      = M.constData();   // column-major
+    const bool   affine = isAffine(M);
+
+    // per-chunk bounds, merged after the parallel pass
+    const unsigned chunks = parallelChunks(n);
+    std::vector<QVector3D> lo(chunks, QVector3D( FLT_MAX, FLT_MAX, FLT_MAX));
+    std::vector<QVector3D> hi(chunks, QVector3D(-FLT_MAX,-FLT_MAX,-FLT_MAX));
+
+    parallelFor(n, [&](unsigned c, qsizetype b, qsizetype e) {
+        float l[3] = { lo[c][0], lo[c][1], lo[c][2] };
+        float h[3] = { hi[c][0], hi[c][1], hi[c][2] };
+        transformChunk(pts + b, e - b, m, affine, l, h);
+        lo[c] = QVector3D(l[0], l[1], l[2]);
+        hi[c] = QVector3D(h[0], h[1], h[2]);
+    });
+
+    bbMin = lo[0];
+    bbMax = hi[0];
+    for (unsigned c = 1; c < chunks; ++c)
+        for (int k = 0; k < 3; ++k) {
+            bbMin[k] = std::min(bbMin[k], lo[c][k]);
+            bbMax[k] = std::max(bbMax[k], hi[c][k]);
+        }
+}
+
+void transformPoints(QVector3D* pts, qsizetype n, const QMatrix4x4& M)
+{
+    const float* m      = M.constData();   // column-major
+    const bool   affine = isAffine(M);
+
+    parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype i = b; i < e; ++i) {
+            const QVector3D p = pts[i];
+            float r[3];
+            for (int k = 0; k < 3; ++k)
+                r[k] = m[k]*p[0] + m[4+k]*p[1] + m[8+k]*p[2] + m[12+k];
+            if (!affine) {
+                const float w = m[3]*p[0] + m[7]*p[1] + m[11]*p[2] + m[15];
+                for (float& x: r) x /= w;
+            }
+            pts[i] = QVector3D(r[0], r[1], r[2]);
+        }
+    });
+}
+
+void computeBounds(const QVector4D* pts, qsizetype n, QVector3D& bbMin, QVector3D& bbMax)
+{
+    if (n <= 0) return;
+
+    const unsigned chunks = parallelChunks(n);
+    std::vector<QVector3D> lo(chunks, QVector3D( FLT_MAX, FLT_MAX, FLT_MAX));
+    std::vector<QVector3D> hi(chunks, QVector3D(-FLT_MAX,-FLT_MAX,-FLT_MAX));
+
+    parallelFor(n, [&](unsigned c, qsizetype b, qsizetype e) {
+        float l[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float h[3] = {-FLT_MAX,-FLT_MAX,-FLT_MAX };
+        for (qsizetype i = b; i < e; ++i)
+            for (int k = 0; k < 3; ++k) {
+                l[k] = std::min(l[k], pts[i][k]);
+                h[k] = std::max(h[k], pts[i][k]);
+            }
+        lo[c] = QVector3D(l[0], l[1], l[2]);
+        hi[c] = QVector3D(h[0], h[1], h[2]);
+    });
+
+    bbMin = lo[0];
+    bbMax = hi[0];
+    for (unsigned c = 1; c < chunks; ++c)
+        for (int k = 0; k < 3; ++k) {
+            bbMin[k] = std::min(bbMin[k], lo[c][k]);
+            bbMax[k] = std::max(bbMax[k], hi[c][k]);
+        }
+}
+
+#if defined(POINTKERNELS_AVX2)
+namespace {
+
+// the vectorized part of countPlaneInliers, adds to count and returns the number of points done
+AVX2_TARGET qsizetype countPlaneInliersAVX2(const QVector4D* pts, qsizetype n, const QVector4D& plane, float threshold,
+                                            qsizetype& count)
+{
+    qsizetype i = 0;
+
+    // eight points per iteration, the two horizontal adds leave the eight plane distances
+    // in the order i, i+2, i+4, i+6 | i+1, i+3, i+5, i+7, which does not matter for counting
+    const __m256 pl   = _mm256_setr_ps(plane[0], plane[1], plane[2], plane[3],
+                                       plane[0], plane[1], plane[2], plane[3]);
+    const __m256 thr  = _mm256_set1_ps(threshold);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const float* f    = reinterpret_cast<const float*>(pts);
+
+    for (; i + 8 <= n; i += 8) {
+        const __m256 m0 = _mm256_mul_ps(_mm256_loadu_ps(f + 4*i     ), pl);
+        const __m256 m1 = _mm256_mul_ps(_mm256_loadu_ps(f + 4*i +  8), pl);
+        const __m256 m2 = _mm256_mul_ps(_mm256_loadu_ps(f + 4*i + 16), pl);
+        const __m256 m3 = _mm256_mul_ps(_mm256_loadu_ps(f + 4*i + 24), pl);
+        const __m256 d  = _mm256_hadd_ps(_mm256_hadd_ps(m0, m1), _mm256_hadd_ps(m2, m3));
+        const __m256 in = _mm256_cmp_ps(_mm256_andnot_ps(sign, d), thr, _CMP_LE_OQ);
+        count += std::popcount(unsigned(_mm256_movemask_ps(in)));
+    }
+    return i;
+}
+
+} // namespace
+#endif
+
+qsizetype countPlaneInliers(const QVector4D* pts, qsizetype n, const QVector4D& plane, float threshold)
+{
+    qsizetype count = 0, i = 0;
+
+#if defined(POINTKERNELS_AVX2)
+    if (hasAVX2()) i = countPlaneInliersAVX2(pts, n, plane, threshold, count);
+#endif
+
+    for (; i < n; ++i)
+        if (std::fabs(QVector4D::dotProduct(pts[i], plane)) <= threshold) ++count;
+
+    return count;
+}
+
+namespace {
+
+#if defined(POINTKERNELS_AVX2)
+// the vectorized part of projectChunk, returns the number of points done
+AVX2_TARGET qsizetype projectChunkAVX2(const QVector4D* pts, qsizetype n, const float* P, QVector3D* out)
+{
+    qsizetype i = 0;
+
+    // two points per register as in transformChunk, the columns of P padded by a zero
+    const __m256 c0 = _mm256_setr_ps(P[0], P[ 1], P[ 2], 0, P[0], P[ 1], P[ 2], 0);
+    const __m256 c1 = _mm256_setr_ps(P[3], P[ 4], P[ 5], 0, P[3], P[ 4], P[ 5], 0);
+    const __m256 c2 = _mm256_setr_ps(P[6], P[ 7], P[ 8], 0, P[6], P[ 7], P[ 8], 0);
+    const __m256 c3 = _mm256_setr_ps(P[9], P[10], P[11], 0, P[9], P[10], P[11], 0);
+    const float* f  = reinterpret_cast<const float*>(pts);
+    alignas(32) float r[8];
+
+    for (; i + 2 <= n; i += 2) {
+        const __m256 p = _mm256_loadu_ps(f + 4*i);
+        __m256 h = _mm256_mul_ps(c0, _mm256_permute_ps(p, 0x00));
+        h = _mm256_fmadd_ps(c1, _mm256_permute_ps(p, 0x55), h);
+        h = _mm256_fmadd_ps(c2, _mm256_permute_ps(p, 0xAA), h);
+        h = _mm256_fmadd_ps(c3, _mm256_permute_ps(p, 0xFF), h);
+        // (x/w, y/w, w, -) per point
+        const __m256 uv = _mm256_div_ps(h, _mm256_permute_ps(h, 0xAA));
+        _mm256_store_ps(r, _mm256_blend_ps(uv, h, 0x44));
+        out[i  ] = QVector3D(r[0], r[1], r[2]);
+        out[i+1] = QVector3D(r[4], r[5], r[6]);
+    }
+    return i;
+}
+#endif
+
+void projectChunk(const QVector4D* pts, qsizetype n, const float* P, QVector3D* out)
+{
+    qsizetype i = 0;
+
+#if defined(POINTKERNELS_AVX2)
+    if (hasAVX2()) i = projectChunkAVX2(pts, n, P, out);
+#endif
+
+    for (; i < n; ++i) {
+        const QVector4D& p = pts[i];
+        float h[3];
+        for (int k = 0; k < 3; ++k) h[k] = P[k]*p[0] + P[3+k]*p[1] + P[6+k]*p[2] + P[9+k]*p[3];
+        out[i] = QVector3D(h[0]/h[2], h[1]/h[2], h[2]);
+    }
+}
+
+#if defined(POINTKERNELS_AVX2)
+// eight QVector2D u0 v0 .. u7 v7 -> u0..u7, v0..v7
+AVX2_TARGET inline void loadUV8(const float* f, __m256& u, __m256& v)
+{
+    const __m256 lo = _mm256_loadu_ps(f), hi = _mm256_loadu_ps(f + 8);
+    u = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(lo, hi, 0x88)), 0xD8));
+    v = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(_mm256_shuffle_ps(lo, hi, 0xDD)), 0xD8));
+}
+
+// p . q for 3-vectors in SoA layout
+AVX2_TARGET inline __m256 dot3(const __m256* p, const __m256* q)
+{
+    return _mm256_fmadd_ps(p[0], q[0], _mm256_fmadd_ps(p[1], q[1], _mm256_mul_ps(p[2], q[2])));
+}
+#endif
+
+// scalar midpoint of the rays ca + s*da and cb + t*db
+QVector4D midpoint(const QVector3D& ca, const QVector3D& da, const QVector3D& cb, const QVector3D& db)
+{
+    const QVector3D w0 = ca - cb;
+    const float a = QVector3D::dotProduct(da, da), b = QVector3D::dotProduct(da, db), c = QVector3D::dotProduct(db, db);
+    const float d = QVector3D::dotProduct(da, w0), e = QVector3D::dotProduct(db, w0);
+    const float den = a*c - b*b;
+    if (!(den > 1e-10f * a * c)) return QVector4D(0, 0, 0, 0);
+    const float s = (b*e - c*d) / den, t = (a*e - b*d) / den;
+    return QVector4D(0.5f * (ca + s*da + cb + t*db), 1.0f);
+}
+
+#if defined(POINTKERNELS_AVX2)
+// the vectorized part of triangulateChunk, returns the number of correspondences done
+AVX2_TARGET qsizetype triangulateChunkAVX2(const QVector2D* A, const QVector2D* B, qsizetype n,
+                                           const QVector3D& ca, const QMatrix3x3& Ba, const QVector3D& cb,
+                                           const QMatrix3x3& Bb, QVector4D* out)
+{
+    qsizetype i = 0;
+
+    // eight correspondences per iteration in SoA layout
+    const __m256 half = _mm256_set1_ps(0.5f), eps = _mm256_set1_ps(1e-10f);
+    __m256 ma[9], mb[9], pa[3], pb[3], w0[3];
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            ma[3*r+c] = _mm256_set1_ps(Ba(r,c));
+            mb[3*r+c] = _mm256_set1_ps(Bb(r,c));
+        }
+        pa[r] = _mm256_set1_ps(ca[r]);
+        pb[r] = _mm256_set1_ps(cb[r]);
+        w0[r] = _mm256_set1_ps(ca[r] - cb[r]);
+    }
+    const float* fa = reinterpret_cast<const float*>(A);
+    const float* fb = reinterpret_cast<const float*>(B);
+    alignas(32) float x[8], y[8], z[8], valid[8];
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 ua, va, ub, vb, da[3], db[3];
+        loadUV8(fa + 2*i, ua, va);
+        loadUV8(fb + 2*i, ub, vb);
+        for (int r = 0; r < 3; ++r) {
+            da[r] = _mm256_fmadd_ps(ma[3*r], ua, _mm256_fmadd_ps(ma[3*r+1], va, ma[3*r+2]));
+            db[r] = _mm256_fmadd_ps(mb[3*r], ub, _mm256_fmadd_ps(mb[3*r+1], vb, mb[3*r+2]));
+        }
+        const __m256 a = dot3(da, da), b = dot3(da, db), c = dot3(db, db), d = dot3(da, w0), e = dot3(db, w0);
+        const __m256 den = _mm256_fmsub_ps(a, c, _mm256_mul_ps(b, b));
+        const __m256 ok  = _mm256_cmp_ps(den, _mm256_mul_ps(eps, _mm256_mul_ps(a, c)), _CMP_GT_OQ);
+        const __m256 s   = _mm256_div_ps(_mm256_fmsub_ps(b, e, _mm256_mul_ps(c, d)), den);
+        const __m256 t   = _mm256_div_ps(_mm256_fmsub_ps(a, e, _mm256_mul_ps(b, d)), den);
+        __m256 X[3];
+        for (int r = 0; r < 3; ++r)
+            X[r] = _mm256_and_ps(ok, _mm256_mul_ps(half, _mm256_add_ps(_mm256_fmadd_ps(s, da[r], pa[r]),
+                                                                        _mm256_fmadd_ps(t, db[r], pb[r]))));
+        _mm256_store_ps(x, X[0]);
+        _mm256_store_ps(y, X[1]);
+        _mm256_store_ps(z, X[2]);
+        _mm256_store_ps(valid, _mm256_and_ps(ok, _mm256_set1_ps(1.0f)));
+        for (int k = 0; k < 8; ++k) out[i+k] = QVector4D(x[k], y[k], z[k], valid[k]);
+    }
+    return i;
+}
+#endif
+
+void triangulateChunk(const QVector2D* A, const QVector2D* B, qsizetype n,
+                      const QVector3D& ca, const QMatrix3x3& Ba, const QVector3D& cb, const QMatrix3x3& Bb, QVector4D* out)
+{
+    qsizetype i = 0;
+
+#if defined(POINTKERNELS_AVX2)
+    if (hasAVX2()) i = triangulateChunkAVX2(A, B, n, ca, Ba, cb, Bb, out);
+#endif
+
+    for (; i < n; ++i) {
+        const QVector3D da(Ba(0,0)*A[i][0] + Ba(0,1)*A[i][1] + Ba(0,2),
+                           Ba(1,0)*A[i][0] + Ba(1,1)*A[i][1] + Ba(1,2),
+                           Ba(2,0)*A[i][0] + Ba(2,1)*A[i][1] + Ba(2,2));
+        const QVector3D db(Bb(0,0)*B[i][0] + Bb(0,1)*B[i][1] + Bb(0,2),
+                           Bb(1,0)*B[i][0] + Bb(1,1)*B[i][1] + Bb(1,2),
+                           Bb(2,0)*B[i][0] + Bb(2,1)*B[i][1] + Bb(2,2));
+        out[i] = midpoint(ca, da, cb, db);
+    }
+}
+
+} // namespace
+
+void projectPoints(const QVector4D* pts, qsizetype n, const QMatrix4x3* P, QVector3D* const* out, int m)
+{
+    // chunks stay small enough for the points to remain in cache across the m cameras
+    parallelFor(n, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype s = b; s < e; s += 4096)
+            for (int k = 0; k < m; ++k)
+                projectChunk(pts + s, std::min<qsizetype>(4096, e - s), P[k].constData(), out[k] + s);
+    });
+}
+
+qsizetype projectPointsClipped(const QVector4D* pts, qsizetype n, const QMatrix4x3& P, float zNear,
+                               QVector3D* out, int* index)
+{
+    // 1) project and compact each chunk within its own range
+    const unsigned         chunks = parallelChunks(n);
+    std::vector<qsizetype> kept(chunks, 0);
+
+    parallelFor(n, [&](unsigned c, qsizetype b, qsizetype e) {
+        qsizetype w = b;
+        for (qsizetype s = b; s < e; s += 4096) {
+            const qsizetype m = std::min<qsizetype>(4096, e - s);
+            projectChunk(pts + s, m, P.constData(), out + s);
+            for (qsizetype i = s; i < s + m; ++i)
+                if (out[i][2] >= zNear) {
+                    if (index) index[w] = int(i);
+                    out[w++] = out[i];
+                }
+        }
+        kept[c] = w - b;
+    });
+
+    // 2) close the gaps between the chunks (moves to the left only)
+    qsizetype total = kept[0];
+    for (unsigned c = 1; c < chunks; ++c) {
+        const qsizetype b = n * c / chunks;
+        std::copy(out + b, out + b + kept[c], out + total);
+        if (index) std::copy(index + b, index + b + kept[c], index + total);
+        total += kept[c];
+    }
+    return total;
+}
+
+void triangulateMidpoint(const QVector2D* a, const QVector2D* b, qsizetype n,
+                         const QVector3D& ca, const QMatrix3x3& Ba, const QVector3D& cb, const QMatrix3x3& Bb,
+                         QVector4D* out)
+{
+    parallelFor(n, [&](unsigned, qsizetype s, qsizetype e) {
+        triangulateChunk(a + s, b + s, e - s, ca, Ba, cb, Bb, out + s);
+    });
+}
+
+#if defined(POINTKERNELS_AVX2)
+namespace {
+
+// the vectorized part of sampsonInliers, adds to count and returns the number of correspondences done
+AVX2_TARGET qsizetype sampsonInliersAVX2(const QVector2D* a, const QVector2D* b, qsizetype n, const QMatrix3x3& F,
+                                         float t2, float* errors, qsizetype& count)
+{
+    qsizetype i = 0;
+
+    __m256 f[9];
+    for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) f[3*r+c] = _mm256_set1_ps(F(r,c));
+    const __m256 vt   = _mm256_set1_ps(t2);
+    const float* fa   = reinterpret_cast<const float*>(a);
+    const float* fb   = reinterpret_cast<const float*>(b);
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 x, y, xp, yp;
+        loadUV8(fa + 2*i, x,  y);
+        loadUV8(fb + 2*i, xp, yp);
+        // F x and F^T x'
+        const __m256 l0 = _mm256_fmadd_ps(f[0], x, _mm256_fmadd_ps(f[1], y, f[2]));
+        const __m256 l1 = _mm256_fmadd_ps(f[3], x, _mm256_fmadd_ps(f[4], y, f[5]));
+        const __m256 l2 = _mm256_fmadd_ps(f[6], x, _mm256_fmadd_ps(f[7], y, f[8]));
+        const __m256 k0 = _mm256_fmadd_ps(f[0], xp, _mm256_fmadd_ps(f[3], yp, f[6]));
+        const __m256 k1 = _mm256_fmadd_ps(f[1], xp, _mm256_fmadd_ps(f[4], yp, f[7]));
+        const __m256 num = _mm256_fmadd_ps(xp, l0, _mm256_fmadd_ps(yp, l1, l2));
+        const __m256 den = _mm256_fmadd_ps(l0, l0, _mm256_fmadd_ps(l1, l1, _mm256_fmadd_ps(k0, k0, _mm256_mul_ps(k1, k1))));
+        const __m256 err = _mm256_div_ps(_mm256_mul_ps(num, num), den);
+        if (errors) _mm256_storeu_ps(errors + i, err);
+        count += std::popcount(unsigned(_mm256_movemask_ps(_mm256_cmp_ps(err, vt, _CMP_LE_OQ))));
+    }
+    return i;
+}
+
+} // namespace
+#endif
+
+qsizetype sampsonInliers(const QVector2D* a, const QVector2D* b, qsizetype n, const QMatrix3x3& F, float threshold, float* errors)
+{
+    const float t2    = threshold * threshold;
+    qsizetype   count = 0, i = 0;
+
+#if defined(POINTKERNELS_AVX2)
+    if (hasAVX2()) i = sampsonInliersAVX2(a, b, n, F, t2, errors, count);
+#endif
+
+    for (; i < n; ++i) {
+        const float x = a[i][0], y = a[i][1], xp = b[i][0], yp = b[i][1];
+        const float l0 = F(0,0)*x + F(0,1)*y + F(0,2), l1 = F(1,0)*x + F(1,1)*y + F(1,2), l2 = F(2,0)*x + F(2,1)*y + F(2,2);
+        const float k0 = F(0,0)*xp + F(1,0)*yp + F(2,0), k1 = F(0,1)*xp + F(1,1)*yp + F(2,1);
+        const float num = xp*l0 + yp*l1 + l2;
+        const float err = num*num / (l0*l0 + l1*l1 + k0*k0 + k1*k1);
+        if (errors) errors[i] = err;
+        if (err <= t2) ++count;
+    }
+    return count;
+}
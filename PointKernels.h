@@ -0,0 +1,101 @@
+//
+//  Bulk kernels for large point sets
+//
+//  These replace per-point Qt calls (QMatrix4x4::map etc.) in the hot loops.
+//  They are vectorized with AVX2/FMA if the CPU supports it (checked at runtime,
+//  the binaries run on any x86-64 CPU) and split the work over all cores (see Parallel.h).
+//
+#pragma once
+
+#include <QVector2D>
+#include <QVector3D>
+#include <QVector4D>
+#include <QMatrix4x4>
+#include <QGenericMatrix>
+
+// Functions using AVX2/FMA intrinsics are compiled for them by AVX2_TARGET, the rest of the
+// translation unit stays generic; callers take these paths only if hasAVX2().
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define POINTKERNELS_AVX2
+#if defined(_MSC_VER) && !defined(__clang__)
+#define AVX2_TARGET                 // MSVC emits the intrinsics without /arch:AVX2
+#else
+#define AVX2_TARGET __attribute__((target("avx2,fma")))
+#endif
+#endif
+
+// true, if the CPU and the OS support AVX2 and FMA
+bool hasAVX2();
+
+// true, if the last row of M is (0,0,0,1), i.e. M needs no perspective divide
+bool isAffine(const QMatrix4x4& M);
+
+// Maps n homogeneous points in place by M and returns the AABB of the mapped points.
+// Affine matrices keep w untouched, projective ones divide by the mapped w (afterwards w=1).
+// For n=0 the bounds are left unchanged.
+void transformPoints(QVector4D*        pts,
+                     qsizetype         n,
+                     const QMatrix4x4& M,
+                     QVector3D&        bbMin,
+                     QVector3D&        bbMax);
+
+// Maps n affine points in place by M (with perspective divide only for projective M).
+void transformPoints(QVector3D*        pts,
+                     qsizetype         n,
+                     const QMatrix4x4& M);
+
+// Computes the AABB of n homogeneous points (w is ignored). For n=0 the bounds are left unchanged.
+void computeBounds(const QVector4D* pts,
+                   qsizetype        n,
+                   QVector3D&       bbMin,
+                   QVector3D&       bbMax);
+
+// Counts the points with |a*x+b*y+c*z+d| <= threshold for plane = (a,b,c,d) with unit normal.
+// Points have to be affine, i.e. w=1.
+qsizetype countPlaneInliers(const QVector4D* pts,
+                            qsizetype        n,
+                            const QVector4D& plane,
+                            float            threshold);
+
+// Projects n homogeneous points by the m 3x4 matrices P[0..m), block-wise, such that the points are
+// read from memory only once for all cameras.
+// out[k][i] = (u,v,depth) with the image coordinates u,v and the depth (3rd row of P[k] times the
+// point) of point i in camera k. u and v are only meaningful for depth > 0.
+void projectPoints(const QVector4D*  pts,
+                   qsizetype         n,
+                   const QMatrix4x3* P,
+                   QVector3D* const* out,
+                   int               m);
+
+// Projects n homogeneous points by the 3x4 matrix P and keeps those in front of the near plane, i.e.
+// with depth >= zNear. out (room for n entries) receives the (u,v,depth) of the kept points in input
+// order, index (optional, room for n entries) their point indices. Returns the number of kept points.
+qsizetype projectPointsClipped(const QVector4D*  pts,
+                               qsizetype         n,
+                               const QMatrix4x3& P,
+                               float             zNear,
+                               QVector3D*        out,
+                               int*              index = nullptr);
+
+// Midpoint triangulation of n correspondences (a[i],b[i]) of two pinhole cameras. Camera k casts the
+// ray c_k + s*B_k*(u,v,1) through its image point (u,v); out[i] is the midpoint of the shortest segment
+// between both rays with w=1, or (0,0,0,0) if the rays are (nearly) parallel.
+void triangulateMidpoint(const QVector2D*  a,
+                         const QVector2D*  b,
+                         qsizetype         n,
+                         const QVector3D&  ca,
+                         const QMatrix3x3& Ba,
+                         const QVector3D&  cb,
+                         const QMatrix3x3& Bb,
+                         QVector4D*        out);
+
+// Sampson distance of n correspondences (a[i],b[i]) to the epipolar geometry b^T F a = 0, i.e. the
+// first-order approximation of the squared reprojection error. Counts the correspondences whose
+// distance is at most threshold and stores the squared distances in errors (optional, n entries).
+// Runs on the calling thread, as RANSAC scores many hypotheses in parallel.
+qsizetype sampsonInliers(const QVector2D*  a,
+                         const QVector2D*  b,
+                         qsizetype         n,
+                         const QMatrix3x3& F,
+                         float             threshold,
+                         float*            errors = nullptr);
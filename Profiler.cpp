@@ -0,0 +1,239 @@
+//
+//  Lightweight instrumentation of the hot paths
+//
+#include "Profiler.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+struct Event {
+    const ProfileSite* site;
+    qint64             start, end;
+};
+
+// Ring buffer of one thread. parallelFor starts new threads for every call, so buffers of
+// finished threads are recycled instead of growing a buffer per thread ever started.
+struct ThreadBuffer {
+    static constexpr quint64 CAPACITY = 1 << 15;
+
+    int                   id;                   // trace lane
+    std::atomic<quint64>  head {0};             // number of events written so far
+    std::unique_ptr<Event[]> events { new Event[CAPACITY] };
+
+    explicit ThreadBuffer(int _id): id(_id) {}
+};
+
+struct CounterSample {
+    qint64  time;
+    QString name;
+    qint64  value;
+};
+
+struct Registry {
+    std::mutex                                 mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*>                 idle;        // buffers of finished threads
+    std::vector<ProfileSite*>                  sites;
+    std::vector<ProfileCounter*>               counters;
+    std::deque<CounterSample>                  samples;     // counter values per frame, bounded
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+// hands the thread's buffer back when the thread ends
+struct BufferLease {
+    ThreadBuffer* buffer = nullptr;
+    ~BufferLease()
+    {
+        if (!buffer) return;
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.idle.push_back(buffer);
+    }
+};
+
+ThreadBuffer& threadBuffer()
+{
+    thread_local BufferLease lease;
+    if (!lease.buffer) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (!r.idle.empty()) {
+            lease.buffer = r.idle.back();
+            r.idle.pop_back();
+        } else {
+            r.buffers.push_back(std::make_unique<ThreadBuffer>(int(r.buffers.size())));
+            lease.buffer = r.buffers.back().get();
+        }
+    }
+    return *lease.buffer;
+}
+
+constexpr size_t MAX_SAMPLES = 1 << 16;
+}
+
+std::atomic<bool> Profiler::active {false};
+
+ProfileSite::ProfileSite(const char* _name): name(_name)
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.sites.push_back(this);
+}
+
+ProfileCounter::ProfileCounter(const char* _name): name(_name)
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.counters.push_back(this);
+}
+
+void Profiler::setEnabled(bool enable)
+{
+    active.store(enable, std::memory_order_relaxed);
+}
+
+qint64 Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+void Profiler::record(ProfileSite& site, qint64 start, qint64 end)
+{
+    ThreadBuffer& b = threadBuffer();
+    const quint64 h = b.head.load(std::memory_order_relaxed);
+    b.events[h % ThreadBuffer::CAPACITY] = { &site, start, end };
+    b.head.store(h + 1, std::memory_order_release);
+
+    site.lastNs .store    (end - start, std::memory_order_relaxed);
+    site.totalNs.fetch_add(end - start, std::memory_order_relaxed);
+    site.calls  .fetch_add(1,           std::memory_order_relaxed);
+}
+
+void Profiler::endFrame()
+{
+    if (!enabled()) return;
+
+    const qint64 t = now();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (ProfileCounter* c: r.counters) {
+        c->lastFrame = c->value.exchange(0, std::memory_order_relaxed);
+        r.samples.push_back({ t, c->name, c->lastFrame });
+    }
+    while (r.samples.size() > MAX_SAMPLES) r.samples.pop_front();
+}
+
+void Profiler::clear()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto& b: r.buffers) b->head.store(0, std::memory_order_relaxed);
+    for (ProfileSite* s: r.sites) {
+        s->lastNs  = 0;
+        s->totalNs = 0;
+        s->calls   = 0;
+    }
+    for (ProfileCounter* c: r.counters) {
+        c->value     = 0;
+        c->lastFrame = 0;
+    }
+    r.samples.clear();
+}
+
+std::vector<Profiler::SiteStats> Profiler::siteStats()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<SiteStats> stats;
+    for (const ProfileSite* s: r.sites) {
+        const qint64 calls = s->calls.load(std::memory_order_relaxed);
+        if (calls == 0) continue;
+        stats.push_back({ s->name,
+                          1e-6 * double(s->lastNs.load(std::memory_order_relaxed)),
+                          1e-6 * double(s->totalNs.load(std::memory_order_relaxed)) / double(calls),
+                          calls });
+    }
+    return stats;
+}
+
+std::vector<std::pair<QString, qint64>> Profiler::frameCounters()
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::vector<std::pair<QString, qint64>> result;
+    for (const ProfileCounter* c: r.counters) {
+        // counters of the same name at different call sites are merged
+        auto it = std::find_if(result.begin(), result.end(), [c](const auto& e) { return e.first == c->name; });
+        if (it == result.end()) result.emplace_back(c->name, c->lastFrame);
+        else                    it->second += c->lastFrame;
+    }
+    return result;
+}
+
+void Profiler::writeChromeTrace(const QString& filePath)
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+
+    QJsonArray events;
+    for (const auto& b: r.buffers) {
+        QJsonObject meta;
+        meta["name"] = "thread_name";
+        meta["ph"]   = "M";
+        meta["pid"]  = 1;
+        meta["tid"]  = b->id;
+        meta["args"] = QJsonObject{{ "name", QString("thread %1").arg(b->id) }};
+        events.append(meta);
+
+        // the last CAPACITY events, oldest first
+        const quint64 head  = b->head.load(std::memory_order_acquire);
+        const quint64 first = head > ThreadBuffer::CAPACITY ? head - ThreadBuffer::CAPACITY : 0;
+        for (quint64 i = first; i < head; i++) {
+            const Event& e = b->events[i % ThreadBuffer::CAPACITY];
+            QJsonObject o;
+            o["name"] = e.site->name;
+            o["cat"]  = "framework";
+            o["ph"]   = "X";
+            o["pid"]  = 1;
+            o["tid"]  = b->id;
+            o["ts"]   = 1e-3 * double(e.start);
+            o["dur"]  = 1e-3 * double(e.end - e.start);
+            events.append(o);
+        }
+    }
+    for (const CounterSample& s: r.samples) {
+        QJsonObject o;
+        o["name"] = s.name;
+        o["ph"]   = "C";
+        o["pid"]  = 1;
+        o["ts"]   = 1e-3 * double(s.time);
+        o["args"] = QJsonObject{{ "value", double(s.value) }};
+        events.append(o);
+    }
+
+    QJsonObject root;
+    root["traceEvents"]     = events;
+    root["displayTimeUnit"] = "ms";
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0)
+        throw runtime_error("cannot write " + filePath.toStdString());
+}
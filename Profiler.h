@@ -0,0 +1,103 @@
+//
+//  Lightweight instrumentation of the hot paths
+//
+//  PROFILE_SCOPE("name") times the enclosing scope, PROFILE_COUNT("name", n) adds n to a
+//  counter of the current frame. Completed scopes go to a ring buffer of the calling thread,
+//  so recording needs neither locks nor allocations, and update the running statistics of
+//  their call site, which the GLWidget shows as overlay. writeChromeTrace exports the buffers
+//  in the trace-event format of chrome://tracing and Perfetto.
+//
+//  While the profiler is disabled (the default), a scope costs one relaxed atomic load; with
+//  FRAMEWORK_NO_PROFILING defined, the macros compile to nothing.
+//
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+#include <vector>
+
+// statistics of one PROFILE_SCOPE call site
+struct ProfileSite {
+    const char*         name;
+    std::atomic<qint64> lastNs  {0};            // duration of the last completed scope
+    std::atomic<qint64> totalNs {0};
+    std::atomic<qint64> calls   {0};
+
+    explicit ProfileSite(const char* _name);    // registers the site
+};
+
+// counter of PROFILE_COUNT, summed over the current frame
+struct ProfileCounter {
+    const char*         name;
+    std::atomic<qint64> value {0};
+    qint64              lastFrame = 0;          // sum of the last completed frame
+
+    explicit ProfileCounter(const char* _name); // registers the counter
+};
+
+namespace Profiler {
+    extern std::atomic<bool> active;
+
+    inline bool enabled() { return active.load(std::memory_order_relaxed); }
+    void        setEnabled(bool enable);
+
+    // monotonic time in ns
+    qint64 now();
+
+    // appends a completed scope to the calling thread's ring buffer and updates the site
+    void record(ProfileSite& site, qint64 start, qint64 end);
+
+    // closes a frame: counters move to lastFrame (and into the trace), then restart at 0
+    void endFrame();
+
+    // forgets all events and statistics
+    void clear();
+
+    struct SiteStats {
+        QString name;
+        double  lastMs = 0.0, meanMs = 0.0;
+        qint64  calls  = 0;
+    };
+    std::vector<SiteStats>                  siteStats();        // sites that were hit, in registration order
+    std::vector<std::pair<QString, qint64>> frameCounters();    // lastFrame of all counters
+
+    // Writes the buffered events and counter samples as Chrome trace-event JSON. Should be
+    // called while no other thread is recording. Throws runtime_error if the file can't be written.
+    void writeChromeTrace(const QString& filePath);
+}
+
+// RAII timer behind PROFILE_SCOPE
+class ScopedTimer
+{
+private:
+    ProfileSite* site;
+    qint64       start;
+
+public:
+    explicit ScopedTimer(ProfileSite& s): site(Profiler::enabled() ? &s : nullptr), start(site ? Profiler::now() : 0) {}
+    ~ScopedTimer() { if (site) Profiler::record(*site, start, Profiler::now()); }
+
+    ScopedTimer(const ScopedTimer&)            = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+
+#if defined(FRAMEWORK_NO_PROFILING)
+#define PROFILE_SCOPE(name)
+#define PROFILE_COUNT(name, n)
+#else
+#define PROFILE_SCOPE(name)                                                             \
+    static ProfileSite PROFILE_CONCAT(profileSite_, __LINE__)(name);                    \
+    ScopedTimer        PROFILE_CONCAT(profileTimer_, __LINE__)(PROFILE_CONCAT(profileSite_, __LINE__))
+#define PROFILE_COUNT(name, n)                                                          \
+    do {                                                                                \
+        if (Profiler::enabled()) {                                                      \
+            static ProfileCounter profileCounter(name);                                 \
+            profileCounter.value.fetch_add(qint64(n), std::memory_order_relaxed);       \
+        }                                                                               \
+    } while (0)
+#endif
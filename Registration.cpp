@@ -0,0 +1,198 @@
+//
+//  ICP registration of point clouds
+//
+#include "Registration.h"
+#include "KdTree.h"
+#include "NormalEstimation.h"
+#include "Parallel.h"
+#include "PointCloudFilters.h"
+#include "PointKernels.h"
+
+#include <Eigen/Cholesky>
+#include <Eigen/Geometry>
+#include <Eigen/SVD>
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Matrix6d = Eigen::Matrix<double,6,6>;
+using Vector6d = Eigen::Matrix<double,6,1>;
+
+// one level of the pyramid: (downsampled) clouds and the target's kd-tree
+struct Level {
+    unique_ptr<PointCloud> ownSource, ownTarget;
+    const PointCloud*      source = nullptr;
+    const PointCloud*      target = nullptr;
+    unique_ptr<KdNode>     tree;
+    float                  maxDistance = 0.0f;
+};
+
+// per-chunk sums of one iteration
+struct Sums {
+    // point-to-point: sums of p, q and q*p^T
+    Eigen::Vector3d sp = Eigen::Vector3d::Zero(), sq = Eigen::Vector3d::Zero();
+    Eigen::Matrix3d sqp = Eigen::Matrix3d::Zero();
+    // point-to-plane: normal equations
+    Matrix6d        AtA = Matrix6d::Zero();
+    Vector6d        Atb = Vector6d::Zero();
+    double          err = 0.0;
+    qsizetype       n   = 0;
+};
+
+Eigen::Matrix4d toEigen(const QMatrix4x4& M)
+{
+    Eigen::Matrix4d E;
+    for (int r = 0; r < 4; ++r) for (int c = 0; c < 4; ++c) E(r,c) = M(r,c);
+    return E;
+}
+
+QMatrix4x4 toQt(const Eigen::Matrix4d& E)
+{
+    QMatrix4x4 M;
+    for (int r = 0; r < 4; ++r) for (int c = 0; c < 4; ++c) M(r,c) = float(E(r,c));
+    return M;
+}
+
+// closed-form rigid motion (Umeyama without scale) from the accumulated sums
+Eigen::Matrix4d solvePointToPoint(const Sums& s)
+{
+    const double    n  = double(s.n);
+    Eigen::Vector3d mp = s.sp / n, mq = s.sq / n;
+    Eigen::Matrix3d C  = s.sqp / n - mq * mp.transpose();
+
+    Eigen::JacobiSVD<Eigen::Matrix3d> svd(C, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Eigen::Vector3d d(1.0, 1.0, (svd.matrixU().determinant() * svd.matrixV().determinant() < 0.0) ? -1.0 : 1.0);
+
+    Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+    T.topLeftCorner<3,3>()  = svd.matrixU() * d.asDiagonal() * svd.matrixV().transpose();
+    T.topRightCorner<3,1>() = mq - T.topLeftCorner<3,3>() * mp;
+    return T;
+}
+
+// small-angle solution (alpha,beta,gamma,tx,ty,tz) of the linearized point-to-plane problem
+Eigen::Matrix4d solvePointToPlane(const Sums& s)
+{
+    Vector6d x = s.AtA.ldlt().solve(-s.Atb);
+
+    Eigen::Matrix4d T = Eigen::Matrix4d::Identity();
+    T.topLeftCorner<3,3>() = (Eigen::AngleAxisd(x[2], Eigen::Vector3d::UnitZ())
+                            * Eigen::AngleAxisd(x[1], Eigen::Vector3d::UnitY())
+                            * Eigen::AngleAxisd(x[0], Eigen::Vector3d::UnitX())).toRotationMatrix();
+    T.topRightCorner<3,1>() = x.tail<3>();
+    return T;
+}
+
+// one ICP iteration on a level: correspondences, sums and the incremental motion
+Eigen::Matrix4d iterate(const Level& level, const QMatrix4x4& T, IcpMetric metric, Sums& total)
+{
+    // current source positions, correspondences from the target's kd-tree on all cores
+    QVector<QVector4D> moved(*level.source);
+    QVector3D          bbMin, bbMax;
+    transformPoints(moved.data(), moved.size(), T, bbMin, bbMax);
+    const QVector<int> nn = kNearestNeighbors(level.tree.get(), moved, 1);
+
+    const float              d2      = level.maxDistance * level.maxDistance;
+    const PointCloud&        target  = *level.target;
+    const QVector3D*         normals = target.getNormals().constData();
+    const unsigned           chunks  = parallelChunks(moved.size(), 1024);
+    vector<Sums>             sums(chunks);
+
+    parallelFor(moved.size(), [&](unsigned c, qsizetype b, qsizetype e) {
+        Sums& s = sums[c];
+        for (qsizetype i = b; i < e; ++i) {
+            if (nn[i] < 0) continue;
+            const QVector3D p = moved[i].toVector3D(), q = target[nn[i]].toVector3D();
+            const float     dd = (p - q).lengthSquared();
+            if (dd > d2) continue;
+
+            const Eigen::Vector3d ep(p.x(), p.y(), p.z()), eq(q.x(), q.y(), q.z());
+            s.err += dd;
+            ++s.n;
+            if (metric == IcpMetric::IM_POINT_TO_POINT) {
+                s.sp += ep;
+                s.sq += eq;
+                s.sqp.noalias() += eq * ep.transpose();
+            } else {
+                const Eigen::Vector3d en(normals[nn[i]].x(), normals[nn[i]].y(), normals[nn[i]].z());
+                Vector6d a;
+                a << ep.cross(en), en;
+                const double r = (ep - eq).dot(en);
+                s.AtA.noalias() += a * a.transpose();
+                s.Atb           += a * r;
+            }
+        }
+    }, 1024);
+
+    total = Sums();
+    for (const Sums& s: sums) {
+        total.sp += s.sp; total.sq += s.sq; total.sqp += s.sqp;
+        total.AtA += s.AtA; total.Atb += s.Atb;
+        total.err += s.err; total.n += s.n;
+    }
+
+    if (total.n < 6) return Eigen::Matrix4d::Identity();
+    return metric == IcpMetric::IM_POINT_TO_POINT ? solvePointToPoint(total) : solvePointToPlane(total);
+}
+
+} // namespace
+
+IcpResult alignIcp(const PointCloud& source, const PointCloud& target, const IcpParams& params, const QMatrix4x4& initial)
+{
+    IcpResult result;
+    result.transform = initial;
+    if (source.isEmpty() || target.isEmpty()) return result;
+
+    Eigen::Matrix4d T = toEigen(initial);
+
+    for (int l = max(params.levels, 1) - 1; l >= 0; --l) {
+        // build the level: coarser levels double voxel size and correspondence distance
+        Level level;
+        level.maxDistance = params.maxDistance * float(1 << l);
+        if (l == 0) {
+            level.source = &source;
+            level.target = &target;
+        } else if (params.voxelSize > 0.0f) {
+            const float voxel = params.voxelSize * float(1 << (l - 1));
+            level.ownSource.reset(voxelGridDownsample(source, voxel));
+            level.ownTarget.reset(voxelGridDownsample(target, voxel));
+            level.source = level.ownSource.get();
+            level.target = level.ownTarget.get();
+        } else {
+            continue;
+        }
+        level.tree.reset(buildKdTree(*level.target));
+
+        if (params.metric == IcpMetric::IM_POINT_TO_PLANE && !level.target->hasNormals()) {
+            if (!level.ownTarget) {
+                level.ownTarget.reset(new PointCloud(target));
+                level.target = level.ownTarget.get();
+            }
+            estimateNormals(*level.ownTarget, level.tree.get());
+        }
+
+        Sums sums;
+        bool converged = false;
+        for (int it = 0; it < params.maxIterations && !converged; ++it) {
+            const Eigen::Matrix4d delta = iterate(level, toQt(T), params.metric, sums);
+            T = delta * T;
+            ++result.iterations;
+
+            const double angle = Eigen::AngleAxisd(Eigen::Matrix3d(delta.topLeftCorner<3,3>())).angle();
+            converged = sums.n < 6 || (delta.topRightCorner<3,1>().norm() < params.tolerance && angle < params.tolerance);
+        }
+
+        if (l == 0) {
+            result.converged       = converged && sums.n >= 6;
+            result.correspondences = sums.n;
+            result.rmse            = sums.n ? float(sqrt(sums.err / double(sums.n))) : 0.0f;
+        }
+    }
+
+    result.transform = toQt(T);
+    return result;
+}
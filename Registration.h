@@ -0,0 +1,39 @@
+//
+//  ICP registration of point clouds
+//
+//  Aligns a source cloud to a target cloud by iterative closest points, coarse to fine
+//  over a voxel-grid pyramid. Correspondences come from batched kd-tree queries on all
+//  cores; each iteration solves either the closed-form point-to-point problem (Umeyama)
+//  or the linearized point-to-plane least-squares problem.
+//
+#pragma once
+
+#include <QMatrix4x4>
+
+#include "PointCloud.h"
+
+enum class IcpMetric { IM_POINT_TO_POINT,       // minimizes |T*p - q|^2
+                       IM_POINT_TO_PLANE };     // minimizes ((T*p - q) . n_q)^2, converges faster on smooth surfaces
+
+struct IcpParams {
+    IcpMetric metric        = IcpMetric::IM_POINT_TO_PLANE;
+    int       levels        = 3;        // pyramid levels, the finest one always uses the full clouds
+    float     voxelSize     = 0.01f;    // voxel size of the first coarser level, doubles per level, 0 disables the pyramid
+    float     maxDistance   = 0.05f;    // max. correspondence distance on the finest level, doubles per level
+    int       maxIterations = 30;       // per level
+    float     tolerance     = 1e-5f;    // convergence: max. change of translation and rotation angle (rad)
+};
+
+struct IcpResult {
+    QMatrix4x4 transform;               // maps the source onto the target, apply with affineMap
+    float      rmse            = 0.0f;  // RMS correspondence distance on the finest level
+    qsizetype  correspondences = 0;     // on the finest level
+    int        iterations      = 0;     // over all levels
+    bool       converged       = false; // on the finest level
+};
+
+// Aligns source to target, starting from initial. Neither cloud is modified.
+IcpResult alignIcp(const PointCloud& source,
+                   const PointCloud& target,
+                   const IcpParams&  params  = IcpParams(),
+                   const QMatrix4x4& initial = QMatrix4x4());
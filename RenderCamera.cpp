@@ -4,8 +4,189 @@
 // (c) Georg Umlauf, 2021
 //
 #include "RenderCamera.h"
+#include "PointCloud.h"
 #include "GLConvenience.h"
 #include "QtConvenience.h"
+#include "Profiler.h"
+
+#include <QOpenGLBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QVector2D>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+// colors the points by mode (ColorMode); ramp and palette are the same as pointRamp and labelColor below.
+// Compiled twice, with SPLATS defined for the splat program (see pointSource).
+const char* pointVertexShader = R"(
+attribute vec4  position;
+attribute vec3  normal;
+attribute vec4  rgba;
+attribute float intensity;
+attribute float label;
+uniform   mat4  renderMatrix;
+uniform   int   mode;
+uniform   vec4  uniformColor;
+uniform   vec2  intensityRange;
+uniform   vec2  heightRange;
+uniform   float pointSize;
+varying   vec4  color;
+#ifdef SPLATS
+uniform   float sizeReference;                  // clip w at which splats have pointSize
+uniform   float pixelsPerUnit;                  // pixels per world unit at w = 1
+uniform   vec3  depthAxis;                      // world direction away from the eye
+varying   float depthOffset;                    // window depth from a splat's center to its front
+#endif
+vec3 ramp(float t)
+{
+    t = clamp(t, 0.0, 1.0);
+    return clamp(vec3(1.5) - abs(4.0*vec3(t) - vec3(3.0, 2.0, 1.0)), 0.0, 1.0);
+}
+vec3 palette(float l)
+{
+    if (l < 0.0) return vec3(0.6);
+    vec3 p = abs(fract(fract(l*0.618034) + vec3(1.0, 2.0/3.0, 1.0/3.0))*6.0 - 3.0);
+    return 0.9*mix(vec3(1.0), clamp(p - 1.0, 0.0, 1.0), 0.65);
+}
+void main()
+{
+    gl_Position  = renderMatrix * position;
+    gl_PointSize = pointSize;                   // the widget enables GL_VERTEX_PROGRAM_POINT_SIZE
+#ifdef SPLATS
+    // size by distance, and a sphere of the splat's radius in world units for its depth
+    float w      = max(gl_Position.w, 1e-6);
+    gl_PointSize = clamp(pointSize*sizeReference/w, 1.0, 64.0);
+    vec4  front  = renderMatrix * vec4(position.xyz - 0.5*gl_PointSize*w/pixelsPerUnit*depthAxis, 1.0);
+    depthOffset  = 0.5*(front.z/front.w - gl_Position.z/w);
+#endif
+    if      (mode == 2) color = vec4(0.5 + 0.5*normal, 1.0);
+    else if (mode == 3) color = rgba;
+    else if (mode == 4) color = vec4(ramp((intensity  - intensityRange.x)/max(intensityRange.y - intensityRange.x, 1e-20)), 1.0);
+    else if (mode == 5) color = vec4(ramp((position.z - heightRange.x   )/max(heightRange.y    - heightRange.x,    1e-20)), 1.0);
+    else if (mode == 6) color = vec4(palette(label), 1.0);
+    else                color = uniformColor;
+}
+)";
+
+// splats are discs (point sprites), their depth bulges towards the eye like a sphere; plain points
+// leave the depth to the fixed pipeline, so early depth tests stay on
+const char* pointFragmentShader = R"(
+varying vec4  color;
+#ifdef SPLATS
+varying float depthOffset;
+#endif
+void main()
+{
+#ifdef SPLATS
+    vec2  d  = 2.0*gl_PointCoord - vec2(1.0);
+    float r2 = dot(d, d);
+    if (r2 > 1.0) discard;
+    gl_FragDepth = gl_FragCoord.z + depthOffset*sqrt(1.0 - r2);
+#endif
+    gl_FragColor = color;
+}
+)";
+
+// the version has to come first, then the variant's defines
+QByteArray pointSource(const char* body, bool splats)
+{
+    return QByteArray("#version 120\n") + (splats ? "#define SPLATS\n" : "") + body;
+}
+
+// clip w of the world origin, at which splats have the given point size
+float splatReference(const QMatrix4x4& M)
+{
+    return fmaxf(M.map(QVector4D(0.0f, 0.0f, 0.0f, 1.0f)).w(), 1e-6f);
+}
+
+// pixels per world unit at w = 1 in a viewport of height pixels: row 1 maps world lengths to clip y
+float pixelsPerUnit(const QMatrix4x4& M, int height)
+{
+    return fmaxf(0.5f * float(height) * M.row(1).toVector3D().length(), 1e-20f);
+}
+
+QVector3D pointRamp(float t)
+{
+    t = std::clamp(t, 0.0f, 1.0f);
+    return QVector3D(std::clamp(1.5f - fabsf(4.0f*t - 3.0f), 0.0f, 1.0f),
+                     std::clamp(1.5f - fabsf(4.0f*t - 2.0f), 0.0f, 1.0f),
+                     std::clamp(1.5f - fabsf(4.0f*t - 1.0f), 0.0f, 1.0f));
+}
+
+QVector3D labelColor(int l)
+{
+    if (l < 0) return QVector3D(0.6f, 0.6f, 0.6f);
+    const float h = float(l)*0.618034f - floorf(float(l)*0.618034f);
+    QVector3D   c;
+    for (int k = 0; k < 3; k++) {
+        const float o = 1.0f - float(k)/3.0f;
+        const float p = fabsf((h + o - floorf(h + o))*6.0f - 3.0f);
+        c[k] = 0.9f*(0.35f + 0.65f*std::clamp(p - 1.0f, 0.0f, 1.0f));
+    }
+    return c;
+}
+
+// mode for cloud, CM_AUTO and modes of missing channels resolved
+ColorMode resolve(ColorMode mode, const PointCloud& cloud)
+{
+    switch (mode) {
+    case ColorMode::CM_UNIFORM:   return mode;
+    case ColorMode::CM_HEIGHT:    return mode;
+    case ColorMode::CM_NORMAL:    if (cloud.hasNormals())                               return mode; break;
+    case ColorMode::CM_RGB:       if (cloud.hasChannel(PointChannel::PC_COLOR))        return mode; break;
+    case ColorMode::CM_INTENSITY: if (cloud.hasChannel(PointChannel::PC_INTENSITY))    return mode; break;
+    case ColorMode::CM_LABEL:     if (cloud.hasChannel(PointChannel::PC_LABEL))        return mode; break;
+    default:                      break;
+    }
+    if (cloud.hasChannel(PointChannel::PC_COLOR)) return ColorMode::CM_RGB;
+    if (cloud.hasNormals())                       return ColorMode::CM_NORMAL;
+    return ColorMode::CM_UNIFORM;
+}
+
+// maps the unit cube resp. unit quad of each instance to its box; a quad lies in the plane of the box's zero extent
+const char* boxVertexShader = R"(
+#version 120
+attribute vec3 unit;
+attribute vec3 boxMin;
+attribute vec3 boxMax;
+attribute vec4 boxColor;
+uniform   mat4 renderMatrix;
+uniform   bool quads;
+varying   vec4 color;
+void main()
+{
+    vec3 e = boxMax - boxMin;
+    vec3 u = unit;
+    if (quads) u = (e.x == 0.0) ? vec3(0.0, unit.xy) : (e.y == 0.0) ? vec3(unit.x, 0.0, unit.y) : vec3(unit.xy, 0.0);
+    color       = boxColor;
+    gl_Position = renderMatrix * vec4(boxMin + e*u, 1.0);
+}
+)";
+
+const char* boxFragmentShader = R"(
+#version 120
+varying vec4 color;
+void main()
+{
+    gl_FragColor = color;
+}
+)";
+
+// 12 edges of the unit cube as line segments, followed by the unit quad as two triangles
+const float unitVertices[] = {
+    0,0,0, 1,0,0,  0,1,0, 1,1,0,  0,0,1, 1,0,1,  0,1,1, 1,1,1,     // edges along x
+    0,0,0, 0,1,0,  1,0,0, 1,1,0,  0,0,1, 0,1,1,  1,0,1, 1,1,1,     // edges along y
+    0,0,0, 0,0,1,  1,0,0, 1,0,1,  0,1,0, 0,1,1,  1,1,0, 1,1,1,     // edges along z
+    0,0,0, 1,0,0,  1,1,0,  0,0,0, 1,1,0, 0,1,0                     // quad
+};
+constexpr int EDGE_VERTICES = 24;
+constexpr int QUAD_VERTICES = 6;
+
+static_assert(sizeof(BoxInstance) == 10*sizeof(float), "BoxInstance is uploaded as is");
+}
 
 RenderCamera::RenderCamera(QObject* parent) :
     QObject(parent),
@@ -136,15 +317,29 @@ void RenderCamera::rotate(int dx, int dy, int dz)
     setZRotation(zRotation + dz);
 }
 
+void RenderCamera::lookAt(const QVector3D& eye, const QVector3D& center, const QVector3D& up)
+{
+    // the render matrix scales the world by RenderSCALE first, the look-at frame is in unscaled coordinates
+    QMatrix4x4 C;
+    C.lookAt(eye, center, up);
+    C.scale (1.0f / RenderSCALE);
+    setCameraMatrix(C);
+}
+
 QMatrix4x4 RenderCamera::getRenderMatrix() const
 {
     QMatrix4x4 mvMatrix = cameraMatrix * worldMatrix;
-    mvMatrix.scale(0.05f); // make it small
+    mvMatrix.scale(RenderSCALE); // make it small
     mvMatrix = projectionMatrix * mvMatrix;
 
     return mvMatrix;
 }
 
+QMatrix4x4 RenderCamera::getProjectionMatrix() const
+{
+    return projectionMatrix;
+}
+
 QMatrix4x4 RenderCamera::getViewMatrix() const
 {
     return projectionMatrix * cameraMatrix * worldMatrix;
@@ -209,6 +404,7 @@ void RenderCamera::renderPCL  (const QVector<QVector4D>& pcl,
                                const QColor& color,
                                float pointSize) const
 {
+    PROFILE_COUNT("points drawn", pcl.size());
     glPointSize(fmaxf(1.0f,pointSize));
     glBegin(GL_POINTS);
     glColor3f(color);
@@ -216,3 +412,282 @@ void RenderCamera::renderPCL  (const QVector<QVector4D>& pcl,
     glEnd();
 }
 
+struct RenderCamera::PointBuffers {
+    QOpenGLBuffer buffers  [int(PointChannel::PC_COUNT)];
+    quint64       revisions[int(PointChannel::PC_COUNT)] = {};     // uploaded, 0 for none
+    QVector2D     intensityRange;
+};
+
+//
+// The point shader needs desktop GL 2.0 (a compatibility context, as the rest is immediate mode).
+// Without it, or if it does not compile, renderPCL colors the points on the CPU in immediate mode.
+//
+bool RenderCamera::initPoints() const
+{
+    if (shading >= 0) return shading > 0;
+    shading = 0;
+
+    const QOpenGLContext* context = QOpenGLContext::currentContext();
+    if (!context) return false;
+    if (context->isOpenGLES() || context->format().version() < qMakePair(2,0)) return false;
+
+    // attribute 0 has to be enabled in compatibility contexts, the positions always are
+    for (bool splats: { false, true }) {
+        QOpenGLShaderProgram*& program = splats ? splatProgram : pointProgram;
+        program = new QOpenGLShaderProgram();
+        program->bindAttributeLocation("position", 0);
+        if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex,   pointSource(pointVertexShader,   splats)) ||
+            !program->addShaderFromSourceCode(QOpenGLShader::Fragment, pointSource(pointFragmentShader, splats)) ||
+            !program->link()) {
+            qWarning() << "RenderCamera: point shader disabled," << program->log();
+            delete pointProgram; pointProgram = nullptr;
+            delete splatProgram; splatProgram = nullptr;
+            return false;
+        }
+    }
+
+    shading = 1;
+    return true;
+}
+
+float RenderCamera::splatRadius(float pointSize, int viewportHeight) const
+{
+    return 0.5f * fmaxf(1.0f,pointSize) * splatReference(renderMatrix) / pixelsPerUnit(renderMatrix, viewportHeight);
+}
+
+void RenderCamera::renderPCL  (const PointCloud& pcl,
+                               const QColor& color,
+                               float pointSize) const
+{
+    PROFILE_COUNT("points drawn", pcl.size());
+    const ColorMode mode = resolve(colorMode, pcl);
+    glPointSize(fmaxf(1.0f,pointSize));
+
+    if (!initPoints()) {
+        const QVector<QVector3D>& normals = pcl.getNormals();
+        const QVector<quint32>&   colors  = pcl.getColors();
+        const QVector<float>&     values  = pcl.getIntensities();
+        const QVector<int>&       labels  = pcl.getLabels();
+        QVector2D range(pcl.getMin().z(), pcl.getMax().z());
+        if (mode == ColorMode::CM_INTENSITY && !values.isEmpty()) {
+            const auto [lo, hi] = std::minmax_element(values.begin(), values.end());
+            range = QVector2D(*lo, *hi);
+        }
+        const float scale = 1.0f / fmaxf(range.y() - range.x(), 1e-20f);
+        const auto  rgb   = [](const QVector3D& c) { glColor3f(c.x(), c.y(), c.z()); };
+        glBegin(GL_POINTS);
+        glColor3f(color);
+        for (qsizetype i=0; i<pcl.size(); i++) {
+            switch (mode) {
+            case ColorMode::CM_NORMAL:    rgb(QVector3D(0.5f,0.5f,0.5f) + 0.5f*normals[i]);                    break;
+            case ColorMode::CM_RGB:       glColor4ubv(reinterpret_cast<const GLubyte*>(&colors[i]));           break;
+            case ColorMode::CM_INTENSITY: rgb(pointRamp((values[i]   - range.x())*scale));                     break;
+            case ColorMode::CM_HEIGHT:    rgb(pointRamp((pcl[i].z()  - range.x())*scale));                     break;
+            case ColorMode::CM_LABEL:     rgb(labelColor(labels[i]));                                          break;
+            default:                      break;
+            }
+            glVertex3f(renderMatrix ^ pcl[i]);
+        }
+        glEnd();
+        return;
+    }
+
+    // channels changed since their last upload go up again, the others stay on the GPU
+    PointBuffers*& entry = pointBuffers[pcl.getId()];
+    if (!entry) entry = new PointBuffers();
+    const auto upload = [&](PointChannel c, const void* data, qsizetype bytes) {
+        const int k = int(c);
+        if (!pcl.hasChannel(c) || entry->revisions[k] == pcl.getRevision(c)) return;
+        QOpenGLBuffer& buffer = entry->buffers[k];
+        if (!buffer.isCreated()) {
+            buffer.create();
+            buffer.setUsagePattern(QOpenGLBuffer::StaticDraw);
+        }
+        buffer.bind();
+        buffer.allocate(data, int(bytes));
+        entry->revisions[k] = pcl.getRevision(c);
+        if (c == PointChannel::PC_INTENSITY) {
+            const auto [lo, hi] = std::minmax_element(pcl.getIntensities().begin(), pcl.getIntensities().end());
+            entry->intensityRange = QVector2D(*lo, *hi);
+        }
+    };
+    upload(PointChannel::PC_POSITION,  pcl.constData(),                  pcl.size() * qsizetype(sizeof(QVector4D)));
+    upload(PointChannel::PC_NORMAL,    pcl.getNormals().constData(),     pcl.size() * qsizetype(sizeof(QVector3D)));
+    upload(PointChannel::PC_COLOR,     pcl.getColors().constData(),      pcl.size() * qsizetype(sizeof(quint32)));
+    upload(PointChannel::PC_INTENSITY, pcl.getIntensities().constData(), pcl.size() * qsizetype(sizeof(float)));
+    upload(PointChannel::PC_LABEL,     pcl.getLabels().constData(),      pcl.size() * qsizetype(sizeof(int)));
+
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    QOpenGLShaderProgram* program = splatting ? splatProgram : pointProgram;
+    program->bind();
+    program->setUniformValue("renderMatrix",   renderMatrix);
+    program->setUniformValue("mode",           int(mode));
+    program->setUniformValue("uniformColor",   QVector4D(color.redF(), color.greenF(), color.blueF(), color.alphaF()));
+    program->setUniformValue("intensityRange", entry->intensityRange);
+    program->setUniformValue("heightRange",    QVector2D(pcl.getMin().z(), pcl.getMax().z()));
+    program->setUniformValue("pointSize",      fmaxf(1.0f,pointSize));
+    if (splatting) {
+        // row 2 of the render matrix gives the direction of increasing depth
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        program->setUniformValue("sizeReference", splatReference(renderMatrix));
+        program->setUniformValue("pixelsPerUnit", pixelsPerUnit(renderMatrix, viewport[3]));
+        program->setUniformValue("depthAxis",     renderMatrix.row(2).toVector3D().normalized());
+        glEnable(GL_POINT_SPRITE);
+    }
+
+    // only the channel of the mode is bound besides the positions
+    struct Attribute { const char* name; PointChannel channel; GLenum type; int size; GLboolean normalized; };
+    const Attribute position = { "position", PointChannel::PC_POSITION, GL_FLOAT, 4, GL_FALSE };
+    Attribute       colored;
+    switch (mode) {
+    case ColorMode::CM_NORMAL:    colored = { "normal",    PointChannel::PC_NORMAL,    GL_FLOAT,         3, GL_FALSE }; break;
+    case ColorMode::CM_RGB:       colored = { "rgba",      PointChannel::PC_COLOR,     GL_UNSIGNED_BYTE, 4, GL_TRUE  }; break;
+    case ColorMode::CM_INTENSITY: colored = { "intensity", PointChannel::PC_INTENSITY, GL_FLOAT,         1, GL_FALSE }; break;
+    case ColorMode::CM_LABEL:     colored = { "label",     PointChannel::PC_LABEL,     GL_INT,           1, GL_FALSE }; break;
+    default:                      colored = position;                                                                  break;
+    }
+    QVector<int> enabled;
+    for (const Attribute& a: { position, colored }) {
+        const int loc = program->attributeLocation(a.name);
+        if (loc < 0 || enabled.contains(loc)) continue;
+        entry->buffers[int(a.channel)].bind();
+        f->glEnableVertexAttribArray(GLuint(loc));
+        f->glVertexAttribPointer(GLuint(loc), a.size, a.type, a.normalized, 0, nullptr);
+        enabled.append(loc);
+    }
+    f->glDrawArrays(GL_POINTS, 0, GLsizei(pcl.size()));
+
+    // restore the state expected by the immediate mode methods
+    if (splatting) glDisable(GL_POINT_SPRITE);
+    for (int loc: enabled) f->glDisableVertexAttribArray(GLuint(loc));
+    QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+    program->release();
+}
+
+//
+// Instanced rendering needs desktop GL 3.3 for glVertexAttribDivisor (a compatibility context, since
+// the shaders are GLSL 1.20). Without it, or if they do not compile, renderBoxes uses immediate mode.
+//
+bool RenderCamera::initBoxes() const
+{
+    if (instancing >= 0) return instancing > 0;
+    instancing = 0;
+
+    const QOpenGLContext* context = QOpenGLContext::currentContext();
+    if (!context) return false;
+    if (context->isOpenGLES() || context->format().version() < qMakePair(3,3)) return false;
+
+    boxProgram = new QOpenGLShaderProgram();
+    if (!boxProgram->addShaderFromSourceCode(QOpenGLShader::Vertex,   boxVertexShader  ) ||
+        !boxProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, boxFragmentShader) ||
+        !boxProgram->link()) {
+        qWarning() << "RenderCamera: instanced boxes disabled," << boxProgram->log();
+        delete boxProgram;
+        boxProgram = nullptr;
+        return false;
+    }
+
+    unitMesh = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    unitMesh->create();
+    unitMesh->setUsagePattern(QOpenGLBuffer::StaticDraw);
+    unitMesh->bind();
+    unitMesh->allocate(unitVertices, int(sizeof(unitVertices)));
+    unitMesh->release();
+
+    instanceData = new QOpenGLBuffer(QOpenGLBuffer::VertexBuffer);
+    instanceData->create();
+    instanceData->setUsagePattern(QOpenGLBuffer::StreamDraw);
+
+    instancing = 1;
+    return true;
+}
+
+void RenderCamera::releaseStaleBuffers() const
+{
+    for (quint64 id: pointBuffers.keys())
+        if (!PointCloud::isAlive(id)) delete pointBuffers.take(id);
+}
+
+void RenderCamera::releaseGL()
+{
+    delete boxProgram;   boxProgram   = nullptr;
+    delete unitMesh;     unitMesh     = nullptr;
+    delete instanceData; instanceData = nullptr;
+    instancing = -1;
+
+    delete pointProgram; pointProgram = nullptr;
+    delete splatProgram; splatProgram = nullptr;
+    qDeleteAll(pointBuffers);
+    pointBuffers.clear();
+    shading = -1;
+}
+
+void RenderCamera::renderBoxes(const QVector<BoxInstance>& boxes,
+                               const QMatrix4x4& model,
+                               BoxStyle style,
+                               float lineWidth) const
+{
+    if (boxes.isEmpty()) return;
+    const bool quads = style == BoxStyle::BS_QUADS;
+    PROFILE_COUNT("boxes drawn", boxes.size());
+
+    if (!initBoxes()) {
+        // immediate mode: the corners of the unit mesh are mapped per box on the CPU
+        const QMatrix4x4 M     = renderMatrix * model;
+        const int        first = quads ? EDGE_VERTICES : 0;
+        const int        count = quads ? QUAD_VERTICES : EDGE_VERTICES;
+        glLineWidth(fmaxf(1.0f,lineWidth));
+        glBegin(quads ? GL_TRIANGLES : GL_LINES);
+        for (const BoxInstance& b: boxes) {
+            const QVector3D e = b.bbMax - b.bbMin;
+            glColor4f(b.color.x(), b.color.y(), b.color.z(), b.color.w());
+            for (int i = first; i < first+count; i++) {
+                QVector3D u(unitVertices[3*i], unitVertices[3*i+1], unitVertices[3*i+2]);
+                if (quads) u = (e.x() == 0.0f) ? QVector3D(0, u.x(), u.y()) : (e.y() == 0.0f) ? QVector3D(u.x(), 0, u.y()) : u;
+                glVertex3f(M ^ (b.bbMin + e*u));
+            }
+        }
+        glEnd();
+        return;
+    }
+
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    boxProgram->bind();
+    boxProgram->setUniformValue("renderMatrix", renderMatrix * model);
+    boxProgram->setUniformValue("quads",        quads);
+
+    const int unit     = boxProgram->attributeLocation("unit");
+    const int boxMin   = boxProgram->attributeLocation("boxMin");
+    const int boxMax   = boxProgram->attributeLocation("boxMax");
+    const int boxColor = boxProgram->attributeLocation("boxColor");
+
+    unitMesh->bind();
+    boxProgram->enableAttributeArray(unit);
+    boxProgram->setAttributeBuffer  (unit, GL_FLOAT, 0, 3);
+
+    // the whole instance array goes up in one call, the previous contents are orphaned
+    instanceData->bind();
+    instanceData->allocate(boxes.constData(), int(boxes.size()*sizeof(BoxInstance)));
+    const int stride = int(sizeof(BoxInstance));
+    for (int loc: {boxMin, boxMax, boxColor}) {
+        boxProgram->enableAttributeArray(loc);
+        f->glVertexAttribDivisor(GLuint(loc), 1);
+    }
+    boxProgram->setAttributeBuffer(boxMin,   GL_FLOAT, int(offsetof(BoxInstance, bbMin)), 3, stride);
+    boxProgram->setAttributeBuffer(boxMax,   GL_FLOAT, int(offsetof(BoxInstance, bbMax)), 3, stride);
+    boxProgram->setAttributeBuffer(boxColor, GL_FLOAT, int(offsetof(BoxInstance, color)), 4, stride);
+
+    glLineWidth(fmaxf(1.0f,lineWidth));
+    if (quads) f->glDrawArraysInstanced(GL_TRIANGLES, EDGE_VERTICES, QUAD_VERTICES, GLsizei(boxes.size()));
+    else       f->glDrawArraysInstanced(GL_LINES,     0,             EDGE_VERTICES, GLsizei(boxes.size()));
+
+    // restore the state expected by the immediate mode methods
+    for (int loc: {boxMin, boxMax, boxColor}) {
+        f->glVertexAttribDivisor(GLuint(loc), 0);
+        boxProgram->disableAttributeArray(loc);
+    }
+    boxProgram->disableAttributeArray(unit);
+    QOpenGLBuffer::release(QOpenGLBuffer::VertexBuffer);
+    boxProgram->release();
+}
@@ -10,8 +10,32 @@
 #pragma once
 
 #include <QObject>
+#include <QHash>
 #include <QMatrix4x4>
 #include <QVector3D>
+#include <QVector4D>
+
+class QOpenGLShaderProgram;
+class QOpenGLBuffer;
+class PointCloud;
+
+// axis-aligned box for instanced rendering; boxes with a zero extent render as rectangles
+struct BoxInstance {
+  QVector3D bbMin, bbMax;
+  QVector4D color;                                  // rgb and alpha in [0,1]
+};
+
+enum class BoxStyle {BS_EDGES,                      // the 12 edges of each box
+                     BS_QUADS};                     // flat boxes as filled rectangles
+
+// coloring of point clouds by their channels, see PointChannel
+enum class ColorMode {CM_AUTO,                      // colors, else normals, else uniform
+                      CM_UNIFORM,                   // the color of the object
+                      CM_NORMAL,                    // normals as rgb
+                      CM_RGB,                       // the cloud's colors
+                      CM_INTENSITY,                 // ramp over the intensity range
+                      CM_HEIGHT,                    // ramp over the z range of the AABB
+                      CM_LABEL};                    // palette by label, gray for -1
 
 class RenderCamera : public QObject
 {
@@ -44,6 +68,33 @@ public:
   void renderPCL  (const QVector<QVector4D>& pcl,   // render point cloud of homogeneous points
                    const QColor&             color,
                    float                     pointSize=3.0f) const;
+  void renderPCL  (const PointCloud&         pcl,   // render point cloud colored by the color mode, color for CM_UNIFORM
+                   const QColor&             color,
+                   float                     pointSize=3.0f) const;
+  void renderBoxes(const QVector<BoxInstance>& boxes, // render boxes mapped by model in one instanced draw call
+                   const QMatrix4x4&           model,
+                   BoxStyle                    style,
+                   float                       lineWidth=1.0f) const;
+
+  // frees the GL resources of renderBoxes and the point clouds, the widget's context has to be current
+  void releaseGL();
+
+  // frees the vertex buffers of destroyed point clouds; call once per frame (not per cloud, it
+  // checks every buffer), the context has to be current
+  void releaseStaleBuffers() const;
+
+  // coloring of point clouds; modes whose channel a cloud does not have fall back to CM_AUTO
+  void      setColorMode(ColorMode m) { colorMode = m; }
+  ColorMode getColorMode() const      { return colorMode; }
+
+  // screen-space splats of the point shader: round, depth-correct as spheres and sized by distance
+  // (pointSize at the depth of the world origin); off by default, i.e. square points of pointSize
+  void setSplatting(bool on) { splatting = on; }
+  bool getSplatting() const  { return splatting; }
+
+  // world radius of the splats of pointSize in a viewport of viewportHeight pixels; the same at all
+  // distances, as their size on screen falls off like that of the world (e.g. for picking them)
+  float splatRadius(float pointSize, int viewportHeight) const;
 
   // methods for render camera navigation
   void setup   ();
@@ -62,9 +113,13 @@ public:
   void setCameraMatrix    (const QMatrix4x4& C);
   void setWorldMatrix     (const QMatrix4x4& W);
 
+  // points the camera from eye to center (world coordinates), e.g. for camera paths; replaces the camera matrix
+  void lookAt(const QVector3D& eye, const QVector3D& center, const QVector3D& up);
+
   // getter-methods for render camera mappings
-  QMatrix4x4 getRenderMatrix() const;
-  QMatrix4x4 getViewMatrix  () const;
+  QMatrix4x4 getRenderMatrix    () const;
+  QMatrix4x4 getViewMatrix      () const;
+  QMatrix4x4 getProjectionMatrix() const;
 
 signals:
   void changed();
@@ -85,9 +140,28 @@ private:
   QMatrix4x4 worldMatrix;
   QMatrix4x4 renderMatrix;
 
+  // GL resources of renderBoxes, created on first use within the current context
+  mutable QOpenGLShaderProgram* boxProgram    = nullptr;
+  mutable QOpenGLBuffer*        unitMesh      = nullptr;    // unit cube edges and unit quad
+  mutable QOpenGLBuffer*        instanceData  = nullptr;    // streamed per call
+  mutable int                   instancing    = -1;         // -1: not yet checked, 0: immediate mode fallback
+  bool initBoxes() const;
+
+  // GL resources of the point clouds: one vertex buffer per channel and cloud, uploaded again only
+  // when the channel's revision changed; the entries of destroyed clouds are freed by releaseStaleBuffers
+  struct PointBuffers;
+  ColorMode                              colorMode     = ColorMode::CM_AUTO;
+  bool                                   splatting     = false;
+  mutable QOpenGLShaderProgram*          pointProgram  = nullptr;
+  mutable QOpenGLShaderProgram*          splatProgram  = nullptr;     // compiled with SPLATS
+  mutable QHash<quint64, PointBuffers*>  pointBuffers;                // by PointCloud::getId
+  mutable int                            shading       = -1;         // -1: not yet checked, 0: immediate mode fallback
+  bool initPoints() const;
+
   const int   RotationBASE    = 360;
   const int   RotationSTEP    = 1;
   const float TranslationSTEP = 0.002f;
+  const float RenderSCALE     = 0.05f;                    // scale of the world in the render matrix
 };
 
 
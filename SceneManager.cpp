@@ -1,18 +1,429 @@
 //
-//  A very simple class for rudimentary scene management
+//  A simple scene graph for scene management
 //
 //  (c) Georg Umlauf, 2021+2022
 //
 
 #include "SceneManager.h"
+#include "KdTree.h"
+#include "PerspectiveCamera.h"
+#include "PointCloud.h"
+#include "StereoCamera.h"
+#include "Profiler.h"
+
+#include <algorithm>
 
 using enum SceneObjectType;
+
+namespace {
+constexpr quint32 NIL = 0xFFFFFFFFu;
+}
+
+SceneManager::SceneManager(QObject* parent): QObject(parent)
+{
+    nodes.emplace_back();
+    nodes[0].alive = true;
+    nodes[0].name  = "root";
+}
+
+SceneManager::~SceneManager()
+{
+    for (Node& n: nodes) if (n.alive) delete n.object;
+}
+
+SceneManager::Node* SceneManager::node(SceneHandle h)
+{
+    return (h.index < nodes.size() && nodes[h.index].alive && nodes[h.index].generation == h.generation) ? &nodes[h.index] : nullptr;
+}
+
+const SceneManager::Node* SceneManager::node(SceneHandle h) const
+{
+    return (h.index < nodes.size() && nodes[h.index].alive && nodes[h.index].generation == h.generation) ? &nodes[h.index] : nullptr;
+}
+
+SceneHandle SceneManager::insert(SceneObject* obj, const QString& name, SceneHandle parent)
+{
+    const quint32 p = node(parent) ? parent.index : 0;
+
+    quint32 i;
+    if (freeSlots.empty()) {
+        i = quint32(nodes.size());
+        nodes.emplace_back();
+    } else {
+        i = freeSlots.back();
+        freeSlots.pop_back();
+    }
+
+    // reset the slot, but keep its generation
+    Node& n      = nodes[i];
+    const quint32 generation = n.generation;
+    n            = Node();
+    n.generation = generation;
+    n.alive      = true;
+    n.object     = obj;
+    n.name       = name;
+    n.parent     = p;
+
+    // append to the parent's children
+    n.prev = nodes[p].lastChild;
+    if (n.prev != NIL) nodes[n.prev].next = i;
+    else               nodes[p].firstChild = i;
+    nodes[p].lastChild = i;
+    nodes[p].childCount++;
+
+    markBounds(p);
+    objectsDirty = true;
+    return handle(i);
+}
+
+SceneHandle SceneManager::addGroup(const QString& name, SceneHandle parent)
+{
+    return insert(nullptr, name, parent);
+}
+
+SceneHandle SceneManager::add(SceneObject* obj, SceneHandle parent)
+{
+    return insert(obj, QString(), parent);
+}
+
+// frees the slot of node index and of its subtree, the node has to be unlinked already
+void SceneManager::release(quint32 index)
+{
+    // iteratively, tree visualizations may be deep and wide
+    std::vector<quint32> stack = { index };
+    while (!stack.empty()) {
+        const quint32 i = stack.back();
+        stack.pop_back();
+        for (quint32 c = nodes[i].firstChild; c != NIL; c = nodes[c].next) stack.push_back(c);
+
+        Node& n = nodes[i];
+        delete n.object;
+        n.object = nullptr;
+        n.name.clear();
+        n.alive  = false;
+        n.generation++;
+        freeSlots.push_back(i);
+    }
+}
+
+void SceneManager::remove(SceneHandle h)
+{
+    if (!node(h) || h.index == 0) return;
+
+    Node&         n = nodes[h.index];
+    const quint32 p = n.parent;
+    if (n.prev != NIL) nodes[n.prev].next = n.next; else nodes[p].firstChild = n.next;
+    if (n.next != NIL) nodes[n.next].prev = n.prev; else nodes[p].lastChild  = n.prev;
+    nodes[p].childCount--;
+
+    release(h.index);
+    markBounds(p);
+    objectsDirty = true;
+}
+
+void SceneManager::clear(SceneHandle h)
+{
+    Node* n = node(h);
+    if (!n) return;
+
+    for (quint32 c = n->firstChild; c != NIL; ) {
+        const quint32 next = nodes[c].next;
+        release(c);
+        c = next;
+    }
+    n = &nodes[h.index];
+    n->firstChild = n->lastChild = NIL;
+    n->childCount = 0;
+
+    markBounds(h.index);
+    objectsDirty = true;
+}
+
+void SceneManager::replace(SceneHandle h, SceneObject* obj)
+{
+    Node* n = node(h);
+    if (!n || n->object == obj) return;
+
+    delete n->object;
+    n->object = obj;
+    markBounds(h.index);
+    objectsDirty = true;
+}
+
+SceneObject* SceneManager::object(SceneHandle h) const
+{
+    const Node* n = node(h);
+    return n ? n->object : nullptr;
+}
+
+SceneHandle SceneManager::parent(SceneHandle h) const
+{
+    const Node* n = node(h);
+    return (n && n->parent != NIL) ? handle(n->parent) : SceneHandle();
+}
+
+QString SceneManager::name(SceneHandle h) const
+{
+    const Node* n = node(h);
+    return n ? n->name : QString();
+}
+
+unsigned SceneManager::childCount(SceneHandle h) const
+{
+    const Node* n = node(h);
+    return n ? n->childCount : 0;
+}
+
+std::vector<SceneHandle> SceneManager::children(SceneHandle h) const
+{
+    std::vector<SceneHandle> result;
+    if (const Node* n = node(h))
+        for (quint32 c = n->firstChild; c != NIL; c = nodes[c].next) result.push_back(handle(c));
+    return result;
+}
+
+void SceneManager::setVisible(SceneHandle h, bool visible)
+{
+    Node* n = node(h);
+    if (!n || n->visible == visible) return;
+    n->visible   = visible;
+    objectsDirty = true;
+    bvhDirty     = true;
+}
+
+bool SceneManager::isVisible(SceneHandle h) const
+{
+    const Node* n = node(h);
+    return n && n->visible;
+}
+
+// bounds of index and its ancestors are stale; stops at the first ancestor already marked
+void SceneManager::markBounds(quint32 index)
+{
+    bvhDirty = true;
+    for (quint32 i = index; i != NIL && !nodes[i].boundsDirty; i = nodes[i].parent)
+        nodes[i].boundsDirty = true;
+}
+
+// world transforms of index and its descendants are stale
+void SceneManager::markWorld(quint32 index)
+{
+    std::vector<quint32> stack = { index };
+    while (!stack.empty()) {
+        const quint32 i = stack.back();
+        stack.pop_back();
+        if (nodes[i].worldDirty && i != index) continue;       // its subtree is marked already
+        nodes[i].worldDirty = true;
+        for (quint32 c = nodes[i].firstChild; c != NIL; c = nodes[c].next) stack.push_back(c);
+    }
+}
+
+// maps the objects of index and its descendants by M
+void SceneManager::mapSubtree(quint32 index, const QMatrix4x4& M)
+{
+    bvhDirty = true;
+    std::vector<quint32> stack = { index };
+    while (!stack.empty()) {
+        const quint32 i = stack.back();
+        stack.pop_back();
+        if (nodes[i].object) nodes[i].object->affineMap(M);
+        nodes[i].boundsDirty = true;
+        for (quint32 c = nodes[i].firstChild; c != NIL; c = nodes[c].next) stack.push_back(c);
+    }
+}
+
+void SceneManager::setTransform(SceneHandle h, const QMatrix4x4& local)
+{
+    Node* n = node(h);
+    if (!n) return;
+
+    // the world transform of the subtree changes by W' W^-1 = P L' L^-1 P^-1 with the parent's world transform P
+    const QMatrix4x4 P     = worldTransform(parent(h));
+    const QMatrix4x4 delta = P * local * n->local.inverted() * P.inverted();
+    n->local = local;
+
+    mapSubtree(h.index, delta);
+    markWorld (h.index);
+    if (n->parent != NIL) markBounds(n->parent);
+}
+
+void SceneManager::transform(SceneHandle h, const QMatrix4x4& M)
+{
+    if (const Node* n = node(h)) setTransform(h, M * n->local);
+}
+
+QMatrix4x4 SceneManager::localTransform(SceneHandle h) const
+{
+    const Node* n = node(h);
+    return n ? n->local : QMatrix4x4();
+}
+
+QMatrix4x4 SceneManager::worldTransform(SceneHandle h) const
+{
+    const Node* n = node(h);
+    if (!n) return QMatrix4x4();
+    if (n->worldDirty) {
+        n->world      = (n->parent == NIL) ? n->local : worldTransform(handle(n->parent)) * n->local;
+        n->worldDirty = false;
+    }
+    return n->world;
+}
+
+void SceneManager::updateBounds(quint32 index) const
+{
+    const Node& n = nodes[index];
+    if (!n.boundsDirty) return;
+
+    n.hasBounds = n.object && n.object->getBounds(n.bbMin, n.bbMax);
+    for (quint32 c = n.firstChild; c != NIL; c = nodes[c].next) {
+        updateBounds(c);
+        const Node& child = nodes[c];
+        if (!child.hasBounds) continue;
+        if (!n.hasBounds) {
+            n.bbMin     = child.bbMin;
+            n.bbMax     = child.bbMax;
+            n.hasBounds = true;
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            n.bbMin[k] = std::min(n.bbMin[k], child.bbMin[k]);
+            n.bbMax[k] = std::max(n.bbMax[k], child.bbMax[k]);
+        }
+    }
+    n.boundsDirty = false;
+}
+
+bool SceneManager::bounds(SceneHandle h, QVector3D& bbMin, QVector3D& bbMax) const
+{
+    const Node* n = node(h);
+    if (!n) return false;
+    updateBounds(h.index);
+    if (n->hasBounds) { bbMin = n->bbMin; bbMax = n->bbMax; }
+    return n->hasBounds;
+}
+
+void SceneManager::markDirty(SceneHandle h)
+{
+    if (node(h)) markBounds(h.index);
+}
+
+MemoryUsage SceneManager::memoryUsage() const
+{
+    MemoryUsage usage = containerUsage(nodes);
+    usage += containerUsage(freeSlots);
+    usage += containerUsage(visibleObjects);
+    usage += bvh.memoryUsage();
+    usage += containerUsage(bounded);
+    usage += containerUsage(culled);
+    for (const Node& n: nodes)
+        if (n.alive && n.object) usage += n.object->memoryUsage();
+    return usage;
+}
+
+void SceneManager::collect(quint32 index) const
+{
+    const Node& n = nodes[index];
+    if (!n.visible) return;
+    if (n.object) visibleObjects.push_back(n.object);
+    for (quint32 c = n.firstChild; c != NIL; c = nodes[c].next) collect(c);
+}
+
+const std::vector<SceneObject*>& SceneManager::objects() const
+{
+    if (objectsDirty) {
+        visibleObjects.clear();
+        collect(0);
+        objectsDirty = false;
+    }
+    return visibleObjects;
+}
+
+// rebuilds the BVH over the bounds of the visible objects
+void SceneManager::updateBVH() const
+{
+    if (!bvhDirty) return;
+    PROFILE_SCOPE("scene BVH build");
+
+    std::vector<BVHItem> items;
+    std::vector<quint32> stack = { 0 };
+    bounded.clear();
+    while (!stack.empty()) {
+        const quint32 i = stack.back();
+        const Node&   n = nodes[i];
+        stack.pop_back();
+        if (!n.visible) continue;
+        BVHItem item;
+        if (n.object && n.object->getBounds(item.bbMin, item.bbMax)) {
+            item.id = i;
+            items.push_back(item);
+            bounded.push_back(i);
+        }
+        for (quint32 c = n.firstChild; c != NIL; c = nodes[c].next) stack.push_back(c);
+    }
+    bvh.build(std::move(items));
+    bvhDirty = false;
+}
+
+std::vector<SceneHandle> SceneManager::overlapping(const QVector3D& bbMin, const QVector3D& bbMax) const
+{
+    updateBVH();
+    std::vector<quint32> ids;
+    bvh.overlapping(bbMin, bbMax, ids);
+
+    std::vector<SceneHandle> result;
+    result.reserve(ids.size());
+    for (quint32 i: ids) result.push_back(handle(i));
+    return result;
+}
+
+std::vector<std::pair<SceneHandle, int>> SceneManager::radiusSearch(const QVector3D& q, float radius) const
+{
+    std::vector<std::pair<SceneHandle, int>> result;
+    std::vector<int>                         hits;
+    const QVector3D                          r(radius, radius, radius);
+    for (SceneHandle h: overlapping(q - r, q + r)) {
+        const SceneObject* obj = object(h);
+        if (obj->getType() != ST_POINT_CLOUD) continue;
+        hits.clear();
+        ::radiusSearch(static_cast<const PointCloud*>(obj)->getKdTree(), QVector4D(q, 1.0f), radius, hits);
+        for (int i: hits) result.emplace_back(h, i);
+    }
+    return result;
+}
+
+std::pair<SceneHandle, int> SceneManager::pick(const PickRay& ray, float* t) const
+{
+    PROFILE_SCOPE("pick");
+
+    std::pair<SceneHandle, int> result(SceneHandle(), -1);
+    QVector3D bbMin, bbMax;
+    updateBVH();
+    if (!bvh.bounds(bbMin, bbMax)) return result;
+
+    std::vector<std::pair<float, quint32>> hits;
+    float best = ray.farthest(bbMin, bbMax);
+    bvh.alongRay(ray, best, hits);
+    for (const auto& [entry, i]: hits) {
+        if (entry > best) break;
+        const SceneObject* obj = nodes[i].object;
+        if (obj->getType() != ST_POINT_CLOUD || !obj->getBounds(bbMin, bbMax)) continue;
+        const int index = rayPick(static_cast<const PointCloud*>(obj)->getKdTree(), ray, bbMin, bbMax, best);
+        if (index >= 0) result = { handle(i), index };
+    }
+    if (t) *t = best;
+    return result;
+}
+
 //
-// iterates all objects under its control and has them drawn by the renderer
+// draws an object depending on its type
 //
-void SceneManager::draw(const RenderCamera& renderer, const QColor& color) const
+void SceneManager::drawSubtree(quint32 index, const RenderCamera& renderer, const QColor& color) const
 {
-    for (auto obj : *this) if (obj) {
+    const Node& n = nodes[index];
+    if (!n.visible) return;
+
+    const SceneObject* obj = culled.empty() || !culled[index] ? n.object : nullptr;
+    if (obj) {
         switch (obj->getType()) {
         case ST_AXES:
             obj->draw(renderer,COLOR_AXES,2.0f);
@@ -27,16 +438,43 @@ void SceneManager::draw(const RenderCamera& renderer, const QColor& color) const
         case ST_POINT_CLOUD:
             obj->draw(renderer,COLOR_POINT_CLOUD,3.0f);     // last argument unused
             break;
+        case ST_INSTANCED_BOXES:
+            obj->draw(renderer,color,2.0f);                 // boxes carry their own colors
+            break;
         case ST_PERSPECTIVE_CAMERA:
-            // TODO: Assignement 1, Part 3
-            // This is the place to invoke the perspective camera's projection method and draw the projected objects.
-           break;
+            // draws the camera and the projections of the other objects onto its image plane
+            obj->draw(renderer,COLOR_CAMERA,1.0f);
+            static_cast<const PerspectiveCamera*>(obj)->drawProjections(renderer,objects());
+            break;
         case ST_STEREO_CAMERA:
-            // TODO: Assignement 2, Part 1 - 3
-            // Part 1: This is the place to invoke the stereo camera's projection method and draw the projected objects.
-            // Part 2: This is the place to invoke the stereo camera's reconstruction method.
-            // Part 3: This is the place to invoke the stereo camera's reconstruction method using misaligned stereo cameras.
-           break;
+            // draws the rig, the projections of the other objects onto its image planes and their reconstruction
+            obj->draw(renderer,COLOR_CAMERA,1.0f);
+            static_cast<const StereoCamera*>(obj)->drawProjections(renderer,objects());
+            break;
+        default:
+            break;
         }
     }
+    for (quint32 c = n.firstChild; c != NIL; c = nodes[c].next) drawSubtree(c, renderer, color);
+}
+
+//
+// traverses all visible nodes and has their objects drawn by the renderer
+//
+void SceneManager::draw(const RenderCamera& renderer, const QColor& color) const
+{
+    PROFILE_SCOPE("SceneManager::draw");
+
+    // objects in the BVH are culled unless the view reaches them
+    culled.clear();
+    if (culling) {
+        updateBVH();
+        std::vector<quint32> inView;
+        bvh.visible(Frustum::fromMatrix(renderer.getRenderMatrix()), inView);
+        culled.assign(nodes.size(), 0);
+        for (quint32 i: bounded) culled[i] = 1;
+        for (quint32 i: inView)  culled[i] = 0;
+        PROFILE_COUNT("objects culled", qint64(bounded.size() - inView.size()));
+    }
+    drawSubtree(0, renderer, color);
 }
@@ -1,5 +1,18 @@
 //
-//  A very simple class for rudimentary scene management
+//  A simple scene graph for scene management
+//
+//  Nodes are stored in a slot array and addressed by handles (slot + generation), which
+//  stay valid while their node exists and are detected as stale afterwards. Group nodes
+//  without object, e.g. the layers "kd planes" or "octree cubes", collect other nodes and
+//  can be hidden in O(1). Each node has a local transform relative to its parent; since
+//  scene objects keep their geometry in world coordinates, changing a transform maps the
+//  objects of the subtree by the resulting change of the world transform. World bounds
+//  are cached per subtree and recomputed lazily along dirty flags.
+//
+//  Besides, a BVH over the world bounds of the visible objects (see BVH.h) is rebuilt lazily
+//  after any such change. It culls the objects outside the view when drawing and finds the
+//  objects of a region, e.g. the point cloud tiles, each with its own kd-tree, that a query
+//  around a point can reach, and the clouds along a picking ray, front to back.
 //
 //  (c) Georg Umlauf, 2021+2022
 //
@@ -7,19 +20,133 @@
 
 #include "SceneObject.h"
 #include "RenderCamera.h"
+#include "BVH.h"
 
+#include <utility>
 #include <vector>
 #include <QObject>
 #include <QColor>
+#include <QString>
 
-class SceneManager: public QObject, public std::vector<SceneObject*>
+// stable reference to a node of the scene graph
+struct SceneHandle {
+    quint32 index      = 0xFFFFFFFFu;
+    quint32 generation = 0;
+
+    bool operator==(const SceneHandle& h) const { return index == h.index && generation == h.generation; }
+    bool operator!=(const SceneHandle& h) const { return !(*this == h); }
+};
+
+class SceneManager: public QObject
 {
 private:
+    struct Node {
+        SceneObject*       object     = nullptr;    // owned, nullptr for groups
+        QString            name;
+        QMatrix4x4         local;                   // relative to the parent
+        mutable QMatrix4x4 world;
+        mutable QVector3D  bbMin, bbMax;            // world bounds of the subtree
+        mutable bool       hasBounds  = false;
+        mutable bool       worldDirty  = true;
+        mutable bool       boundsDirty = true;
+        bool               visible    = true;
+        bool               alive      = false;
+        quint32            generation = 0;
+        quint32            parent     = 0xFFFFFFFFu;
+        quint32            firstChild = 0xFFFFFFFFu, lastChild = 0xFFFFFFFFu;
+        quint32            prev       = 0xFFFFFFFFu, next      = 0xFFFFFFFFu;
+        quint32            childCount = 0;
+    };
+
+    std::vector<Node>                  nodes;       // nodes[0] is the root
+    std::vector<quint32>               freeSlots;
+    mutable std::vector<SceneObject*>  visibleObjects;
+    mutable bool                       objectsDirty = true;
+    mutable BVH                        bvh;                 // ids are node indices
+    mutable std::vector<quint32>       bounded;             // nodes in the BVH, i.e. visible objects with bounds
+    mutable std::vector<char>          culled;              // per node, during draw
+    mutable bool                       bvhDirty     = true;
+    bool                               culling      = true;
+
+    Node*       node(SceneHandle h);
+    const Node* node(SceneHandle h) const;
+    SceneHandle handle(quint32 index) const { return { index, nodes[index].generation }; }
+
+    SceneHandle insert      (SceneObject* obj, const QString& name, SceneHandle parent);
+    void        release     (quint32 index);
+    void        markBounds  (quint32 index);
+    void        markWorld   (quint32 index);
+    void        mapSubtree  (quint32 index, const QMatrix4x4& M);
+    void        updateBounds(quint32 index) const;
+    void        collect     (quint32 index) const;
+    void        updateBVH   () const;
+    void        drawSubtree (quint32 index, const RenderCamera& renderer, const QColor& color) const;
+
 public:
-    SceneManager(QObject* parent=nullptr): QObject(parent) {}
-    ~SceneManager () override {}
+    SceneManager(QObject* parent=nullptr);
+    ~SceneManager () override;
+
+    SceneHandle root() const { return handle(0); }
+
+    // Adds a group node (e.g. a layer) or an object below parent (default: root). The scene takes
+    // ownership of obj. The object's geometry is taken as is, i.e. in world coordinates.
+    SceneHandle addGroup(const QString& name, SceneHandle parent = SceneHandle());
+    SceneHandle add     (SceneObject* obj,    SceneHandle parent = SceneHandle());
+
+    // Removes (and deletes) the node with its subtree resp. only the subtree below it. Stale handles are ignored.
+    void remove(SceneHandle h);
+    void clear (SceneHandle h);
+
+    // Replaces the node's object (the old one is deleted), e.g. by a filtered copy of a point cloud.
+    void replace(SceneHandle h, SceneObject* obj);
 
-    // Iterates all objects under its control and has them drawn by the renderer
+    bool         isValid   (SceneHandle h) const { return node(h) != nullptr; }
+    SceneObject* object    (SceneHandle h) const;
+    SceneHandle  parent    (SceneHandle h) const;
+    QString      name      (SceneHandle h) const;
+    unsigned     childCount(SceneHandle h) const;
+    std::vector<SceneHandle> children(SceneHandle h) const;
+
+    // Visibility of a node and its subtree; hidden subtrees are neither drawn nor listed in objects().
+    void setVisible(SceneHandle h, bool visible);
+    bool isVisible (SceneHandle h) const;
+
+    // Local transform relative to the parent; setting it maps all objects of the subtree accordingly.
+    void       setTransform  (SceneHandle h, const QMatrix4x4& local);
+    void       transform     (SceneHandle h, const QMatrix4x4& M);      // local = M * local
+    QMatrix4x4 localTransform(SceneHandle h) const;
+    QMatrix4x4 worldTransform(SceneHandle h) const;
+
+    // Cached world AABB of the subtree. Returns false, if it contains no object with bounds.
+    bool bounds(SceneHandle h, QVector3D& bbMin, QVector3D& bbMax) const;
+
+    // Has to be called after an object was modified directly (e.g. by affineMap), so bounds are updated.
+    void markDirty(SceneHandle h);
+
+    // Memory of the graph's nodes and of all objects' arrays (the objects themselves are tracked as MC_SCENE_OBJECTS)
+    MemoryUsage memoryUsage() const;
+
+    // All visible objects in drawing order (cached until the structure or the visibility changes)
+    const std::vector<SceneObject*>& objects() const;
+
+    // Visible objects whose world AABB overlaps [bbMin,bbMax], found through the BVH
+    std::vector<SceneHandle> overlapping(const QVector3D& bbMin, const QVector3D& bbMax) const;
+
+    // Points within radius of q in all visible point clouds as (cloud's node, point index); only
+    // the clouds whose bounds reach q are searched, each with its own kd-tree
+    std::vector<std::pair<SceneHandle, int>> radiusSearch(const QVector3D& q, float radius) const;
+
+    // Point of all visible point clouds in the cone ray that is nearest to its origin (smallest t),
+    // as (cloud's node, point index), an invalid handle if there is none. The clouds are searched
+    // front to back by their bounds, each with its own kd-tree, until the next one lies behind
+    // the hit; t (optional) receives the hit's ray parameter.
+    std::pair<SceneHandle, int> pick(const PickRay& ray, float* t = nullptr) const;
+
+    // View-frustum culling in draw (default on): objects whose bounds are outside the view are skipped
+    void setCulling(bool on) { culling = on; }
+    bool getCulling() const  { return culling; }
+
+    // Traverses the visible objects in drawing order and has them drawn by the renderer
     //
     // ATTENTION: You have to inherit from SceneObject, i.e., you MUST implement your own
     //            draw- and affineMap-method in your SceneObjects!!!!!
@@ -28,4 +155,3 @@ public:
     void draw(const RenderCamera& renderer,
               const QColor      & color    = COLOR_SCENE) const;
 };
-
@@ -10,6 +10,7 @@
 #include <QColor>
 #include <QMatrix4x4>
 #include "RenderCamera.h"
+#include "MemoryTracker.h"
 
 // some predefined colors
 [[maybe_unused]] const QColor COLOR_AXES           = QColor(255,  0,  0);
@@ -18,6 +19,7 @@
 [[maybe_unused]] const QColor COLOR_RECONSTRUCTION = QColor(255,  0,  0);
 [[maybe_unused]] const QColor COLOR_CAMERA         = QColor(255,  0,  0);
 [[maybe_unused]] const QColor COLOR_POINT_CLOUD    = QColor(255,255,255);
+[[maybe_unused]] const QColor COLOR_PICK           = QColor(255,  0,255);
 
 // some example object types, that you might use
 enum class SceneObjectType {ST_NONE                     [[maybe_unused]],   //
@@ -28,6 +30,7 @@ enum class SceneObjectType {ST_NONE                     [[maybe_unused]],   //
                             ST_PERSPECTIVE_CAMERA       [[maybe_unused]],   // perspective camera
                             ST_STEREO_CAMERA            [[maybe_unused]],   // stereo cameras
                             ST_POINT_CLOUD              [[maybe_unused]],   // point cloud
+                            ST_INSTANCED_BOXES          [[maybe_unused]],   // boxes drawn by one instanced call, e.g. tree visualizations
                             ST_MaxSceneType             [[maybe_unused]]};
 
 class SceneObject
@@ -44,5 +47,13 @@ public:
     virtual void affineMap(const QMatrix4x4&                        )       = 0;
     virtual void draw     (const RenderCamera&, const QColor&, float) const = 0;
 
+    // world-space AABB, false for objects without (finite) extent
+    virtual bool getBounds(QVector3D& /*bbMin*/, QVector3D& /*bbMax*/) const { return false; }
+
+    // memory of the object's arrays, the object itself is tracked as MC_SCENE_OBJECTS
+    virtual MemoryUsage memoryUsage() const { return MemoryUsage(); }
+
+    TRACK_INSTANCES(MemoryCategory::MC_SCENE_OBJECTS)
+
     SceneObjectType getType() const { return type; }
 };
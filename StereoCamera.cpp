@@ -0,0 +1,333 @@
+//
+//  A class for stereo camera rigs of two identical, parallel pinhole cameras
+//
+#include "StereoCamera.h"
+#include "Hexahedron.h"
+#include "PointCloud.h"
+#include "PointKernels.h"
+#include "Parallel.h"
+
+#include <cmath>
+#include <stdexcept>
+
+StereoCamera::StereoCamera(const QVector4D&  _origin,
+                           const QMatrix4x4& _rotation,
+                           float             _baseline,
+                           float             _focalLength,
+                           float             _imageWidth,
+                           float             _imageHeight):
+    origin(_origin), rotation(_rotation),
+    baseline(_baseline), focalLength(_focalLength),
+    imageWidth(_imageWidth), imageHeight(_imageHeight)
+{
+    type = SceneObjectType::ST_STEREO_CAMERA;
+}
+
+void StereoCamera::affineMap(const QMatrix4x4& M)
+{
+    QMatrix4x4 T = M; T.setColumn(3,E0);
+    origin       = M * origin;
+    rotation     = T * rotation;
+    for (int c = 0; c < 3; c++) rotation.setColumn(c, rotation.column(c).normalized());
+}
+
+void StereoCamera::setMisalignment(const QMatrix4x4& R)
+{
+    misalignment = R;
+    misalignment.setColumn(3, E0);
+    rectification = StereoRectification();
+    warp[LEFT]    = warp[RIGHT] = ImageWarp();
+}
+
+QMatrix4x4 StereoCamera::cameraRotation(Side side) const
+{
+    return (side == LEFT) ? rotation : rotation * misalignment;
+}
+
+QVector3D StereoCamera::center(Side side) const
+{
+    const float s = (side == LEFT) ? -0.5f : 0.5f;
+    return QVector3D(origin) + s * baseline * QVector3D(rotation.column(0));
+}
+
+QMatrix4x3 StereoCamera::projectionMatrix(Side side) const
+{
+    // K [R^T | -R^T c] with K = diag(f,f,1)
+    const QVector3D  c = center(side);
+    const QMatrix4x4 R = cameraRotation(side);
+    QMatrix4x3       P;
+    for (int r = 0; r < 3; r++) {
+        const QVector3D axis(R.column(r));
+        const float     k = (r < 2) ? focalLength : 1.0f;
+        for (int j = 0; j < 3; j++) P(r,j) = k * axis[j];
+        P(r,3) = -k * QVector3D::dotProduct(axis, c);
+    }
+    return P;
+}
+
+QMatrix4x4 StereoCamera::imagePlaneMatrix(Side side) const
+{
+    QMatrix4x4 M = cameraRotation(side);
+    M.setColumn(3, QVector4D(center(side), 1.0f));
+    return M;
+}
+
+bool StereoCamera::inImage(const QVector3D& p) const
+{
+    return p[2] > 0.0f && fabsf(p[0]) <= 0.5f * imageWidth && fabsf(p[1]) <= 0.5f * imageHeight;
+}
+
+void StereoCamera::project(const QVector4D* pts, qsizetype n, QVector3D* left, QVector3D* right) const
+{
+    const QMatrix4x3 P[2]   = { projectionMatrix(LEFT), projectionMatrix(RIGHT) };
+    QVector3D* const out[2] = { left, right };
+    projectPoints(pts, n, P, out, 2);
+}
+
+void StereoCamera::project(const QVector<QVector4D>& pts, QVector<QVector3D>& left, QVector<QVector3D>& right) const
+{
+    left .resize(pts.size());
+    right.resize(pts.size());
+    project(pts.constData(), pts.size(), left.data(), right.data());
+}
+
+void StereoCamera::triangulate(const QVector2D* left, const QVector2D* right, qsizetype n, QVector4D* out) const
+{
+    // ray directions R * (u, v, f)
+    QMatrix3x3 B[2];
+    for (Side side: {LEFT, RIGHT}) {
+        const QMatrix4x4 R = cameraRotation(side);
+        for (int r = 0; r < 3; r++) {
+            B[side](r,0) = R(r,0);
+            B[side](r,1) = R(r,1);
+            B[side](r,2) = R(r,2) * focalLength;
+        }
+    }
+    triangulateMidpoint(left, right, n, center(LEFT), B[LEFT], center(RIGHT), B[RIGHT], out);
+}
+
+QVector<QVector4D> StereoCamera::triangulate(const QVector<QVector2D>& left, const QVector<QVector2D>& right) const
+{
+    QVector<QVector4D> out(std::min(left.size(), right.size()));
+    triangulate(left.constData(), right.constData(), out.size(), out.data());
+    return out;
+}
+
+void StereoCamera::renderImages(const PointCloud& cloud, int width, int height, QImage& left, QImage& right) const
+{
+    QVector<QVector3D> uv[2];
+    project(cloud, uv[LEFT], uv[RIGHT]);
+
+    // texture voxels of 1/256 of the cloud's diagonal
+    const QVector3D o    = cloud.getMin();
+    const float     cell = std::max((cloud.getMax() - cloud.getMin()).length() / 256.0f, 1e-6f);
+    auto texture = [&](const QVector4D& p) {
+        quint32 h = 0;
+        for (int k = 0; k < 3; k++) h = (h ^ quint32(int(floorf((p[k] - o[k]) / cell)))) * 2654435761u;
+        return uchar(32 + (h >> 24) % 224);
+    };
+
+    QImage* img[2] = { &left, &right };
+    std::vector<float> depth(size_t(width) * height);
+    for (Side side: {LEFT, RIGHT}) {
+        *img[side] = QImage(width, height, QImage::Format_Grayscale8);
+        img[side]->fill(0);
+        std::fill(depth.begin(), depth.end(), INFINITY);
+
+        for (qsizetype i = 0; i < uv[side].size(); i++) {
+            const QVector3D& p = uv[side][i];
+            if (!inImage(p)) continue;
+            const QVector2D pixel = toPixel(p, width, height);
+            const int   px   = int(pixel[0]);
+            const int   py   = int(pixel[1]);
+            const uchar grey = texture(cloud[i]);
+
+            // 3x3 splat
+            for (int y = std::max(py - 1, 0); y <= std::min(py + 1, height - 1); y++)
+                for (int x = std::max(px - 1, 0); x <= std::min(px + 1, width - 1); x++)
+                    if (p[2] < depth[size_t(y) * width + x]) {
+                        depth[size_t(y) * width + x] = p[2];
+                        img[side]->scanLine(y)[x]   = grey;
+                    }
+        }
+    }
+}
+
+PointCloud* StereoCamera::reconstructDense(const QImage& left, const QImage& right, const StereoParams& params) const
+{
+    const DisparityMap disparity = computeDisparity(left, right, params);
+    const float        fx = focalLength * float(left.width())  / imageWidth;
+    const float        fy = focalLength * float(left.height()) / imageHeight;
+
+    PointCloud* cloud = disparityToPointCloud(disparity, fx, fy, 0.5f * float(left.width()), 0.5f * float(left.height()),
+                                              baseline, imagePlaneMatrix(LEFT));
+    cloud->setPointSize(1);
+    return cloud;
+}
+
+QVector2D StereoCamera::toPixel(const QVector3D& uv, int width, int height) const
+{
+    return QVector2D((uv[0] / imageWidth + 0.5f) * float(width), (0.5f - uv[1] / imageHeight) * float(height));
+}
+
+QVector2D StereoCamera::fromPixel(const QVector2D& px, int width, int height) const
+{
+    return QVector2D((px[0] / float(width) - 0.5f) * imageWidth, (0.5f - px[1] / float(height)) * imageHeight);
+}
+
+void StereoCamera::imageCorrespondences(const PointCloud& cloud, int width, int height, int maxCount,
+                                        QVector<QVector2D>& left, QVector<QVector2D>& right) const
+{
+    QVector<QVector3D> uv[2];
+    project(cloud, uv[LEFT], uv[RIGHT]);
+
+    left .clear();
+    right.clear();
+    const qsizetype step = std::max<qsizetype>(1, cloud.size() / std::max(maxCount, 1));
+    for (qsizetype i = 0; i < cloud.size() && left.size() < maxCount; i += step)
+        if (inImage(uv[LEFT][i]) && inImage(uv[RIGHT][i])) {
+            left .append(toPixel(uv[LEFT ][i], width, height));
+            right.append(toPixel(uv[RIGHT][i], width, height));
+        }
+}
+
+bool StereoCamera::calibrate(const QVector<QVector2D>& left, const QVector<QVector2D>& right,
+                             int width, int height, const FundamentalParams& params)
+{
+    QVector<int>     in;
+    const QMatrix3x3 F = estimateFundamental(left, right, params, &in);
+
+    QVector<QVector2D> a, b;
+    for (int i: in) { a.append(left[i]); b.append(right[i]); }
+    rectification = rectifyUncalibrated(F, a, b, width, height);
+    if (!rectification.isValid()) {
+        warp[LEFT] = warp[RIGHT] = ImageWarp();
+        return false;
+    }
+
+    warp[LEFT ] = ImageWarp(rectification.H1, width, height, width, height);
+    warp[RIGHT] = ImageWarp(rectification.H2, width, height, width, height);
+    return true;
+}
+
+PointCloud* StereoCamera::reconstructRectified(const QImage& left, const QImage& right, const StereoParams& params) const
+{
+    const int W = left.width(), H = left.height();
+    if (!isCalibrated() || W != rectification.width || H != rectification.height)
+        throw std::runtime_error("stereo rig not calibrated for this image size");
+
+    StereoParams p   = params;
+    p.minDisparity   = 0;
+    p.numDisparities = rectification.numDisparities;
+    const DisparityMap disparity = computeDisparity(warp[LEFT].apply(left), warp[RIGHT].apply(right), p);
+
+    // matches in the rectified images, row by row
+    QVector<QVector2D> px[2];
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++) {
+            const float d = disparity(x, y);
+            if (d < 0.0f) continue;
+            px[LEFT ].append(QVector2D(float(x) + 0.5f,     float(y) + 0.5f));
+            px[RIGHT].append(QVector2D(float(x) + 0.5f - d, float(y) + 0.5f));
+        }
+
+    // back into the original images and onto the image planes
+    const QMatrix3x3 Hinv[2] = { invertHomography(rectification.H1), invertHomography(rectification.H2) };
+    parallelFor(px[LEFT].size(), [&](unsigned, qsizetype b, qsizetype e) {
+        for (Side side: {LEFT, RIGHT}) {
+            QVector2D* q = px[side].data();
+            for (qsizetype i = b; i < e; i++) q[i] = fromPixel(mapHomography(Hinv[side], q[i]), W, H);
+        }
+    });
+
+    QVector<QVector4D> pts(px[LEFT].size());
+    triangulate(px[LEFT].constData(), px[RIGHT].constData(), pts.size(), pts.data());
+    pts.removeIf([](const QVector4D& p) { return p[3] == 0.0f; });
+
+    PointCloud* cloud = new PointCloud;
+    cloud->append(pts);
+    cloud->updateBounds();
+    cloud->setPointSize(1);
+    return cloud;
+}
+
+void StereoCamera::draw(const RenderCamera& renderer, const QColor& color, float lineWidth) const
+{
+    renderer.renderLine(center(LEFT), center(RIGHT), color, lineWidth);
+    for (Side side: {LEFT, RIGHT}) {
+        const QMatrix4x4 R = cameraRotation(side);
+        const QVector3D  x(R.column(0)), y(R.column(1)), z(R.column(2));
+        const QVector3D  w = 0.5f * imageWidth * x, h = 0.5f * imageHeight * y;
+        const QVector3D  c = center(side), p = c + focalLength * z;
+        const QVector3D corner[4] = { p-w-h, p+w-h, p+w+h, p-w+h };
+
+        renderer.renderPoint(c, color, 5.0f);
+        renderer.renderLine (c, c + 2.0f * focalLength * z, color, lineWidth);
+        for (int k = 0; k < 4; k++) {
+            renderer.renderLine(c, corner[k], color, lineWidth);
+            renderer.renderLine(corner[k], corner[(k+1)%4], color, lineWidth);
+        }
+        renderer.renderPlane(corner[0], corner[1], corner[2], corner[3], color, 0.1f);
+    }
+}
+
+void StereoCamera::drawProjections(const RenderCamera& renderer, const std::vector<SceneObject*>& scene) const
+{
+    QVector<QVector3D> uv[2];
+    QVector3D          bbMin, bbMax;
+
+    for (const SceneObject* obj: scene) {
+        switch (obj->getType()) {
+        case SceneObjectType::ST_POINT_CLOUD: {
+            const PointCloud& pc = *static_cast<const PointCloud*>(obj);
+            project(pc, uv[LEFT], uv[RIGHT]);
+
+            // visible projections as points on the image planes
+            for (Side side: {LEFT, RIGHT}) {
+                QVector<QVector4D> img;
+                for (const QVector3D& p: uv[side])
+                    if (inImage(p)) img.append(QVector4D(p[0], p[1], focalLength, 1.0f));
+                transformPoints(img.data(), img.size(), imagePlaneMatrix(side), bbMin, bbMax);
+                renderer.renderPCL(img, COLOR_POINT_CLOUD, 1.0f);
+            }
+            break;
+        }
+        case SceneObjectType::ST_HEXAHEDRON:
+        case SceneObjectType::ST_CUBE: {
+            const Hexahedron&  hex = *static_cast<const Hexahedron*>(obj);
+            QVector<QVector4D> corners;
+            for (const QVector3D& p: hex) corners.append(QVector4D(p, 1.0f));
+            project(corners, uv[LEFT], uv[RIGHT]);
+
+            // edges in front of the cameras on the image planes
+            for (Side side: {LEFT, RIGHT}) {
+                const QMatrix4x4 M = imagePlaneMatrix(side);
+                for (unsigned i = 0; i < 2*Hexahedron::edgeCount; i += 2) {
+                    const QVector3D& a = uv[side][Hexahedron::edgeList[i]];
+                    const QVector3D& b = uv[side][Hexahedron::edgeList[i+1]];
+                    if (a[2] <= 0.0f || b[2] <= 0.0f) continue;
+                    renderer.renderLine(M * QVector4D(a[0], a[1], focalLength, 1.0f),
+                                        M * QVector4D(b[0], b[1], focalLength, 1.0f),
+                                        COLOR_SCENE);
+                }
+            }
+
+            // reconstruction from the stereo projections
+            QVector<QVector2D> l, r;
+            for (qsizetype i = 0; i < corners.size(); i++) {
+                l.append(QVector2D(uv[LEFT ][i][0], uv[LEFT ][i][1]));
+                r.append(QVector2D(uv[RIGHT][i][0], uv[RIGHT][i][1]));
+            }
+            const QVector<QVector4D> rec = triangulate(l, r);
+            for (unsigned i = 0; i < 2*Hexahedron::edgeCount; i += 2) {
+                const QVector4D& a = rec[Hexahedron::edgeList[i]];
+                const QVector4D& b = rec[Hexahedron::edgeList[i+1]];
+                if (a[3] != 0.0f && b[3] != 0.0f) renderer.renderLine(a, b, COLOR_RECONSTRUCTION);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+//
+//  A class for stereo camera rigs of two identical, parallel pinhole cameras
+//
+//  The rig's frame is given by its origin (center of the baseline) and a rotation, whose
+//  columns are the baseline direction (x), the image up direction (y) and the viewing
+//  direction (z). The left/right camera sits at -/+ baseline/2 along x. Image coordinates
+//  are metric coordinates on the image plane at distance focalLength, centered on the
+//  view axis, i.e. (u,v) = focalLength * (x/z, y/z) in camera coordinates.
+//
+//  The right camera may be misaligned, i.e. rotated against the rig frame. Such a rig is
+//  calibrated from image correspondences (fundamental matrix and rectifying homographies),
+//  after which each new image pair is rectified by two cached lookup-table warps.
+//
+#pragma once
+
+#include <QGenericMatrix>
+#include <QImage>
+
+#include "SceneObject.h"
+#include "Axes.h"
+#include "StereoMatching.h"
+#include "StereoRectification.h"
+
+#include <vector>
+
+class StereoCamera : public SceneObject
+{
+private:
+    QVector4D  origin;                          // center of the baseline, homogeneous
+    QMatrix4x4 rotation;                        // columns: baseline, up and view direction
+    float      baseline;                        // distance of the camera centers
+    float      focalLength;                     // distance of the image planes to the centers
+    float      imageWidth, imageHeight;         // extent of the image planes
+    QMatrix4x4 misalignment;                    // rotation of the right camera within the rig frame
+
+    StereoRectification rectification;          // from calibrate, reset by setMisalignment
+    ImageWarp           warp[2];
+
+    QVector2D toPixel(const QVector3D& uv, int width, int height) const;
+    QVector2D fromPixel(const QVector2D& px, int width, int height) const;
+
+public:
+    enum Side { LEFT = 0, RIGHT = 1 };
+
+    StereoCamera(const QVector4D&  _origin      = E0-3*E3,
+                 const QMatrix4x4& _rotation    = QMatrix4x4(),
+                 float             _baseline    = 0.5f,
+                 float             _focalLength = 0.5f,
+                 float             _imageWidth  = 0.6f,
+                 float             _imageHeight = 0.4f);
+    virtual ~StereoCamera() override {}
+
+    virtual void affineMap(const QMatrix4x4  & matrix) override;
+    // draws centers, view axes, image planes and viewing frusta of both cameras
+    virtual void draw     (const RenderCamera& renderer,
+                           const QColor      & color     = COLOR_CAMERA,
+                           float               lineWidth = 1.0f        ) const override;
+
+    // camera geometry
+    void       setMisalignment (const QMatrix4x4& R);
+    const QMatrix4x4& getMisalignment() const { return misalignment; }
+    QMatrix4x4 cameraRotation  (Side side) const;       // columns: the camera's x, up and view direction
+    QVector3D  center          (Side side) const;
+    QMatrix4x3 projectionMatrix(Side side) const;       // world -> (u*w, v*w, w), w = depth
+    QMatrix4x4 imagePlaneMatrix(Side side) const;       // (u,v,focalLength,1) -> world point on the image plane
+    bool       inImage         (const QVector3D& uvDepth) const;
+
+    // Projects n points into both images in one batched pass; left/right receive (u,v,depth) per point.
+    void project(const QVector4D* pts, qsizetype n, QVector3D* left, QVector3D* right) const;
+    void project(const QVector<QVector4D>& pts, QVector<QVector3D>& left, QVector<QVector3D>& right) const;
+
+    // Reconstructs n points from their image coordinates in the left and right image (midpoint method).
+    // out[i] has w=0 for correspondences with (nearly) parallel rays, i.e. without disparity.
+    void triangulate(const QVector2D* left, const QVector2D* right, qsizetype n, QVector4D* out) const;
+    QVector<QVector4D> triangulate(const QVector<QVector2D>& left, const QVector<QVector2D>& right) const;
+
+    // Renders the cloud into a rectified pair of 8 bit grey images (z-buffered splats). The grey value of a
+    // point is a hash of the small voxel it lies in, i.e. a random surface texture seen alike by both cameras.
+    void renderImages(const PointCloud& cloud, int width, int height, QImage& left, QImage& right) const;
+
+    // Dense reconstruction from a rectified image pair of this rig (no misalignment), e.g. from renderImages
+    PointCloud* reconstructDense(const QImage&       left,
+                                 const QImage&       right,
+                                 const StereoParams& params = StereoParams()) const;
+
+    // Pixel correspondences of at most maxCount points of the cloud that project into both images of
+    // size width x height (pixel convention of StereoRectification.h), e.g. for calibrate.
+    void imageCorrespondences(const PointCloud&   cloud,
+                              int                 width,
+                              int                 height,
+                              int                 maxCount,
+                              QVector<QVector2D>& left,
+                              QVector<QVector2D>& right) const;
+
+    // Estimates the rig's epipolar geometry from pixel correspondences of width x height images and
+    // prepares the rectifying warps. Returns false, if the pair cannot be rectified.
+    bool calibrate(const QVector<QVector2D>& left,
+                   const QVector<QVector2D>& right,
+                   int                       width,
+                   int                       height,
+                   const FundamentalParams&  params = FundamentalParams());
+    bool isCalibrated() const { return rectification.isValid(); }
+
+    // Dense reconstruction from an unrectified image pair of the calibrated rig: both images are
+    // warped, matched over the calibrated disparity range and the matches triangulated in the original
+    // images. Throws runtime_error, if the rig is not calibrated for the images' size.
+    PointCloud* reconstructRectified(const QImage&       left,
+                                     const QImage&       right,
+                                     const StereoParams& params = StereoParams()) const;
+
+    // Projects the other scene objects (point clouds, hexahedra) onto both image planes and draws
+    // the projections there; the hexahedra are also reconstructed from their projections.
+    void drawProjections(const RenderCamera&              renderer,
+                         const std::vector<SceneObject*>& scene) const;
+};
@@ -0,0 +1,342 @@
+//
+//  Dense stereo matching of rectified image pairs
+//
+#include "StereoMatching.h"
+#include "Parallel.h"
+#include "PointKernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(POINTKERNELS_AVX2)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+using Cost = quint16;
+
+constexpr int  bandRows = 32;           // rows per cost band, bounds the integral image's size
+constexpr Cost maxCost  = 0xFFFF;
+
+#if defined(POINTKERNELS_AVX2)
+// the vectorized parts of blockCosts and pathStep below, each returns the number of disparities done
+
+AVX2_TARGET int accumulateCostsAVX2(uchar left, const uchar* rr, Cost* acc, const Cost* prev, Cost* cur, int D)
+{
+    const __m128i l = _mm_set1_epi8(char(left));
+    int d = 0;
+    for (; d + 16 <= D; d += 16) {
+        const __m128i rv = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rr + d));
+        const __m128i ad = _mm_or_si128(_mm_subs_epu8(l, rv), _mm_subs_epu8(rv, l));
+        const __m256i a  = _mm256_add_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + d)),
+                                            _mm256_cvtepu8_epi16(ad));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + d), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(cur + d),
+                            _mm256_add_epi16(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + d))));
+    }
+    return d;
+}
+
+AVX2_TARGET inline __m256i load16(const Cost* q)
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+}
+
+AVX2_TARGET int blockSumsAVX2(const Cost* a, const Cost* b, const Cost* e, const Cost* f, Cost* c, int D)
+{
+    int d = 0;
+    for (; d + 16 <= D; d += 16)
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + d),
+                            _mm256_add_epi16(_mm256_sub_epi16(load16(a + d), load16(b + d)),
+                                             _mm256_sub_epi16(load16(f + d), load16(e + d))));
+    return d;
+}
+
+// m receives min(cur) over the disparities done
+AVX2_TARGET int pathStepAVX2(const Cost* c, const Cost* prev, Cost* cur, Cost* s, int D,
+                             Cost minPrev, Cost P1, Cost jump, Cost& m)
+{
+    const __m256i vP1 = _mm256_set1_epi16(short(P1)), vJump = _mm256_set1_epi16(short(jump)), vMin = _mm256_set1_epi16(short(minPrev));
+    __m256i vm = _mm256_set1_epi16(short(maxCost));
+    int d = 0;
+    for (; d + 16 <= D; d += 16) {
+        const __m256i t = _mm256_min_epu16(_mm256_min_epu16(load16(prev + d), _mm256_adds_epu16(load16(prev + d - 1), vP1)),
+                                           _mm256_min_epu16(_mm256_adds_epu16(load16(prev + d + 1), vP1), vJump));
+        const __m256i l = _mm256_subs_epu16(_mm256_adds_epu16(load16(c + d), t), vMin);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(cur + d), l);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(s + d), _mm256_adds_epu16(load16(s + d), l));
+        vm = _mm256_min_epu16(vm, l);
+    }
+    const __m128i h = _mm_min_epu16(_mm256_castsi256_si128(vm), _mm256_extracti128_si256(vm, 1));
+    m = Cost(_mm_extract_epi16(_mm_minpos_epu16(h), 0));
+    return d;
+}
+#endif
+
+// Block costs of rows [y0,y1) into cost[((y-y0)*W + x)*D + d] for d = minD+k, k < D.
+// The integral images run over (row, column) with all D disparities per entry and use wrap-around
+// 16 bit arithmetic, which yields exact block sums as long as they are below 2^16.
+// Pixels without a full block get zero costs, disparities reaching beyond the right image maximal ones.
+void blockCosts(const QImage& L, const QImage& R, const StereoParams& p, int y0, int y1,
+                Cost* cost, vector<Cost>& integral, vector<Cost>& acc, vector<uchar>& rrev)
+{
+    const int W = L.width(), H = L.height(), D = p.numDisparities, minD = p.minDisparity, r = p.blockSize / 2;
+    const int ya   = y0 - r;                // image row of integral row 1
+    const int rows = (y1 - y0) + 2 * r;
+    const Cost full = Cost(p.blockSize * p.blockSize * 255);
+    const bool avx2 = hasAVX2();
+
+    integral.resize(size_t(rows + 1) * (W + 1) * D);
+    acc .resize(D);
+    rrev.assign(size_t(W) + minD + D, 0);
+    auto I = [&](int k, int x) { return integral.data() + (size_t(k) * (W + 1) + x) * D; };
+    memset(I(0, 0), 0, size_t(W + 1) * D * sizeof(Cost));
+
+    for (int k = 0; k < rows; ++k) {
+        const int y = ya + k;
+        if (y < 0 || y >= H) {
+            memcpy(I(k+1, 0), I(k, 0), size_t(W + 1) * D * sizeof(Cost));
+            continue;
+        }
+
+        // right row reversed, so R(x-d) for increasing d is contiguous: rrev[W-1-x+d]
+        const uchar* lrow = L.constScanLine(y);
+        const uchar* rrow = R.constScanLine(y);
+        for (int j = 0; j < W; ++j) rrev[j] = rrow[W - 1 - j];
+
+        fill(acc.begin(), acc.end(), Cost(0));
+        memset(I(k+1, 0), 0, size_t(D) * sizeof(Cost));
+        for (int x = 0; x < W; ++x) {
+            const uchar* rr   = rrev.data() + (W - 1 - x + minD);
+            const Cost*  prev = I(k, x + 1);
+            Cost*        cur  = I(k+1, x + 1);
+            int d = 0;
+#if defined(POINTKERNELS_AVX2)
+            if (avx2) d = accumulateCostsAVX2(lrow[x], rr, acc.data(), prev, cur, D);
+#endif
+            for (; d < D; ++d) {
+                acc[d] = Cost(acc[d] + abs(int(lrow[x]) - int(rr[d])));
+                cur[d] = Cost(prev[d] + acc[d]);
+            }
+        }
+    }
+
+    for (int y = y0; y < y1; ++y) {
+        Cost* out = cost + size_t(y - y0) * W * D;
+        if (y < r || y >= H - r) {
+            memset(out, 0, size_t(W) * D * sizeof(Cost));
+            continue;
+        }
+        const int k0 = y - y0, k1 = k0 + 2 * r + 1;
+        for (int x = 0; x < W; ++x) {
+            Cost* c = out + size_t(x) * D;
+            if (x < r || x >= W - r) {
+                memset(c, 0, size_t(D) * sizeof(Cost));
+                continue;
+            }
+            const Cost *a = I(k1, x + r + 1), *b = I(k0, x + r + 1), *e = I(k1, x - r), *f = I(k0, x - r);
+            int d = 0;
+#if defined(POINTKERNELS_AVX2)
+            if (avx2) d = blockSumsAVX2(a, b, e, f, c, D);
+#endif
+            for (; d < D; ++d) c[d] = Cost(a[d] - b[d] - e[d] + f[d]);
+
+            // blocks reaching beyond the right image's left border
+            for (int k = max(0, x - r - minD + 1); k < D; ++k) c[k] = full;
+        }
+    }
+}
+
+// one step of a SGM path: cur = c + min(prev, prev(d-+1)+P1, minPrev+P2) - minPrev, s += cur.
+// prev and cur have sentinels at [-1] and [D]. Returns min(cur).
+Cost pathStep(const Cost* c, const Cost* prev, Cost* cur, Cost* s, int D, Cost minPrev, Cost P1, Cost P2)
+{
+    const Cost jump = Cost(min<int>(maxCost, minPrev + P2));
+    Cost       m    = maxCost;
+    int        d    = 0;
+
+#if defined(POINTKERNELS_AVX2)
+    if (hasAVX2()) d = pathStepAVX2(c, prev, cur, s, D, minPrev, P1, jump, m);
+#endif
+
+    for (; d < D; ++d) {
+        const int t = min(min<int>(prev[d], prev[d-1] + P1), min<int>(prev[d+1] + P1, jump));
+        const int l = max(0, min<int>(maxCost, c[d] + t) - minPrev);
+        cur[d] = Cost(l);
+        s[d]   = Cost(min<int>(maxCost, s[d] + l));
+        m      = min(m, cur[d]);
+    }
+    return m;
+}
+
+// path buffer with sentinels, the first step of a path sees all zeros
+struct PathBuffer {
+    vector<Cost> data;
+    explicit PathBuffer(int D): data(D + 2, 0) { data.front() = data.back() = maxCost; }
+    Cost* get() { return data.data() + 1; }
+    void  reset() { fill(data.begin() + 1, data.end() - 1, Cost(0)); }
+};
+
+// best disparity of one pixel from its D costs, with uniqueness check and subpixel refinement
+float selectDisparity(const Cost* c, const StereoParams& p, int x)
+{
+    const int D = p.numDisparities;
+    int best = 0;
+    for (int d = 1; d < D; ++d) if (c[d] < c[best]) best = d;
+
+    // the block has to lie within the right image
+    if (p.minDisparity + best > x - p.blockSize / 2) return -1.0f;
+
+    if (p.uniqueness > 0)
+        for (int d = 0; d < D; ++d)
+            if (abs(d - best) > 1 && int(c[d]) * (100 - p.uniqueness) < int(c[best]) * 100) return -1.0f;
+
+    float sub = 0.0f;
+    if (best > 0 && best < D - 1) {
+        const int den = int(c[best-1]) - 2 * int(c[best]) + int(c[best+1]);
+        if (den > 0) sub = 0.5f * float(int(c[best-1]) - int(c[best+1])) / float(den);
+    }
+    return float(p.minDisparity + best) + sub;
+}
+
+void checkParams(const QImage& left, const QImage& right, const StereoParams& p)
+{
+    if (left.size() != right.size() || left.width() <= 0 || left.height() <= 0)
+        throw runtime_error("stereo images must be non-empty and of equal size");
+    if (p.numDisparities <= 0 || p.numDisparities % 16 != 0)
+        throw runtime_error("number of disparities must be a positive multiple of 16");
+    if (p.minDisparity < 0)
+        throw runtime_error("minimal disparity must not be negative");
+    if (p.blockSize < 1 || p.blockSize > 15 || p.blockSize % 2 == 0)
+        throw runtime_error("block size must be odd and at most 15");
+}
+
+} // namespace
+
+DisparityMap computeDisparity(const QImage& left, const QImage& right, const StereoParams& p)
+{
+    checkParams(left, right, p);
+
+    const QImage L = left .convertToFormat(QImage::Format_Grayscale8);
+    const QImage R = right.convertToFormat(QImage::Format_Grayscale8);
+    const int    W = L.width(), H = L.height(), D = p.numDisparities;
+
+    DisparityMap result;
+    result.width  = W;
+    result.height = H;
+    result.data.fill(-1.0f, qsizetype(W) * H);
+    float* out = result.data.data();
+
+    if (p.method == StereoMethod::SM_BLOCK_MATCHING) {
+        // cost band and winner-takes-all per band, bands in parallel
+        parallelFor(H, [&](unsigned, qsizetype b, qsizetype e) {
+            vector<Cost>  cost(size_t(bandRows) * W * D), integral, acc;
+            vector<uchar> rrev;
+            for (int y0 = int(b); y0 < int(e); y0 += bandRows) {
+                const int y1 = min(int(e), y0 + bandRows);
+                blockCosts(L, R, p, y0, y1, cost.data(), integral, acc, rrev);
+                for (int y = max(y0, p.blockSize / 2); y < min(y1, H - p.blockSize / 2); ++y)
+                    for (int x = p.blockSize / 2; x < W - p.blockSize / 2; ++x)
+                        out[size_t(y) * W + x] = selectDisparity(cost.data() + (size_t(y - y0) * W + x) * D, p, x);
+            }
+        }, bandRows);
+        return result;
+    }
+
+    // semi-global matching: full cost volume, then aggregation along the four axis-parallel paths
+    vector<Cost> C(size_t(W) * H * D), S(size_t(W) * H * D, 0);
+    parallelFor(H, [&](unsigned, qsizetype b, qsizetype e) {
+        vector<Cost>  integral, acc;
+        vector<uchar> rrev;
+        for (int y0 = int(b); y0 < int(e); y0 += bandRows)
+            blockCosts(L, R, p, y0, min(int(e), y0 + bandRows), C.data() + size_t(y0) * W * D, integral, acc, rrev);
+    }, bandRows);
+
+    const int  area = p.blockSize * p.blockSize;
+    const Cost P1   = Cost(min(int(maxCost), p.P1 * area));
+    const Cost P2   = Cost(min(int(maxCost), max(p.P2, p.P1 + 1) * area));
+
+    // horizontal paths, rows in parallel
+    parallelFor(H, [&](unsigned, qsizetype b, qsizetype e) {
+        PathBuffer a(D), c(D);
+        for (qsizetype y = b; y < e; ++y)
+            for (int dir: {1, -1}) {
+                a.reset();
+                Cost m = 0;
+                for (int i = 0; i < W; ++i) {
+                    const size_t o = (size_t(y) * W + (dir > 0 ? i : W - 1 - i)) * D;
+                    m = pathStep(C.data() + o, a.get(), c.get(), S.data() + o, D, m, P1, P2);
+                    swap(a, c);
+                }
+            }
+    }, 8);
+
+    // vertical paths, columns in parallel, row by row for contiguous memory access
+    parallelFor(W, [&](unsigned, qsizetype b, qsizetype e) {
+        const int          n = int(e - b);
+        vector<PathBuffer> prev(n, PathBuffer(D));
+        PathBuffer         cur(D);
+        vector<Cost>       m(n);
+        for (int dir: {1, -1}) {
+            for (auto& pb: prev) pb.reset();
+            fill(m.begin(), m.end(), Cost(0));
+            for (int i = 0; i < H; ++i) {
+                const size_t row = size_t(dir > 0 ? i : H - 1 - i) * W;
+                for (int j = 0; j < n; ++j) {
+                    const size_t o = (row + b + j) * D;
+                    m[j] = pathStep(C.data() + o, prev[j].get(), cur.get(), S.data() + o, D, m[j], P1, P2);
+                    swap(prev[j], cur);
+                }
+            }
+        }
+    }, 32);
+
+    // winner-takes-all on the aggregated costs
+    const int r = p.blockSize / 2;
+    parallelFor(H, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype y = max<qsizetype>(b, r); y < min<qsizetype>(e, H - r); ++y)
+            for (int x = r; x < W - r; ++x)
+                out[size_t(y) * W + x] = selectDisparity(S.data() + (size_t(y) * W + x) * D, p, x);
+    }, 8);
+
+    return result;
+}
+
+PointCloud* disparityToPointCloud(const DisparityMap& disparity,
+                                  float               fx,
+                                  float               fy,
+                                  float               cx,
+                                  float               cy,
+                                  float               baseline,
+                                  const QMatrix4x4&   cameraToWorld)
+{
+    const int W = disparity.width, H = disparity.height;
+
+    // points per row chunk, concatenated in row order
+    const unsigned              chunks = parallelChunks(H, 16);
+    vector<QVector<QVector4D>>  parts(chunks);
+    parallelFor(H, [&](unsigned c, qsizetype b, qsizetype e) {
+        for (qsizetype y = b; y < e; ++y)
+            for (int x = 0; x < W; ++x) {
+                const float d = disparity(x, int(y));
+                if (d <= 0.0f) continue;
+                const float Z = fx * baseline / d;
+                parts[c].append(QVector4D((float(x) + 0.5f - cx) * Z / fx,
+                                          (cy - float(y) - 0.5f) * Z / fy,
+                                          Z, 1.0f));
+            }
+    }, 16);
+
+    PointCloud* cloud = new PointCloud;
+    for (const auto& part: parts) cloud->append(part);
+
+    QVector3D bbMin, bbMax;
+    transformPoints(cloud->data(), cloud->size(), cameraToWorld, bbMin, bbMax);
+    cloud->updateBounds();
+    return cloud;
+}
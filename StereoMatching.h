@@ -0,0 +1,54 @@
+//
+//  Dense stereo matching of rectified image pairs
+//
+//  Matching costs are sums of absolute differences over square blocks, computed from
+//  integral images that run over all disparities of a pixel at once (SIMD over the
+//  disparity axis). Block matching picks the cheapest disparity per pixel directly,
+//  semi-global matching first aggregates the costs along four scanline directions.
+//  Rows (and columns for the vertical paths) are processed in parallel.
+//
+#pragma once
+
+#include <QImage>
+#include <QMatrix4x4>
+
+#include "PointCloud.h"
+
+enum class StereoMethod { SM_BLOCK_MATCHING,    // winner-takes-all on the block costs
+                          SM_SEMI_GLOBAL };     // semi-global matching over four paths
+
+struct StereoParams {
+    StereoMethod method         = StereoMethod::SM_SEMI_GLOBAL;
+    int          minDisparity   = 0;
+    int          numDisparities = 64;   // multiple of 16
+    int          blockSize      = 5;    // odd, at most 15
+    int          P1             = 8;    // SGM penalty for disparity changes by one, per pixel of the block
+    int          P2             = 32;   // SGM penalty for larger disparity changes, per pixel of the block
+    int          uniqueness     = 10;   // min. margin (percent) of the best over the second-best cost, 0 disables
+};
+
+// Disparities x_left - x_right per pixel of the left image, row by row; invalid pixels are negative.
+struct DisparityMap {
+    int            width  = 0;
+    int            height = 0;
+    QVector<float> data;
+
+    float operator()(int x, int y) const { return data[qsizetype(y) * width + x]; }
+};
+
+// Computes the disparity map of a rectified pair of equally sized images (converted to 8 bit grey).
+// Throws runtime_error for unsupported parameters or image sizes.
+DisparityMap computeDisparity(const QImage&       left,
+                              const QImage&       right,
+                              const StereoParams& params = StereoParams());
+
+// Reconstructs the valid disparities as points: pixel (x,y) with disparity d lies at depth
+// Z = fx*baseline/d in the left camera's frame (x right, y up, z viewing direction), which
+// cameraToWorld maps to world coordinates. (cx,cy) is the principal point in pixels.
+PointCloud* disparityToPointCloud(const DisparityMap& disparity,
+                                  float               fx,
+                                  float               fy,
+                                  float               cx,
+                                  float               cy,
+                                  float               baseline,
+                                  const QMatrix4x4&   cameraToWorld = QMatrix4x4());
@@ -0,0 +1,407 @@
+//
+//  Rectification of uncalibrated (misaligned) stereo image pairs
+//
+#include "StereoRectification.h"
+#include "Parallel.h"
+#include "PointKernels.h"
+
+#include <Eigen/Dense>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+using Mat3 = Eigen::Matrix3d;
+using Vec3 = Eigen::Vector3d;
+
+Mat3 toEigen(const QMatrix3x3& M)
+{
+    Mat3 E;
+    for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) E(r,c) = M(r,c);
+    return E;
+}
+
+QMatrix3x3 toQt(const Mat3& E)
+{
+    QMatrix3x3 M;
+    for (int r = 0; r < 3; ++r) for (int c = 0; c < 3; ++c) M(r,c) = float(E(r,c));
+    return M;
+}
+
+QMatrix3x3 zeroMatrix()
+{
+    QMatrix3x3 Z;
+    Z.fill(0.0f);
+    return Z;
+}
+
+Vec3 mapPoint(const Mat3& H, double x, double y)
+{
+    Vec3 p = H * Vec3(x, y, 1.0);
+    return p / p.z();
+}
+
+// Hartley normalization: centroid to the origin, mean distance sqrt(2)
+Mat3 normalization(const QVector<QVector2D>& p, const QVector<int>& idx)
+{
+    double cx = 0.0, cy = 0.0, d = 0.0;
+    for (int i: idx) { cx += p[i][0]; cy += p[i][1]; }
+    cx /= double(idx.size());
+    cy /= double(idx.size());
+    for (int i: idx) d += hypot(p[i][0] - cx, p[i][1] - cy);
+    const double s = (d > 0.0) ? sqrt(2.0) * double(idx.size()) / d : 1.0;
+
+    Mat3 T;
+    T << s, 0, -s*cx,
+         0, s, -s*cy,
+         0, 0, 1;
+    return T;
+}
+
+// rows x'^T F x = 0 of the linear system in the nine entries of F (row-major), normalized coordinates
+Eigen::MatrixXd epipolarSystem(const QVector<QVector2D>& a, const QVector<QVector2D>& b, const QVector<int>& idx,
+                               const Mat3& Ta, const Mat3& Tb)
+{
+    Eigen::MatrixXd A(idx.size(), 9);
+    for (qsizetype k = 0; k < idx.size(); ++k) {
+        const Vec3 x = Ta * Vec3(a[idx[k]][0], a[idx[k]][1], 1.0);
+        const Vec3 y = Tb * Vec3(b[idx[k]][0], b[idx[k]][1], 1.0);
+        A.row(k) << y.x()*x.x(), y.x()*x.y(), y.x(),
+                    y.y()*x.x(), y.y()*x.y(), y.y(),
+                          x.x(),       x.y(),   1.0;
+    }
+    return A;
+}
+
+Mat3 reshape(const Eigen::Matrix<double,9,1>& f)
+{
+    Mat3 F;
+    F << f(0), f(1), f(2),
+         f(3), f(4), f(5),
+         f(6), f(7), f(8);
+    return F;
+}
+
+// F = T_b^T F_n T_a, scaled to unit Frobenius norm
+Mat3 denormalize(const Mat3& Fn, const Mat3& Ta, const Mat3& Tb)
+{
+    Mat3 F = Tb.transpose() * Fn * Ta;
+    return F / F.norm();
+}
+
+// minimal solver: the up to three fundamental matrices through seven correspondences
+int sevenPoint(const QVector<QVector2D>& a, const QVector<QVector2D>& b, const QVector<int>& idx, Mat3 F[3])
+{
+    const Mat3 Ta = normalization(a, idx), Tb = normalization(b, idx);
+    Eigen::Matrix<double,9,9> A = Eigen::Matrix<double,9,9>::Zero();
+    A.topRows<7>() = epipolarSystem(a, b, idx, Ta, Tb);
+
+    // two-dimensional null space F1, F2; det(s*F1 + (1-s)*F2) = 0 is a cubic in s
+    Eigen::JacobiSVD<Eigen::Matrix<double,9,9>> svd(A, Eigen::ComputeFullV);
+    if (svd.singularValues()(6) < 1e-10 * svd.singularValues()(0)) return 0;      // degenerate sample
+    const Mat3 F1 = reshape(svd.matrixV().col(8)), F2 = reshape(svd.matrixV().col(7));
+
+    // coefficients from the values at s = 0, 1, -1, 2
+    auto det = [&](double s) { return (s * F1 + (1.0 - s) * F2).determinant(); };
+    const double p0 = det(0.0), p1 = det(1.0), pm = det(-1.0), p2 = det(2.0);
+    const double c0 = p0, c2 = 0.5 * (p1 + pm) - p0, odd = 0.5 * (p1 - pm);
+    const double c3 = (p2 - 4.0 * c2 - c0 - 2.0 * odd) / 6.0, c1 = odd - c3;
+
+    double roots[3];
+    int    count = 0;
+    if (fabs(c3) < 1e-12 * (fabs(c0) + fabs(c1) + fabs(c2))) {
+        // (nearly) quadratic
+        if (fabs(c2) < 1e-300) return 0;
+        const double disc = c1*c1 - 4.0*c2*c0;
+        if (disc < 0.0) return 0;
+        roots[count++] = (-c1 + sqrt(disc)) / (2.0 * c2);
+        roots[count++] = (-c1 - sqrt(disc)) / (2.0 * c2);
+    } else {
+        // real eigenvalues of the companion matrix
+        Mat3 C;
+        C << -c2/c3, -c1/c3, -c0/c3,
+                1.0,    0.0,    0.0,
+                0.0,    1.0,    0.0;
+        Eigen::EigenSolver<Mat3> es(C, false);
+        for (int k = 0; k < 3; ++k)
+            if (fabs(es.eigenvalues()(k).imag()) <= 1e-8 * max(1.0, fabs(es.eigenvalues()(k).real())))
+                roots[count++] = es.eigenvalues()(k).real();
+    }
+
+    for (int k = 0; k < count; ++k) F[k] = denormalize(roots[k] * F1 + (1.0 - roots[k]) * F2, Ta, Tb);
+    return count;
+}
+
+// least-squares fundamental matrix of the correspondences idx with enforced rank 2
+Mat3 eightPoint(const QVector<QVector2D>& a, const QVector<QVector2D>& b, const QVector<int>& idx)
+{
+    const Mat3                  Ta = normalization(a, idx), Tb = normalization(b, idx);
+    const Eigen::MatrixXd       A  = epipolarSystem(a, b, idx, Ta, Tb);
+    Eigen::Matrix<double,9,9>   AtA = A.transpose() * A;
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double,9,9>> solver(AtA);
+    Mat3 Fn = reshape(solver.eigenvectors().col(0));
+
+    Eigen::JacobiSVD<Mat3> svd(Fn, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Vec3 s = svd.singularValues();
+    s(2)   = 0.0;
+    Fn     = svd.matrixU() * s.asDiagonal() * svd.matrixV().transpose();
+    return denormalize(Fn, Ta, Tb);
+}
+
+QVector<int> collectInliers(const QVector<QVector2D>& a, const QVector<QVector2D>& b, const QMatrix3x3& F, float threshold)
+{
+    vector<float> err(a.size());
+    sampsonInliers(a.constData(), b.constData(), a.size(), F, threshold, err.data());
+
+    QVector<int> idx;
+    for (qsizetype i = 0; i < a.size(); ++i)
+        if (err[i] <= threshold * threshold) idx.append(int(i));
+    return idx;
+}
+
+} // namespace
+
+QMatrix3x3 estimateFundamental(const QVector<QVector2D>& a,
+                               const QVector<QVector2D>& b,
+                               const FundamentalParams&  params,
+                               QVector<int>*             inliers)
+{
+    const qsizetype n = min(a.size(), b.size());
+    if (inliers) inliers->clear();
+    if (n < 8) return zeroMatrix();
+
+    mt19937                             rng(4711);
+    uniform_int_distribution<qsizetype> pick(0, n - 1);
+    const int                           batch = int(workerCount()) * 4;
+
+    QMatrix3x3 best;
+    qsizetype  bestCount = 0;
+    int        needed    = params.maxIterations;
+
+    vector<QVector<int>> samples(batch);
+    vector<QMatrix3x3>   hypotheses(3 * size_t(batch));
+    vector<qsizetype>    counts    (3 * size_t(batch));
+
+    for (int done = 0; done < needed; done += batch) {
+        // draw the samples sequentially (deterministic), solve and score them in parallel
+        for (auto& s: samples) {
+            s.clear();
+            while (s.size() < 7) {
+                const int i = int(pick(rng));
+                if (!s.contains(i)) s.append(i);
+            }
+        }
+
+        parallelFor(batch, [&](unsigned, qsizetype bb, qsizetype e) {
+            Mat3 F[3];
+            for (qsizetype s = bb; s < e; ++s) {
+                const int m = sevenPoint(a, b, samples[s], F);
+                for (int k = 0; k < 3; ++k) {
+                    counts[3*s+k] = 0;
+                    if (k >= m) continue;
+                    hypotheses[3*s+k] = toQt(F[k]);
+                    counts    [3*s+k] = sampsonInliers(a.constData(), b.constData(), n, hypotheses[3*s+k], params.threshold);
+                }
+            }
+        }, 1);
+
+        for (size_t h = 0; h < counts.size(); ++h)
+            if (counts[h] > bestCount) { bestCount = counts[h]; best = hypotheses[h]; }
+
+        // adaptive number of iterations: log(1-p) / log(1-w^7) with inlier ratio w
+        const double w = double(bestCount) / double(n);
+        const double q = 1.0 - pow(w, 7.0);
+        if (q <= 0.0) break;
+        if (q < 1.0)  needed = int(min<double>(params.maxIterations, ceil(log(1.0 - params.confidence) / log(q))));
+    }
+
+    if (bestCount < 8) return zeroMatrix();
+
+    // refine by 8-point fits to the inliers while the support grows
+    QVector<int> in = collectInliers(a, b, best, params.threshold);
+    for (int it = 0; it < 3; ++it) {
+        const QMatrix3x3   F    = toQt(eightPoint(a, b, in));
+        const QVector<int> next = collectInliers(a, b, F, params.threshold);
+        if (next.size() < in.size()) break;
+        best = F;
+        if (next == in) break;
+        in = next;
+    }
+
+    if (inliers) *inliers = collectInliers(a, b, best, params.threshold);
+    return best;
+}
+
+StereoRectification rectifyUncalibrated(const QMatrix3x3&         Fq,
+                                        const QVector<QVector2D>& a,
+                                        const QVector<QVector2D>& b,
+                                        int                       width,
+                                        int                       height)
+{
+    StereoRectification result;
+    const qsizetype     n = min(a.size(), b.size());
+    if (n == 0 || width <= 0 || height <= 0) return result;
+
+    const Mat3 F = toEigen(Fq);
+
+    // epipole of the right image: e^T F = 0
+    Eigen::JacobiSVD<Mat3> svd(F, Eigen::ComputeFullU);
+    const Vec3 e = svd.matrixU().col(2);
+
+    // H2 = G R T: image center to the origin, epipole onto the x axis (smallest rotation), then to infinity
+    Mat3 T;
+    T << 1, 0, -0.5*width,
+         0, 1, -0.5*height,
+         0, 0, 1;
+    const Vec3   et    = T * e;
+    const double angle = (et.x() == 0.0) ? M_PI / 2.0 : atan(et.y() / et.x());
+    Mat3 R;
+    R << cos(angle), sin(angle), 0,
+        -sin(angle), cos(angle), 0,
+                  0,          0, 1;
+    const Vec3   er       = R * et;
+    const double halfDiag = 0.5 * hypot(double(width), double(height));
+    if (!(fabs(er.z()) * halfDiag < fabs(er.x()))) return result;                   // epipole inside the image
+    Mat3 G = Mat3::Identity();
+    G(2,0) = -er.z() / er.x();
+    const Mat3 H2 = G * R * T;
+
+    // matching homography H2 M with F = [e]x M, sheared by H_A = [a b c; 0 1 0; 0 0 1] to fit the correspondences
+    Mat3 ex;
+    ex <<      0, -e.z(),  e.y(),
+           e.z(),      0, -e.x(),
+          -e.y(),  e.x(),      0;
+    const Mat3 H0 = H2 * (ex * F + e * Vec3(1, 1, 1).transpose());
+
+    Eigen::MatrixXd A(n, 3);
+    Eigen::VectorXd rhs(n);
+    for (qsizetype i = 0; i < n; ++i) {
+        const Vec3 p = mapPoint(H0, a[i][0], a[i][1]), q = mapPoint(H2, b[i][0], b[i][1]);
+        A.row(i) << p.x(), p.y(), 1.0;
+        rhs(i)   =  q.x();
+    }
+    const Vec3 abc = A.colPivHouseholderQr().solve(rhs);
+    Mat3 HA = Mat3::Identity();
+    HA.row(0) = abc.transpose();
+    const Mat3 H1 = HA * H0;
+
+    // common scale and vertical offset, such that both rectified images fit into width x height
+    double x0[2] = { INFINITY, INFINITY }, x1[2] = { -INFINITY, -INFINITY }, y0 = INFINITY, y1 = -INFINITY;
+    const Mat3* H[2] = { &H1, &H2 };
+    for (int k = 0; k < 2; ++k) {
+        int sign = 0;
+        for (const Eigen::Vector2d& c: { Eigen::Vector2d(0, 0), Eigen::Vector2d(width, 0),
+                                         Eigen::Vector2d(width, height), Eigen::Vector2d(0, height) }) {
+            // an image crossing the line at infinity cannot be rectified
+            const double w = H[k]->row(2).dot(Vec3(c.x(), c.y(), 1.0));
+            if (sign * w < 0.0) return result;
+            sign = (w < 0.0) ? -1 : 1;
+
+            const Vec3 p = mapPoint(*H[k], c.x(), c.y());
+            x0[k] = min(x0[k], p.x()); x1[k] = max(x1[k], p.x());
+            y0    = min(y0,    p.y()); y1    = max(y1,    p.y());
+        }
+    }
+    const double s = min(double(width) / max(x1[0] - x0[0], x1[1] - x0[1]), double(height) / (y1 - y0));
+    if (!(s > 0.0) || !isfinite(s)) return result;
+
+    Mat3 S[2];
+    for (int k = 0; k < 2; ++k) {
+        S[k] << s, 0, 0.5 * (width  - s * (x0[k] + x1[k])),
+                0, s, 0.5 * (height - s * (y0 + y1)),
+                0, 0, 1;
+    }
+
+    // shift the right image, such that the disparities start at margin; the range leaves out the
+    // extreme 0.5% on either side, which are mostly wrong correspondences close to their epipolar line
+    const double   margin = 2.0;
+    vector<double> d(n);
+    for (qsizetype i = 0; i < n; ++i)
+        d[i] = mapPoint(S[0] * H1, a[i][0], a[i][1]).x() - mapPoint(S[1] * H2, b[i][0], b[i][1]).x();
+    const size_t cut = size_t(n) / 200;
+    nth_element(d.begin(), d.begin() + cut,         d.end());
+    const double dMin = d[cut];
+    nth_element(d.begin(), d.end() - 1 - cut,       d.end());
+    const double dMax = d[n - 1 - cut];
+    S[1](0,2) += dMin - margin;
+
+    result.H1             = toQt(S[0] * H1);
+    result.H2             = toQt(S[1] * H2);
+    result.width          = width;
+    result.height         = height;
+    result.numDisparities = min(16 * int(ceil((dMax - dMin + 2.0 * margin) / 16.0)), 16 * ((width + 15) / 16));
+    return result;
+}
+
+QVector2D mapHomography(const QMatrix3x3& H, const QVector2D& p)
+{
+    const float w = H(2,0) * p[0] + H(2,1) * p[1] + H(2,2);
+    return QVector2D((H(0,0) * p[0] + H(0,1) * p[1] + H(0,2)) / w,
+                     (H(1,0) * p[0] + H(1,1) * p[1] + H(1,2)) / w);
+}
+
+QMatrix3x3 invertHomography(const QMatrix3x3& H)
+{
+    return toQt(toEigen(H).inverse());
+}
+
+ImageWarp::ImageWarp(const QMatrix3x3& H, int _sourceWidth, int _sourceHeight, int _targetWidth, int _targetHeight):
+    sourceWidth(_sourceWidth), sourceHeight(_sourceHeight), targetWidth(_targetWidth), targetHeight(_targetHeight)
+{
+    if (sourceWidth > 32767 || sourceHeight > 32767) throw runtime_error("image too large for the warp's lookup table");
+
+    const Mat3 Hinv = toEigen(H).inverse();
+    lut.resize(qsizetype(targetWidth) * targetHeight);
+    Entry* table = lut.data();
+
+    parallelFor(targetHeight, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype y = b; y < e; ++y)
+            for (int x = 0; x < targetWidth; ++x) {
+                // source position of the pixel center, relative to the source pixel centers
+                const Vec3   p  = Hinv * Vec3(x + 0.5, y + 0.5, 1.0);
+                const double sx = p.x() / p.z() - 0.5, sy = p.y() / p.z() - 0.5;
+                Entry&       t  = table[y * targetWidth + x];
+                if (!(sx >= 0.0 && sy >= 0.0 && sx < sourceWidth - 1 && sy < sourceHeight - 1)) {
+                    t = { -1, -1, 0, 0 };
+                    continue;
+                }
+                const int ix = int(sx), iy = int(sy);
+                t = { qint16(ix), qint16(iy),
+                      quint8(min(255, int((sx - ix) * 256.0 + 0.5))), quint8(min(255, int((sy - iy) * 256.0 + 0.5))) };
+            }
+    }, 16);
+}
+
+QImage ImageWarp::apply(const QImage& source) const
+{
+    if (source.width() != sourceWidth || source.height() != sourceHeight)
+        throw runtime_error("image size does not match the warp");
+
+    const QImage src = source.convertToFormat(QImage::Format_Grayscale8);
+    QImage       dst(targetWidth, targetHeight, QImage::Format_Grayscale8);
+    const qsizetype bpl = src.bytesPerLine(), dbpl = dst.bytesPerLine();
+    const uchar*    s   = src.constBits();
+    uchar*          d   = dst.bits();
+
+    parallelFor(targetHeight, [&](unsigned, qsizetype b, qsizetype e) {
+        for (qsizetype y = b; y < e; ++y) {
+            const Entry* t   = lut.constData() + y * targetWidth;
+            uchar*       out = d + y * dbpl;
+            for (int x = 0; x < targetWidth; ++x) {
+                if (t[x].x < 0) { out[x] = 0; continue; }
+                const uchar* p   = s + t[x].y * bpl + t[x].x;
+                const int    fx  = t[x].fx, fy = t[x].fy;
+                const int    top = p[0]   * (256 - fx) + p[1]       * fx;
+                const int    bot = p[bpl] * (256 - fx) + p[bpl + 1] * fx;
+                out[x] = uchar((top * (256 - fy) + bot * fy + (1 << 15)) >> 16);
+            }
+        }
+    }, 16);
+    return dst;
+}
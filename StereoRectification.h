@@ -0,0 +1,84 @@
+//
+//  Rectification of uncalibrated (misaligned) stereo image pairs
+//
+//  The fundamental matrix is estimated robustly from point correspondences: RANSAC over
+//  minimal 7-point samples, whose hypotheses are scored in parallel batches by the SIMD
+//  Sampson error kernel, followed by an 8-point least-squares fit to all inliers. From F,
+//  Hartley's method yields a pair of homographies that map epipolar lines to common image
+//  rows, so the pair can be matched by computeDisparity. Remapping goes through ImageWarp,
+//  a precomputed lookup table, such that further frames of the same rig cost one pass.
+//
+//  Pixel coordinates run from (0,0) at the top left image corner to (width,height), i.e.
+//  the center of pixel (x,y) is (x+0.5, y+0.5).
+//
+#pragma once
+
+#include <QGenericMatrix>
+#include <QImage>
+#include <QVector2D>
+#include <QVector>
+
+struct FundamentalParams {
+    float  threshold     = 1.0f;    // max. Sampson distance of inliers, in pixels
+    double confidence    = 0.99;    // probability of drawing at least one outlier-free sample
+    int    maxIterations = 2000;    // upper bound for the number of samples
+};
+
+// Estimates F with b^T F a = 0 for the pixel correspondences (a[i],b[i]) of the left and right
+// image. Returns a zero matrix, if there are fewer than eight correspondences or no sample gives
+// a valid hypothesis. inliers (optional) receives the indices of the correspondences supporting F.
+QMatrix3x3 estimateFundamental(const QVector<QVector2D>& a,
+                               const QVector<QVector2D>& b,
+                               const FundamentalParams&  params  = FundamentalParams(),
+                               QVector<int>*             inliers = nullptr);
+
+// Homographies from pixels of the original to pixels of the rectified left/right image. Both
+// rectified images have the original size, corresponding points lie in the same row and their
+// disparity x_left - x_right falls into [0, numDisparities).
+struct StereoRectification {
+    QMatrix3x3 H1, H2;
+    int        width          = 0;
+    int        height         = 0;
+    int        numDisparities = 0;      // multiple of 16, 0 for an invalid rectification
+
+    bool isValid() const { return numDisparities > 0; }
+};
+
+// Hartley's rectification for the fundamental matrix F of images of size width x height.
+// The correspondences (preferably F's inliers) fit the shearing of the left image and give the
+// disparity range. Returns an invalid rectification for epipoles inside the image.
+StereoRectification rectifyUncalibrated(const QMatrix3x3&         F,
+                                        const QVector<QVector2D>& a,
+                                        const QVector<QVector2D>& b,
+                                        int                       width,
+                                        int                       height);
+
+// Maps pixel coordinates p by the homography H (with perspective divide).
+QVector2D  mapHomography   (const QMatrix3x3& H, const QVector2D& p);
+QMatrix3x3 invertHomography(const QMatrix3x3& H);
+
+// Bilinear remapping of 8 bit grey images by a fixed homography. The lookup table stores the
+// source pixel and the interpolation weights of every target pixel, so apply is a single pass.
+class ImageWarp
+{
+private:
+    struct Entry {
+        qint16 x, y;                    // top left source pixel, x<0 for targets outside the source
+        quint8 fx, fy;                  // weights of the right/lower neighbours in 1/256
+    };
+
+    int            sourceWidth  = 0, sourceHeight = 0;
+    int            targetWidth  = 0, targetHeight = 0;
+    QVector<Entry> lut;
+
+public:
+    ImageWarp() {}
+    // target(p) = source(H^-1 p), i.e. H maps source to target pixel coordinates
+    ImageWarp(const QMatrix3x3& H, int _sourceWidth, int _sourceHeight, int _targetWidth, int _targetHeight);
+
+    bool isEmpty() const { return lut.isEmpty(); }
+
+    // Warps src (converted to 8 bit grey, of the source size) into a new image; target pixels
+    // without source are black. Throws runtime_error for a source of another size.
+    QImage apply(const QImage& src) const;
+};
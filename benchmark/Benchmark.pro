@@ -0,0 +1,73 @@
+# ----------------------------------------------------
+# Benchmarks of the framework's point cloud paths,
+# see main.cpp for usage. Build in release mode.
+# ------------------------------------------------------
+
+TEMPLATE = app
+TARGET = Benchmark
+QT += core gui opengl
+CONFIG += console release c++20
+CONFIG -= app_bundle
+INCLUDEPATH += . \
+    .. \
+    ../external/eigen-3.4.0
+LIBS += -lopengl32 -lglu32   # on Linux and Mac use "LIBS += -lglut" instead
+DEPENDPATH += . ..
+
+HEADERS += Datasets.h \
+    Harness.h \
+    ../GLConvenience.h \
+    ../QtConvenience.h \
+    ../Axes.h \
+    ../BVH.h \
+    ../CameraPath.h \
+    ../Cube.h \
+    ../Hexahedron.h \
+    ../ImageSequenceWriter.h \
+    ../InstancedBoxes.h \
+    ../KdTree.h \
+    ../MemoryTracker.h \
+    ../OctTree.h \
+    ../OffscreenRenderer.h \
+    ../Parallel.h \
+    ../PerspectiveCamera.h \
+    ../PLYWriter.h \
+    ../Plane.h \
+    ../PointCloud.h \
+    ../PointKernels.h \
+    ../Profiler.h \
+    ../RenderCamera.h \
+    ../SceneManager.h \
+    ../SceneObject.h \
+    ../StereoCamera.h \
+    ../StereoMatching.h \
+    ../StereoRectification.h
+
+SOURCES += main.cpp \
+    Datasets.cpp \
+    Harness.cpp \
+    ../GLConvenience.cpp \
+    ../QtConvenience.cpp \
+    ../Axes.cpp \
+    ../BVH.cpp \
+    ../CameraPath.cpp \
+    ../Cube.cpp \
+    ../Hexahedron.cpp \
+    ../ImageSequenceWriter.cpp \
+    ../InstancedBoxes.cpp \
+    ../KdTree.cpp \
+    ../MemoryTracker.cpp \
+    ../OctTree.cpp \
+    ../OffscreenRenderer.cpp \
+    ../PerspectiveCamera.cpp \
+    ../PLYWriter.cpp \
+    ../Plane.cpp \
+    ../PointCloud.cpp \
+    ../PointKernels.cpp \
+    ../Profiler.cpp \
+    ../RenderCamera.cpp \
+    ../SceneManager.cpp \
+    ../SceneObject.cpp \
+    ../StereoCamera.cpp \
+    ../StereoMatching.cpp \
+    ../StereoRectification.cpp
@@ -0,0 +1,150 @@
+//
+//  Synthetic point clouds for the benchmarks
+//
+#include "Datasets.h"
+#include "Parallel.h"
+
+#include <QFile>
+
+#include <array>
+#include <cmath>
+#include <random>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+constexpr float PI = 3.14159265358979f;
+
+// every chunk gets its own generator, the result does not depend on the number of threads
+constexpr qsizetype CHUNK = 1 << 16;
+
+template <class F>
+QVector<QVector4D> generate(qsizetype n, quint32 seed, F&& point)
+{
+    QVector<QVector4D> pts(n);
+    const qsizetype chunks = (n + CHUNK - 1) / CHUNK;
+    parallelFor(chunks, [&](unsigned, qsizetype cb, qsizetype ce) {
+        for (qsizetype c = cb; c < ce; c++) {
+            mt19937 rng(seed ^ quint32(c * 2654435761u));
+            for (qsizetype i = c * CHUNK; i < std::min(n, (c+1) * CHUNK); i++) pts[i] = point(rng, i);
+        }
+    }, 1);
+    return pts;
+}
+
+QVector<QVector4D> uniform(qsizetype n, quint32 seed)
+{
+    return generate(n, seed, [](mt19937& rng, qsizetype) {
+        uniform_real_distribution<float> u(-5.0f, 5.0f);
+        return QVector4D(u(rng), u(rng), u(rng), 1.0f);
+    });
+}
+
+QVector<QVector4D> clustered(qsizetype n, quint32 seed)
+{
+    // 64 clusters of varying size and weight
+    struct Cluster { QVector3D center; float sigma; };
+    array<Cluster, 64> clusters;
+    mt19937 rng(seed);
+    uniform_real_distribution<float> u(-4.0f, 4.0f), s(0.02f, 0.5f);
+    for (Cluster& c: clusters) c = { QVector3D(u(rng), u(rng), u(rng)), s(rng) };
+
+    return generate(n, seed + 1, [&clusters](mt19937& rng, qsizetype) {
+        // squaring skews the choice towards the first clusters
+        uniform_real_distribution<float> pick(0.0f, 1.0f);
+        normal_distribution<float>       g(0.0f, 1.0f);
+        const float    x = pick(rng);
+        const Cluster& c = clusters[std::min<size_t>(size_t(x * x * clusters.size()), clusters.size() - 1)];
+        return QVector4D(c.center + c.sigma * QVector3D(g(rng), g(rng), g(rng)), 1.0f);
+    });
+}
+
+QVector<QVector4D> planarScan(qsizetype n, quint32 seed)
+{
+    // line scanner at the origin of the room [-4,6] x [-1.5,1.5] x [-3,5], the scan lines are
+    // vertical fans rotating about the y-axis, range noise of 5mm
+    const qsizetype perLine = std::max<qsizetype>(1, qsizetype(std::sqrt(double(n) / 4.0)));
+    const qsizetype lines   = (n + perLine - 1) / perLine;
+    const QVector3D lo(-4.0f, -1.5f, -3.0f), hi(6.0f, 1.5f, 5.0f);
+
+    return generate(n, seed, [=](mt19937& rng, qsizetype i) {
+        normal_distribution<float> noise(0.0f, 0.005f);
+        const float azimuth   = 2.0f * PI * float(i / perLine) / float(lines);
+        const float elevation = PI * (float(i % perLine) / float(perLine) - 0.5f) * 0.9f;
+        const QVector3D dir(std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth));
+
+        // distance to the first wall hit from inside the room
+        float t = 1e30f;
+        for (int k = 0; k < 3; k++) {
+            if      (dir[k] > 1e-6f)  t = std::min(t, hi[k] / dir[k]);
+            else if (dir[k] < -1e-6f) t = std::min(t, lo[k] / dir[k]);
+        }
+        return QVector4D((t + noise(rng)) * dir, 1.0f);
+    });
+}
+}
+
+QString distributionName(Distribution d)
+{
+    switch (d) {
+    case Distribution::DS_UNIFORM:     return "uniform";
+    case Distribution::DS_CLUSTERED:   return "clustered";
+    case Distribution::DS_PLANAR_SCAN: return "planar";
+    }
+    return QString();
+}
+
+Distribution parseDistribution(const QString& name)
+{
+    for (Distribution d: {Distribution::DS_UNIFORM, Distribution::DS_CLUSTERED, Distribution::DS_PLANAR_SCAN})
+        if (name == distributionName(d)) return d;
+    throw runtime_error("unknown distribution " + name.toStdString());
+}
+
+QVector<QVector4D> generatePoints(Distribution d, qsizetype n, quint32 seed)
+{
+    switch (d) {
+    case Distribution::DS_CLUSTERED:   return clustered (n, seed);
+    case Distribution::DS_PLANAR_SCAN: return planarScan(n, seed);
+    default:                           return uniform   (n, seed);
+    }
+}
+
+void writePLY(const QString& filePath, const QVector<QVector4D>& points)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        throw runtime_error("cannot write " + filePath.toStdString());
+
+    QByteArray header = "ply\nformat ascii 1.0\nelement vertex " + QByteArray::number(points.size()) +
+                        "\nproperty float x\nproperty float y\nproperty float z\nend_header\n";
+    file.write(header);
+
+    // formatted in blocks, a single QByteArray for 100M points would be several GB
+    char line[64];
+    QByteArray block;
+    for (qsizetype i = 0; i < points.size(); i++) {
+        const int len = snprintf(line, sizeof(line), "%.6g %.6g %.6g\n", points[i].x(), points[i].y(), points[i].z());
+        block.append(line, len);
+        if (block.size() > (1 << 22) || i + 1 == points.size()) {
+            if (file.write(block) != block.size()) throw runtime_error("cannot write " + filePath.toStdString());
+            block.clear();
+        }
+    }
+}
+
+qsizetype parseCount(const QString& text)
+{
+    QString t      = text.trimmed();
+    double  factor = 1.0;
+    if      (t.endsWith('k') || t.endsWith('K')) factor = 1e3;
+    else if (t.endsWith('m') || t.endsWith('M')) factor = 1e6;
+    else if (t.endsWith('g') || t.endsWith('G')) factor = 1e9;
+    if (factor > 1.0) t.chop(1);
+
+    bool         ok    = false;
+    const double value = t.toDouble(&ok);
+    if (!ok || value <= 0.0) throw runtime_error("invalid point count " + text.toStdString());
+    return qsizetype(value * factor + 0.5);
+}
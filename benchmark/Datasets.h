@@ -0,0 +1,30 @@
+//
+//  Synthetic point clouds for the benchmarks
+//
+//  Three distributions cover the typical inputs of the framework: points uniformly filling
+//  a cube (worst case for spatial subdivision), Gaussian clusters (strongly varying density)
+//  and a planar scan, i.e. the returns of a rotating line scanner inside a box-shaped room
+//  with range noise (surfaces, scan line structure). All generators are deterministic for a
+//  given seed and run in parallel, so even 100M points are generated in seconds.
+//
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QVector4D>
+
+enum class Distribution {DS_UNIFORM, DS_CLUSTERED, DS_PLANAR_SCAN};
+
+QString distributionName(Distribution d);
+
+// Parses "uniform", "clustered" or "planar", throws runtime_error for other names.
+Distribution parseDistribution(const QString& name);
+
+// n homogeneous points (w=1) of the distribution, roughly within [-5,5]^3
+QVector<QVector4D> generatePoints(Distribution d, qsizetype n, quint32 seed = 4711);
+
+// Writes the points as ASCII PLY, as read by PointCloud::loadPLY. Throws runtime_error on failure.
+void writePLY(const QString& filePath, const QVector<QVector4D>& points);
+
+// Parses a point count like "10k", "2.5M" or "100000", throws runtime_error for malformed counts.
+qsizetype parseCount(const QString& text);
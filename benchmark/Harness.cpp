@@ -0,0 +1,129 @@
+//
+//  A minimal benchmark harness
+//
+#include "Harness.h"
+#include "Parallel.h"
+#include "PointKernels.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSysInfo>
+
+#include <algorithm>
+#include <iostream>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <ctime>
+#endif
+
+namespace {
+// CPU time of all threads of the process in ms; std::clock is wall time with MSVCRT (MinGW)
+double processCpuMs()
+{
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+    const auto ticks = [](const FILETIME& t) {        // in 100 ns
+        return double((quint64(t.dwHighDateTime) << 32) | t.dwLowDateTime);
+    };
+    return 1e-4 * (ticks(kernel) + ticks(user));
+#else
+    timespec t;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t) != 0) return 0.0;
+    return 1e3 * double(t.tv_sec) + 1e-6 * double(t.tv_nsec);
+#endif
+}
+}
+
+bool BenchmarkRunner::enabled(const QString& name) const
+{
+    return options.filter.pattern().isEmpty() || options.filter.match(name).hasMatch();
+}
+
+bool BenchmarkRunner::run(const QString&               name,
+                          qsizetype                    items,
+                          const std::function<void()>& body,
+                          const std::function<void()>& setup)
+{
+    if (!enabled(name)) return false;
+
+    QVector<double> times;
+    double          cpu   = 0.0;
+    double          total = 0.0;
+    QElapsedTimer   timer;
+    MemoryTracker::resetPeaks();
+    while (times.size() < options.maxIterations &&
+           (times.size() < options.minIterations || total < 1e3 * options.minSeconds)) {
+        if (setup) setup();
+
+        const double c0 = processCpuMs();
+        timer.start();
+        body();
+        const double ms = 1e-6 * double(timer.nsecsElapsed());
+        cpu   += processCpuMs() - c0;
+        total += ms;
+        times.append(ms);
+    }
+
+    BenchmarkResult r;
+    r.name       = name;
+    r.items      = items;
+    r.iterations = int(times.size());
+    std::sort(times.begin(), times.end());
+    r.realTime   = times[times.size() / 2];
+    r.minTime    = times.front();
+    r.cpuTime    = cpu / double(times.size());
+    r.memory     = MemoryTracker::stats();
+    results.append(r);
+
+    std::cout << qPrintable(name.leftJustified(48)) << " " << r.realTime << " ms  ("
+              << r.iterations << " iterations, " << 1e-3 * double(items) / std::max(r.realTime, 1e-9) << " M items/s)" << std::endl;
+    return true;
+}
+
+QJsonDocument BenchmarkRunner::toJson() const
+{
+    QJsonObject context;
+    context["date"]               = QDateTime::currentDateTime().toString(Qt::ISODate);
+    context["host_name"]          = QSysInfo::machineHostName();
+    context["num_cpus"]           = int(workerCount());
+    context["cpu_architecture"]   = QSysInfo::currentCpuArchitecture();
+    context["os"]                 = QSysInfo::prettyProductName();
+#if defined(QT_DEBUG)
+    context["library_build_type"] = "debug";
+#else
+    context["library_build_type"] = "release";
+#endif
+    context["simd"]               = hasAVX2() ? "avx2" : "scalar";
+
+    QJsonArray benchmarks;
+    for (const BenchmarkResult& r: results) {
+        QJsonObject b;
+        b["name"]             = r.name;
+        b["run_name"]         = r.name;
+        b["run_type"]         = "iteration";
+        b["iterations"]       = r.iterations;
+        b["real_time"]        = r.realTime;
+        b["cpu_time"]         = r.cpuTime;
+        b["min_time"]         = r.minTime;
+        b["time_unit"]        = "ms";
+        b["items"]            = double(r.items);
+        b["items_per_second"] = 1e3 * double(r.items) / std::max(r.realTime, 1e-9);
+
+        QJsonObject memory;
+        for (const MemoryTracker::CategoryStats& c: r.memory)
+            if (c.peak > 0) memory[c.name] = double(c.peak);
+        b["memory_peak_bytes"] = memory;
+        benchmarks.append(b);
+    }
+
+    QJsonObject root;
+    root["context"]    = context;
+    root["benchmarks"] = benchmarks;
+    return QJsonDocument(root);
+}
@@ -0,0 +1,63 @@
+//
+//  A minimal benchmark harness
+//
+//  Each benchmark repeats its body until both a minimum number of iterations and a minimum
+//  total time are reached and records the wall time of every iteration. Untimed setup code
+//  runs before each iteration, e.g. to restore the input of an in-place operation. The
+//  results are written in the JSON layout of Google Benchmark ("context" + "benchmarks"
+//  with real_time, cpu_time, time_unit, items_per_second), so its compare.py and other
+//  existing tooling can track regressions between releases. Per benchmark, the peaks of
+//  the MemoryTracker categories are added as "memory_peak_bytes".
+//
+#pragma once
+
+#include "MemoryTracker.h"
+
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+#include <vector>
+
+struct BenchmarkResult {
+    QString   name;                 // <group>/<operation>/<dataset>/<points>
+    qsizetype items      = 0;       // items (points, queries) processed per iteration
+    int       iterations = 0;
+    double    realTime   = 0.0;     // median wall time per iteration in ms
+    double    minTime    = 0.0;     // fastest iteration in ms
+    double    cpuTime    = 0.0;     // mean process CPU time per iteration in ms (all threads)
+    std::vector<MemoryTracker::CategoryStats> memory;   // peaks over all iterations, incl. memory held before
+};
+
+struct BenchmarkOptions {
+    double             minSeconds    = 0.5;     // total time spent per benchmark at least
+    int                minIterations = 3;
+    int                maxIterations = 1000;
+    QRegularExpression filter;                  // benchmarks whose names do not match are skipped
+};
+
+class BenchmarkRunner
+{
+private:
+    BenchmarkOptions         options;
+    QVector<BenchmarkResult> results;
+
+public:
+    BenchmarkRunner(const BenchmarkOptions& _options): options(_options) {}
+
+    bool enabled(const QString& name) const;
+
+    // Times body, setup runs untimed before each iteration. Skipped (returning false), if
+    // the name does not match the filter. Exceptions of setup or body propagate.
+    bool run(const QString&               name,
+             qsizetype                    items,
+             const std::function<void()>& body,
+             const std::function<void()>& setup = {});
+
+    const QVector<BenchmarkResult>& getResults() const { return results; }
+
+    // Google Benchmark compatible document
+    QJsonDocument toJson() const;
+};
@@ -0,0 +1,236 @@
+//
+//  Benchmarks of the load, index build, query, transform and render paths
+//
+//  Usage: Benchmark [options] [ply files...]
+//
+//  Runs every benchmark on synthetic clouds of each distribution and size, and on the given
+//  PLY files, and writes the results as JSON (Google Benchmark layout). Rendering needs an
+//  OpenGL context; on machines without display run with "-platform offscreen" (or set
+//  QT_QPA_PLATFORM=offscreen), render benchmarks are skipped if no context can be created.
+//
+#include "Datasets.h"
+#include "Harness.h"
+
+#include "KdTree.h"
+#include "OctTree.h"
+#include "OffscreenRenderer.h"
+#include "PLYWriter.h"
+#include "PointCloud.h"
+#include "PointKernels.h"
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QTemporaryDir>
+
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+
+using namespace std;
+
+namespace {
+struct Dataset {
+    QString            name;
+    QVector<QVector4D> points;
+    QString            plyPath;     // file to parse, empty if there is none
+    QString            scratchPath; // prefix of files written by the benchmarks, empty if none
+};
+
+void removeScratch(const Dataset& data)
+{
+    if (data.scratchPath.isEmpty()) return;
+    QFile::remove(data.scratchPath + ".ply");
+    QFile::remove(data.scratchPath + ".plyz");
+}
+
+void runDataset(BenchmarkRunner& runner, const Dataset& data, OffscreenRenderer* renderer, int octreeDepth, int k)
+{
+    const QVector<QVector4D>& pts    = data.points;
+    const qsizetype           n      = pts.size();
+    const QString             suffix = "/" + data.name + "/" + QString::number(n);
+    auto name = [&suffix](const char* benchmark) { return QString(benchmark) + suffix; };
+
+    // parsing
+    if (!data.plyPath.isEmpty())
+        runner.run(name("ply/parse"), n, [&] {
+            PointCloud pc;
+            pc.loadPLY(data.plyPath);
+        });
+
+    // writing and parsing binary and compressed files
+    if (!data.scratchPath.isEmpty()) {
+        PointCloud cloud;
+        static_cast<QVector<QVector4D>&>(cloud) = pts;
+        cloud.updateBounds();
+        for (PLYEncoding encoding: {PLYEncoding::PE_BINARY, PLYEncoding::PE_COMPRESSED}) {
+            const bool      compressed = encoding == PLYEncoding::PE_COMPRESSED;
+            const QString   filePath   = data.scratchPath + (compressed ? ".plyz" : ".ply");
+            PLYWriteOptions options;
+            options.encoding = encoding;
+            const QString   parse      = name(compressed ? "ply/parse-compressed" : "ply/parse-binary");
+            runner.run(name(compressed ? "ply/write-compressed" : "ply/write-binary"), n, [&] { writePLY(filePath, cloud, {}, options); });
+            if (runner.enabled(parse) && !QFileInfo::exists(filePath)) writePLY(filePath, cloud, {}, options);
+            runner.run(parse, n, [&] {
+                PointCloud pc;
+                pc.loadPLY(filePath);
+            });
+        }
+    }
+
+    // index builds, the trees are freed outside of the timed section
+    KdNode* kd = nullptr;
+    runner.run(name("kdtree/build"), n, [&] { kd = buildKdTree(pts); },
+                                        [&] { delete kd; kd = nullptr; });
+
+    OctNode*        oct = nullptr;
+    QVector3D       lo, hi;
+    computeBounds(pts.constData(), n, lo, hi);
+    QVector<int>    all(n);
+    std::iota(all.begin(), all.end(), 0);
+    runner.run(name("octree/build"), n, [&] { oct = buildOctTree(pts, QVector4D(lo, 1.0f), QVector4D(hi, 1.0f), all, 0, octreeDepth); },
+                                        [&] { delete oct; oct = nullptr; });
+    delete oct;
+    all = QVector<int>();
+
+    // queries at points of the cloud, spread over it
+    if (!kd && (runner.enabled(name("kdtree/knn")) || runner.enabled(name("kdtree/radius")) || runner.enabled(name("kdtree/pick"))))
+        kd = buildKdTree(pts);
+    if (kd) {
+        const qsizetype    q = std::min<qsizetype>(n, 10000);
+        QVector<QVector4D> queries(q);
+        for (qsizetype i = 0; i < q; i++) queries[i] = pts[i * (n / q)];
+
+        runner.run(name("kdtree/knn"), q, [&] { volatile qsizetype s = kNearestNeighbors(kd, queries, k).size(); (void)s; });
+
+        // radius of a ball holding about k points, if they were uniformly distributed
+        const QVector3D e = hi - lo;
+        const float     r = std::cbrt(3.0f * float(k) * std::max(e.x() * e.y() * e.z(), 1e-12f) / (4.0f * 3.14159265f * float(n)));
+        runner.run(name("kdtree/radius"), q, [&] {
+            volatile int count = 0;
+            for (const QVector4D& p: queries) count = count + countInRadius(kd, p, r, std::numeric_limits<int>::max());
+        });
+
+        // picking rays from outside the AABB through the query points, as wide as that ball
+        const QVector3D dir = QVector3D(1.0f, 2.0f, 3.0f).normalized();
+        runner.run(name("kdtree/pick"), q, [&] {
+            volatile int hits = 0;
+            for (const QVector4D& p: queries) {
+                PickRay ray;
+                ray.dir    = dir;
+                ray.origin = p.toVector3D() - e.length() * dir;
+                ray.radius = r;
+                float t    = std::numeric_limits<float>::max();
+                hits = hits + (rayPick(kd, ray, lo, hi, t) >= 0);
+            }
+        });
+        delete kd;
+    }
+
+    // bulk transforms and rendering work on a point cloud object
+    PointCloud pc;
+    static_cast<QVector<QVector4D>&>(pc) = pts;
+    pc.updateBounds();
+
+    QMatrix4x4 M;
+    M.rotate(1.0f, 0.0f, 1.0f, 0.0f);
+    M.translate(0.001f, 0.0f, 0.0f);
+    runner.run(name("transform/affine"), n, [&] { pc.affineMap(M); });
+
+    if (!renderer) return;
+
+    // one frame including its readback, resp. frames in flight as for turntables
+    const QVector3D center = 0.5f * (pc.getMin() + pc.getMax());
+    const float     radius = std::max(0.5f * (pc.getMax() - pc.getMin()).length(), 1e-6f);
+    const auto      draw   = [&pc](const RenderCamera& camera) { pc.draw(camera, COLOR_POINT_CLOUD, 1.0f); };
+    renderer->setPose(CameraPath::overview(pc.getMin(), pc.getMax()), center, radius);
+    runner.run(name("render/points"), n, [&] { renderer->renderFrame(draw, 0); renderer->flush(); });
+    int frame = 0;
+    runner.run(name("render/pipelined"), n, [&] { renderer->renderFrame(draw, frame++); });
+    renderer->flush();
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("Benchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks of PLY parsing, tree builds, queries, transforms and rendering.");
+    parser.addHelpOption();
+    QCommandLineOption outOption      ("out",           "JSON output file.", "file", "benchmark.json");
+    QCommandLineOption sizesOption    ("sizes",         "Comma separated point counts of the synthetic clouds, e.g. 10k,1M,100M.", "counts", "10k,100k,1M");
+    QCommandLineOption datasetsOption ("datasets",      "Comma separated distributions: uniform, clustered, planar.", "names", "uniform,clustered,planar");
+    QCommandLineOption filterOption   ("filter",        "Runs only benchmarks whose names match the regular expression.", "regex");
+    QCommandLineOption minTimeOption  ("min-time",      "Minimum time per benchmark in seconds.", "seconds", "0.5");
+    QCommandLineOption plyLimitOption ("ply-limit",     "Largest synthetic cloud also written to and parsed from PLY.", "count", "10M");
+    QCommandLineOption noRenderOption ("no-render",     "Skips the render benchmarks.");
+    parser.addOptions({outOption, sizesOption, datasetsOption, filterOption, minTimeOption, plyLimitOption, noRenderOption});
+    parser.addPositionalArgument("files", "PLY files benchmarked in addition to the synthetic clouds.", "[files...]");
+    parser.process(app);
+
+    try {
+        BenchmarkOptions options;
+        options.minSeconds = parser.value(minTimeOption).toDouble();
+        options.filter     = QRegularExpression(parser.value(filterOption));
+        if (!options.filter.isValid()) throw runtime_error("invalid filter " + parser.value(filterOption).toStdString());
+        BenchmarkRunner runner(options);
+
+        QVector<qsizetype> sizes;
+        for (const QString& s: parser.value(sizesOption).split(',')) sizes.append(parseCount(s));
+        QVector<Distribution> distributions;
+        for (const QString& s: parser.value(datasetsOption).split(',')) distributions.append(parseDistribution(s.trimmed()));
+        const qsizetype plyLimit = parseCount(parser.value(plyLimitOption));
+
+        std::optional<OffscreenRenderer> target;
+        if (!parser.isSet(noRenderOption)) {
+            target.emplace();
+            if (!target->create(1280, 720, /*samples=*/0)) {
+                cerr << "no OpenGL context, render benchmarks skipped" << endl;
+                target.reset();
+            }
+        }
+
+        QTemporaryDir tmp;
+        for (Distribution d: distributions)
+            for (qsizetype n: sizes) {
+                Dataset data;
+                data.name   = distributionName(d);
+                data.points = generatePoints(d, n);
+                if (n <= plyLimit && tmp.isValid() && runner.enabled("ply/parse/" + data.name + "/" + QString::number(n))) {
+                    data.plyPath = tmp.filePath(data.name + ".ply");
+                    writePLY(data.plyPath, data.points);
+                }
+                if (n <= plyLimit && tmp.isValid()) data.scratchPath = tmp.filePath(data.name + "_out");
+                runDataset(runner, data, target ? &*target : nullptr, /*octreeDepth=*/6, /*k=*/8);
+                if (!data.plyPath.isEmpty()) QFile::remove(data.plyPath);
+                removeScratch(data);
+            }
+
+        for (const QString& file: parser.positionalArguments()) {
+            PointCloud pc;
+            pc.loadPLY(file);
+            Dataset data;
+            data.name    = QFileInfo(file).completeBaseName();
+            data.points  = pc;
+            data.plyPath = file;
+            if (tmp.isValid()) data.scratchPath = tmp.filePath(data.name + "_out");
+            runDataset(runner, data, target ? &*target : nullptr, /*octreeDepth=*/6, /*k=*/8);
+            removeScratch(data);
+        }
+
+        QFile out(parser.value(outOption));
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            throw runtime_error("cannot write " + parser.value(outOption).toStdString());
+        out.write(runner.toJson().toJson());
+        cout << "results written to " << qPrintable(parser.value(outOption)) << endl;
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
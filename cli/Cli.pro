@@ -0,0 +1,78 @@
+# ----------------------------------------------------
+# Headless batch processing with the framework's
+# point cloud pipeline and offscreen previews,
+# see main.cpp for usage.
+# Same sources as the viewer, without widgets.
+# ------------------------------------------------------
+
+TEMPLATE = app
+TARGET = FrameworkCli
+QT += core gui opengl
+QT -= widgets
+CONFIG += console release c++20
+CONFIG -= app_bundle
+INCLUDEPATH += . \
+    .. \
+    ../external/eigen-3.4.0
+LIBS += -lopengl32 -lglu32   # on Linux and Mac use "LIBS += -lglut" instead
+DEPENDPATH += . ..
+
+HEADERS += Pipeline.h \
+    ../GLConvenience.h \
+    ../QtConvenience.h \
+    ../BVH.h \
+    ../CameraPath.h \
+    ../EuclideanClustering.h \
+    ../Hexahedron.h \
+    ../ImageSequenceWriter.h \
+    ../InstancedBoxes.h \
+    ../KdTree.h \
+    ../MemoryTracker.h \
+    ../NormalEstimation.h \
+    ../OctTree.h \
+    ../OffscreenRenderer.h \
+    ../PerspectiveCamera.h \
+    ../Parallel.h \
+    ../PLYWriter.h \
+    ../Plane.h \
+    ../PlaneSegmentation.h \
+    ../PointCloud.h \
+    ../PointCloudFilters.h \
+    ../PointKernels.h \
+    ../Profiler.h \
+    ../RenderCamera.h \
+    ../SceneManager.h \
+    ../SceneObject.h \
+    ../StereoCamera.h \
+    ../StereoMatching.h \
+    ../StereoRectification.h
+
+SOURCES += main.cpp \
+    Pipeline.cpp \
+    ../GLConvenience.cpp \
+    ../QtConvenience.cpp \
+    ../BVH.cpp \
+    ../CameraPath.cpp \
+    ../EuclideanClustering.cpp \
+    ../Hexahedron.cpp \
+    ../ImageSequenceWriter.cpp \
+    ../InstancedBoxes.cpp \
+    ../KdTree.cpp \
+    ../MemoryTracker.cpp \
+    ../NormalEstimation.cpp \
+    ../OctTree.cpp \
+    ../OffscreenRenderer.cpp \
+    ../PerspectiveCamera.cpp \
+    ../PLYWriter.cpp \
+    ../Plane.cpp \
+    ../PlaneSegmentation.cpp \
+    ../PointCloud.cpp \
+    ../PointCloudFilters.cpp \
+    ../PointKernels.cpp \
+    ../Profiler.cpp \
+    ../RenderCamera.cpp \
+    ../SceneManager.cpp \
+    ../SceneObject.cpp \
+    ../StereoCamera.cpp \
+    ../StereoMatching.cpp \
+    ../StereoRectification.cpp
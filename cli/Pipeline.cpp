@@ -0,0 +1,262 @@
+//
+//  Processing pipelines of the command line tool
+//
+#include "Pipeline.h"
+
+#include "EuclideanClustering.h"
+#include "KdTree.h"
+#include "NormalEstimation.h"
+#include "PlaneSegmentation.h"
+#include "PointCloudFilters.h"
+
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+enum class ParamKind {PK_NUMBER, PK_LENGTH, PK_COUNT};
+
+struct ParamInfo {
+    const char* key;
+    ParamKind   kind;
+    double      defaultValue;
+    bool        relative;               // default is given in %
+    const char* description;
+};
+
+struct StepInfo {
+    PipelineStepType         type;
+    const char*              name;
+    const char*              description;
+    QVector<ParamInfo>       params;
+};
+
+// the viewer's defaults, relative to the AABB's diagonal (see GLWidget::downsampleCellSize)
+const QVector<StepInfo>& stepInfos()
+{
+    using enum PipelineStepType;
+    using enum ParamKind;
+    static const QVector<StepInfo> infos = {
+        { PS_STATISTICAL_OUTLIERS, "sor",      "statistical outlier removal",
+          { { "k",         PK_COUNT,  16,   false, "neighbours" },
+            { "std",       PK_NUMBER, 1.0,  false, "max. standard deviations above the mean distance" } } },
+        { PS_RADIUS_OUTLIERS,      "ror",      "radius outlier removal",
+          { { "radius",    PK_LENGTH, 0.5,  true,  "neighbourhood radius" },
+            { "min",       PK_COUNT,  4,    false, "min. neighbours within radius" } } },
+        { PS_VOXEL_GRID,           "voxel",    "voxel-grid downsampling",
+          { { "size",      PK_LENGTH, 0.5,  true,  "voxel edge length" },
+            { "nearest",   PK_NUMBER, 0,    false, "1 keeps the input point nearest to the centroid" } } },
+        { PS_POISSON_DISK,         "poisson",  "Poisson-disk subsampling",
+          { { "distance",  PK_LENGTH, 0.5,  true,  "min. distance of kept points" } } },
+        { PS_NORMALS,              "normals",  "normal estimation, oriented towards the origin",
+          { { "k",         PK_COUNT,  16,   false, "neighbours" } } },
+        { PS_PLANES,               "planes",   "RANSAC plane segmentation, adds the property 'plane'",
+          { { "threshold", PK_LENGTH, 0.25, true,  "max. point-to-plane distance of inliers" },
+            { "max",       PK_COUNT,  5,    false, "max. number of planes" },
+            { "min",       PK_COUNT,  1,    true,  "min. inliers per plane" },
+            { "iterations",PK_COUNT,  2000, false, "max. hypotheses per plane" } } },
+        { PS_CLUSTERS,             "clusters", "Euclidean clustering, adds the property 'cluster'",
+          { { "tolerance", PK_LENGTH, 1.0,  true,  "max. distance of neighbouring points" },
+            { "min",       PK_COUNT,  0.1,  true,  "min. points per cluster" },
+            { "max",       PK_COUNT,  100,  true,  "max. points per cluster" } } },
+    };
+    return infos;
+}
+
+const StepInfo& stepInfo(PipelineStepType type)
+{
+    for (const StepInfo& s: stepInfos())
+        if (s.type == type) return s;
+    throw runtime_error("unknown pipeline step");
+}
+
+const ParamInfo* paramInfo(const StepInfo& step, const QString& key)
+{
+    for (const ParamInfo& p: step.params)
+        if (key == p.key) return &p;
+    return nullptr;
+}
+
+int countValue(double v)
+{
+    return int(std::clamp(std::round(v), 0.0, double(INT_MAX)));
+}
+}
+
+double PipelineStep::value(const QString& key, const PointCloud& cloud) const
+{
+    const ParamInfo* p = paramInfo(stepInfo(type), key);
+    const double     v = values.value(key);
+    if (!p || !relative.contains(key)) return v;
+    if (p->kind == ParamKind::PK_LENGTH) return 0.01 * v * double((cloud.getMax() - cloud.getMin()).length());
+    return 0.01 * v * double(cloud.size());
+}
+
+QString PipelineStep::toString() const
+{
+    QString text = name;
+    for (const ParamInfo& p: stepInfo(type).params)
+        text += QString(":%1=%2%3").arg(p.key).arg(values.value(p.key)).arg(relative.contains(p.key) ? "%" : "");
+    return text;
+}
+
+QVector<PipelineStep> parsePipeline(const QString& text)
+{
+    QVector<PipelineStep> steps;
+    for (const QString& s: text.split(',', Qt::SkipEmptyParts)) {
+        const QStringList parts = s.trimmed().split(':');
+
+        const StepInfo* info = nullptr;
+        for (const StepInfo& i: stepInfos())
+            if (parts[0] == i.name) info = &i;
+        if (!info) throw runtime_error("unknown pipeline step " + parts[0].toStdString());
+
+        PipelineStep step;
+        step.type = info->type;
+        step.name = info->name;
+        for (const ParamInfo& p: info->params) {
+            step.values[p.key] = p.defaultValue;
+            if (p.relative) step.relative.insert(p.key);
+        }
+
+        for (int i = 1; i < parts.size(); i++) {
+            const QStringList kv = parts[i].split('=');
+            const ParamInfo*  p  = kv.size() == 2 ? paramInfo(*info, kv[0]) : nullptr;
+            if (!p) throw runtime_error("unknown parameter " + parts[i].toStdString() + " of step " + step.name.toStdString());
+
+            QString    v        = kv[1];
+            const bool relative = v.endsWith('%');
+            if (relative) v.chop(1);
+            bool         ok    = false;
+            const double value = v.toDouble(&ok);
+            if (!ok || value < 0.0 || (relative && p->kind == ParamKind::PK_NUMBER))
+                throw runtime_error("invalid value " + parts[i].toStdString() + " of step " + step.name.toStdString());
+
+            step.values[p->key] = value;
+            if (relative) step.relative.insert(p->key);
+            else          step.relative.remove(p->key);
+        }
+        steps.append(step);
+    }
+    return steps;
+}
+
+QString pipelineHelp()
+{
+    QString help = "Pipeline steps (lengths with '%' relative to the AABB's diagonal, counts with '%' relative to the points):\n";
+    for (const StepInfo& s: stepInfos()) {
+        help += QString("  %1  %2\n").arg(QString(s.name).leftJustified(9), s.description);
+        for (const ParamInfo& p: s.params)
+            help += QString("      %1 %2 (default %3%4)\n").arg(QString(p.key).leftJustified(10), p.description)
+                        .arg(p.defaultValue).arg(p.relative ? "%" : "");
+    }
+    return help;
+}
+
+PipelineResult runPipeline(const QVector<PipelineStep>& steps,
+                           const QString&               input,
+                           const QString&               output,
+                           const PLYWriteOptions&       format,
+                           unique_ptr<PointCloud>*      processed)
+{
+    using enum PipelineStepType;
+
+    PipelineResult result;
+    QElapsedTimer  timer;
+    const auto     lap = [&](const QString& name) {
+        result.stepTimes.append({ name, 1e-6 * double(timer.nsecsElapsed()) });
+        timer.start();
+    };
+
+    timer.start();
+    unique_ptr<PointCloud> cloud = make_unique<PointCloud>();
+    cloud->loadPLY(input, /*normalize=*/false);
+    cloud->updateBounds();
+    result.inputPoints = cloud->size();
+    lap("load");
+
+    // the cloud rebuilds its kd-tree after the points changed, labels are dropped then
+    const auto tree          = [&] { return cloud->getKdTree(); };
+    const auto pointsChanged = [&] {
+        result.planes   = -1;
+        result.clusters = -1;
+    };
+    QVector<int> planeLabels, clusterLabels;
+
+    for (const PipelineStep& step: steps) {
+        if (cloud->isEmpty()) break;
+        const auto value = [&](const char* key) { return step.value(key, *cloud); };
+
+        switch (step.type) {
+        case PS_STATISTICAL_OUTLIERS:
+            removeStatisticalOutliers(*cloud, tree(), countValue(value("k")), float(value("std")));
+            pointsChanged();
+            break;
+        case PS_RADIUS_OUTLIERS:
+            removeRadiusOutliers(*cloud, tree(), float(value("radius")), countValue(value("min")));
+            pointsChanged();
+            break;
+        case PS_VOXEL_GRID:
+            if (const float size = float(value("size")); size > 0.0f) {
+                cloud.reset(voxelGridDownsample(*cloud, size, value("nearest") != 0.0 ? VoxelMode::VM_NEAREST_TO_CENTROID
+                                                                                       : VoxelMode::VM_CENTROID));
+                pointsChanged();
+            }
+            break;
+        case PS_POISSON_DISK:
+            if (const float distance = float(value("distance")); distance > 0.0f) {
+                cloud.reset(poissonDiskDownsample(*cloud, distance));
+                pointsChanged();
+            }
+            break;
+        case PS_NORMALS:
+            // the file origin (the scanner position) in the cloud's local coordinates
+            estimateNormals(*cloud, tree(), std::max(3, countValue(value("k"))), cloud->getFrame().toLocal({0.0, 0.0, 0.0}));
+            break;
+        case PS_PLANES: {
+            PlaneRansacParams params;
+            params.threshold     = float(value("threshold"));
+            params.maxPlanes     = countValue(value("max"));
+            params.minInliers    = std::max(3, countValue(value("min")));
+            params.maxIterations = std::max(1, countValue(value("iterations")));
+            const vector<PlaneSegment> segments = segmentPlanes(*cloud, params);
+            planeLabels.fill(-1, cloud->size());
+            for (int s = 0; s < int(segments.size()); s++)
+                for (int i: segments[s].inliers) planeLabels[i] = s;
+            result.planes = int(segments.size());
+            break;
+        }
+        case PS_CLUSTERS: {
+            ClusterParams params;
+            params.tolerance = float(value("tolerance"));
+            params.minSize   = std::max(1, countValue(value("min")));
+            params.maxSize   = std::max(params.minSize, countValue(value("max")));
+            result.clusters  = int(euclideanClusters(*cloud, tree(), params, &clusterLabels).size());
+            break;
+        }
+        }
+        lap(step.name);
+    }
+    result.outputPoints = cloud->size();
+
+    if (!output.isEmpty()) {
+        QVector<PLYChannel> labels;
+        if (result.planes   >= 0) labels.append(PLYChannel::ints("plane",   planeLabels));
+        if (result.clusters >= 0) labels.append(PLYChannel::ints("cluster", clusterLabels));
+        writePLY(output, *cloud, labels, format);
+        lap("export");
+    }
+
+    // the processed cloud is labelled by the last segmentation, e.g. for colored previews
+    if (processed && result.clusters >= 0) cloud->setLabels(clusterLabels);
+    else if (processed && result.planes >= 0) cloud->setLabels(planeLabels);
+    if (processed) *processed = std::move(cloud);
+    return result;
+}
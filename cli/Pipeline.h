@@ -0,0 +1,70 @@
+//
+//  Processing pipelines of the command line tool
+//
+//  A pipeline is a sequence of steps applied to a point cloud, written as
+//  "step:key=value:key=value,step,...", e.g.
+//
+//      sor:k=16:std=1,voxel:size=0.5%,normals,planes:threshold=0.25%,clusters:tolerance=1%
+//
+//  Lengths are given in the units of the file, or with a '%' suffix relative to the diagonal
+//  of the cloud's AABB; counts with a '%' suffix are relative to the number of points. The
+//  steps call the same filters, estimators and segmentations as the viewer. The kd-tree is
+//  built when a step needs it and rebuilt only after steps that changed the points.
+//
+#pragma once
+
+#include "PLYWriter.h"
+#include "PointCloud.h"
+
+#include <QHash>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+#include <memory>
+
+enum class PipelineStepType {PS_STATISTICAL_OUTLIERS,   // "sor"
+                             PS_RADIUS_OUTLIERS,        // "ror"
+                             PS_VOXEL_GRID,             // "voxel"
+                             PS_POISSON_DISK,           // "poisson"
+                             PS_NORMALS,                // "normals"
+                             PS_PLANES,                 // "planes", labels the points by plane
+                             PS_CLUSTERS};              // "clusters", labels the points by cluster
+
+struct PipelineStep {
+    PipelineStepType       type;
+    QString                name;
+    QHash<QString, double> values;      // all parameters of the step, defaults filled in
+    QSet<QString>          relative;    // parameters given with '%'
+
+    // parameter key resolved for cloud, i.e. relative values scaled by its diagonal resp. size
+    double value(const QString& key, const PointCloud& cloud) const;
+
+    QString toString() const;
+};
+
+// Parses a pipeline. Throws runtime_error for unknown steps or keys and malformed values.
+QVector<PipelineStep> parsePipeline(const QString& text);
+
+// Description of all steps with their parameters and defaults
+QString pipelineHelp();
+
+struct PipelineResult {
+    qsizetype                        inputPoints  = 0;
+    qsizetype                        outputPoints = 0;
+    int                              planes       = -1;     // -1 if not segmented
+    int                              clusters     = -1;     // -1 if not clustered
+    QVector<QPair<QString, double>>  stepTimes;             // ms, including "load" and "export"
+};
+
+// Loads input (in the file's units), runs the steps and writes the result to output in the given
+// format, if it is not empty, with the normals, the attribute channels of the input and the plane
+// and cluster labels as int properties. processed (optional) receives the processed cloud, with
+// the cluster (else plane) labels as its label channel. Throws runtime_error for unreadable or
+// unwritable files.
+PipelineResult runPipeline(const QVector<PipelineStep>& steps,
+                           const QString&               input,
+                           const QString&               output,
+                           const PLYWriteOptions&       format    = {},
+                           std::unique_ptr<PointCloud>* processed = nullptr);
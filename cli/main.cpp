@@ -0,0 +1,359 @@
+//
+//  Headless batch processing of point clouds
+//
+//  Usage: FrameworkCli --steps <pipeline> [options] <ply files or directories...>
+//
+//  Runs a pipeline (see Pipeline.h) on every given PLY file, resp. every PLY file in the given
+//  directories, and writes the results to the output directory as binary PLY (--format ascii
+//  or compressed, see PLYWriter.h). Several files are processed concurrently; the thread budget
+//  is split evenly between them, such that the parallel kernels of all jobs together use at
+//  most --threads cores. No display or OpenGL context is needed.
+//
+//  Optionally, a thumbnail and/or a turntable (or a scripted camera path, see CameraPath.h)
+//  of each processed cloud is rendered offscreen. Rendering runs on the main thread, which
+//  owns the OpenGL context, while the jobs continue with the next files; the frames are
+//  encoded to PNG by --encoders further threads. Without display, Qt's offscreen platform
+//  is used, see OffscreenRenderer.h for the OpenGL requirements.
+//
+#include "Pipeline.h"
+#include "CameraPath.h"
+#include "ImageSequenceWriter.h"
+#include "OffscreenRenderer.h"
+#include "Parallel.h"
+#include "SceneManager.h"
+
+#include <QCommandLineParser>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+using namespace std;
+
+namespace {
+struct Job {
+    QString        input, output;
+    QString        preview;                 // output path without extension for thumbnail and frames
+    PipelineResult result;
+    QString        error;
+};
+
+struct RenderOptions {
+    QSize                     thumbnail;                    // empty: no thumbnail
+    QSize                     frameSize;
+    int                       frames     = 0;               // of the turntable, 0: none
+    std::optional<CameraPath> path;                         // scripted instead of the turntable
+    float                     fps        = 30.0f;
+    unsigned                  pointSize  = 2;
+    ColorMode                 color      = ColorMode::CM_AUTO;
+
+    bool enabled() const { return !thumbnail.isEmpty() || frames > 0 || path; }
+};
+
+// parses "640x480", throws runtime_error for malformed sizes
+QSize parseSize(const QString& text)
+{
+    const QStringList wh = text.split('x');
+    bool okW = false, okH = false;
+    const QSize size = wh.size() == 2 ? QSize(wh[0].toInt(&okW), wh[1].toInt(&okH)) : QSize();
+    if (!okW || !okH || size.isEmpty()) throw runtime_error("invalid image size " + text.toStdString());
+    return size;
+}
+
+// renders thumbnail and frames of the processed cloud, the writer encodes them on its threads
+qsizetype renderPreviews(const Job& job, PointCloud* cloud, const RenderOptions& options,
+                         OffscreenRenderer& renderer, ImageSequenceWriter& writer)
+{
+    SceneManager scene;
+    renderer.camera().setColorMode(options.color);
+    cloud->setPointSize(options.pointSize);
+    scene.add(cloud);                                       // takes ownership
+
+    QVector3D bbMin, bbMax;
+    if (!scene.bounds(scene.root(), bbMin, bbMax)) return 0;
+    const QVector3D center = 0.5f * (bbMin + bbMax);
+    const float     radius = std::max(0.5f * (bbMax - bbMin).length(), 1e-6f);
+
+    if (!options.thumbnail.isEmpty()) {
+        renderer.resize(options.thumbnail.width(), options.thumbnail.height());
+        renderer.setPose(CameraPath::overview(bbMin, bbMax), center, radius);
+        writer.write(job.preview + ".png", renderer.renderImage(scene));
+    }
+
+    // a turntable of n frames loops, i.e. frame n would be frame 0 again
+    const CameraPath path   = options.path ? *options.path : CameraPath::turntable(bbMin, bbMax, float(options.frames) / options.fps);
+    const int        frames = options.path ? int(std::floor(path.duration() * options.fps)) + 1 : options.frames;
+    if (frames <= 0) return 0;
+
+    const QString dir = job.preview + "_frames";
+    if (!QDir().mkpath(dir)) throw runtime_error("cannot create " + dir.toStdString());
+    renderer.resize(options.frameSize.width(), options.frameSize.height());
+    renderer.setFrameSink([&writer, &dir](int frame, const QImage& image) {
+        writer.write(QString("%1/frame_%2.png").arg(dir).arg(frame, 4, 10, QChar('0')), image);
+    });
+    for (int i = 0; i < frames; i++) {
+        renderer.setPose(path.at(float(i) / options.fps), center, radius);
+        renderer.renderFrame(scene, i);
+    }
+    renderer.flush();
+    renderer.setFrameSink({});
+    return frames;
+}
+
+// PLY files given directly or contained in given directories, in the given order
+QStringList inputFiles(const QStringList& args)
+{
+    QStringList files;
+    for (const QString& a: args) {
+        const QFileInfo info(a);
+        if (info.isDir()) {
+            for (const QFileInfo& f: QDir(a).entryInfoList({ "*.ply", "*.PLY", "*.plyz" }, QDir::Files, QDir::Name))
+                files.append(f.filePath());
+        } else
+            files.append(a);
+    }
+    return files;
+}
+
+QJsonDocument report(const QVector<Job>& jobs, const QVector<PipelineStep>& steps, unsigned threads, unsigned concurrent)
+{
+    QJsonArray pipeline;
+    for (const PipelineStep& s: steps) pipeline.append(s.toString());
+
+    QJsonArray files;
+    for (const Job& j: jobs) {
+        QJsonObject f;
+        f["input"]  = j.input;
+        f["output"] = j.output;
+        if (!j.error.isEmpty()) f["error"] = j.error;
+        else {
+            f["input_points"]  = double(j.result.inputPoints);
+            f["output_points"] = double(j.result.outputPoints);
+            if (j.result.planes   >= 0) f["planes"]   = j.result.planes;
+            if (j.result.clusters >= 0) f["clusters"] = j.result.clusters;
+            QJsonObject times;
+            for (const auto& [name, ms]: j.result.stepTimes) times[name] = ms;
+            f["time_ms"] = times;
+        }
+        files.append(f);
+    }
+
+    QJsonObject root;
+    root["pipeline"] = pipeline;
+    root["threads"]  = int(threads);
+    root["jobs"]     = int(concurrent);
+    root["files"]    = files;
+    return QJsonDocument(root);
+}
+}
+
+int main(int argc, char* argv[])
+{
+    // no display needed, neither for processing nor for offscreen rendering
+    if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName("FrameworkCli");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Runs a point cloud processing pipeline on PLY files without GUI.\n\n" + pipelineHelp());
+    parser.addHelpOption();
+    QCommandLineOption stepsOption  ("steps",   "Pipeline, e.g. sor,voxel:size=0.01,normals:k=16,planes.", "pipeline");
+    QCommandLineOption outOption    ("out",     "Output directory.", "dir", ".");
+    QCommandLineOption suffixOption ("suffix",  "Appended to the input's base name for the output file.", "suffix", "_processed");
+    QCommandLineOption threadsOption("threads", "Thread budget of all jobs together (default: all cores).", "n");
+    QCommandLineOption jobsOption   ("jobs",    "Files processed concurrently (default: one per 4 threads).", "n");
+    QCommandLineOption reportOption ("report",  "Writes sizes and timings of all files as JSON.", "file");
+    QCommandLineOption dryRunOption ("no-export", "Runs the pipeline without writing the results.");
+    QCommandLineOption formatOption ("format",  "Output format: ascii, binary or compressed (.plyz).", "format", "binary");
+    QCommandLineOption thumbOption  ("thumbnail", "Renders a thumbnail of each result, e.g. 320x240.", "size");
+    QCommandLineOption turnOption   ("turntable", "Renders a turntable of the given number of frames.", "frames");
+    QCommandLineOption pathOption   ("camera-path", "Renders frames along the scripted camera path instead.", "file");
+    QCommandLineOption sizeOption   ("frame-size", "Size of turntable and camera path frames.", "size", "1280x720");
+    QCommandLineOption fpsOption    ("fps",     "Frames per second of turntable and camera path.", "fps", "30");
+    QCommandLineOption pointOption  ("point-size", "Point size in pixels of the rendered clouds.", "pixels", "2");
+    QCommandLineOption colorOption  ("color",   "Coloring of the rendered clouds: auto, uniform, normal, rgb, intensity, height or label.", "mode", "auto");
+    QCommandLineOption encodeOption ("encoders", "Threads encoding the rendered images.", "n", "2");
+    parser.addOptions({stepsOption, outOption, suffixOption, threadsOption, jobsOption, reportOption, dryRunOption, formatOption,
+                       thumbOption, turnOption, pathOption, sizeOption, fpsOption, pointOption, colorOption, encodeOption});
+    parser.addPositionalArgument("inputs", "PLY files or directories containing PLY files.", "<inputs...>");
+    parser.process(app);
+
+    QVector<PipelineStep> steps;
+    QVector<Job>          jobs;
+    RenderOptions         rendering;
+    PLYWriteOptions       format;
+    format.originalUnits = true;                // results in the input's coordinates, as doubles
+    unsigned              threads = workerCount(), concurrent = 1, encoders = 2;
+    try {
+        steps = parsePipeline(parser.value(stepsOption));
+
+        if (parser.isSet(threadsOption)) threads = parser.value(threadsOption).toUInt();
+        if (threads == 0) throw runtime_error("invalid thread budget " + parser.value(threadsOption).toStdString());
+
+        const QStringList files = inputFiles(parser.positionalArguments());
+        if (files.isEmpty()) throw runtime_error("no input files");
+
+        concurrent = parser.isSet(jobsOption) ? parser.value(jobsOption).toUInt() : std::max(1u, threads / 4);
+        if (concurrent == 0) throw runtime_error("invalid number of jobs " + parser.value(jobsOption).toStdString());
+        concurrent = std::min({ concurrent, threads, unsigned(files.size()) });
+
+        if (parser.isSet(thumbOption)) rendering.thumbnail = parseSize(parser.value(thumbOption));
+        if (parser.isSet(turnOption))  rendering.frames    = parser.value(turnOption).toInt();
+        if (parser.isSet(pathOption))  rendering.path      = CameraPath::load(parser.value(pathOption));
+        rendering.frameSize = parseSize(parser.value(sizeOption));
+        rendering.fps       = parser.value(fpsOption).toFloat();
+        rendering.pointSize = std::max(1u, parser.value(pointOption).toUInt());
+        encoders            = std::max(1u, parser.value(encodeOption).toUInt());
+        if (rendering.fps <= 0.0f || rendering.frames < 0) throw runtime_error("invalid frame count or rate");
+
+        const QStringList colorNames = { "auto", "uniform", "normal", "rgb", "intensity", "height", "label" };
+        const QString     colorName  = parser.value(colorOption);
+        if (!colorNames.contains(colorName)) throw runtime_error("unknown color mode " + colorName.toStdString());
+        rendering.color = ColorMode(colorNames.indexOf(colorName));
+
+        const QString formatName = parser.value(formatOption);
+        if      (formatName == "ascii")      format.encoding = PLYEncoding::PE_ASCII;
+        else if (formatName == "binary")     format.encoding = PLYEncoding::PE_BINARY;
+        else if (formatName == "compressed") format.encoding = PLYEncoding::PE_COMPRESSED;
+        else throw runtime_error("unknown format " + formatName.toStdString());
+
+        const QDir out(parser.value(outOption));
+        if ((!parser.isSet(dryRunOption) || rendering.enabled()) && !out.exists() && !QDir().mkpath(out.path()))
+            throw runtime_error("cannot create " + out.path().toStdString());
+
+        for (const QString& f: files) {
+            Job j;
+            j.input   = f;
+            j.preview = out.filePath(QFileInfo(f).completeBaseName() + parser.value(suffixOption));
+            if (!parser.isSet(dryRunOption)) j.output = j.preview + (format.encoding == PLYEncoding::PE_COMPRESSED ? ".plyz" : ".ply");
+            jobs.append(j);
+        }
+    }
+    catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    OffscreenRenderer renderer;
+    if (rendering.enabled() && !renderer.create(rendering.frameSize.width(), rendering.frameSize.height())) {
+        cerr << "no OpenGL 3.2 context for offscreen rendering" << endl;
+        return 1;
+    }
+
+    cout << "processing " << jobs.size() << " files, " << concurrent << " at a time with "
+         << threads / concurrent << " threads each" << endl;
+
+    // processed clouds waiting for the renderer, at most one per job
+    deque<pair<qsizetype, unique_ptr<PointCloud>>> rendered;
+    condition_variable                             renderQueued, renderTaken;
+    unsigned                                       running = concurrent;
+
+    // every job thread takes the next file, its kernels share threads/concurrent cores
+    atomic<qsizetype> next = 0;
+    mutex             outputMutex;
+    const auto        work = [&] {
+        ThreadBudget budget(threads / concurrent);
+        for (qsizetype i = next++; i < jobs.size(); i = next++) {
+            Job&                   j = jobs[i];
+            unique_ptr<PointCloud> cloud;
+            try {
+                j.result = runPipeline(steps, j.input, j.output, format, rendering.enabled() ? &cloud : nullptr);
+            }
+            catch (const exception& e) {
+                j.error = e.what();
+            }
+
+            unique_lock<mutex> lock(outputMutex);
+            if (cloud) {
+                renderTaken.wait(lock, [&] { return rendered.size() < concurrent; });
+                rendered.emplace_back(i, std::move(cloud));
+                renderQueued.notify_one();
+            }
+            if (!j.error.isEmpty()) {
+                cerr << qPrintable(j.input) << ": " << qPrintable(j.error) << endl;
+                continue;
+            }
+            double ms = 0.0;
+            for (const auto& t: j.result.stepTimes) ms += t.second;
+            cout << qPrintable(j.input) << ": " << j.result.inputPoints << " -> " << j.result.outputPoints << " points";
+            if (j.result.planes   >= 0) cout << ", " << j.result.planes   << " planes";
+            if (j.result.clusters >= 0) cout << ", " << j.result.clusters << " clusters";
+            cout << " in " << ms << " ms" << endl;
+        }
+
+        lock_guard<mutex> lock(outputMutex);
+        running--;
+        renderQueued.notify_one();
+    };
+
+    vector<thread> workers;
+    if (!rendering.enabled()) {
+        for (unsigned t = 1; t < concurrent; t++) workers.emplace_back(work);
+        work();
+        for (thread& t: workers) t.join();
+    } else {
+        // the main thread renders, since it owns the OpenGL context
+        for (unsigned t = 0; t < concurrent; t++) workers.emplace_back(work);
+        ImageSequenceWriter writer(QString(), "png", int(encoders), /*maxQueued=*/4 * int(encoders));
+        for (;;) {
+            unique_lock<mutex> lock(outputMutex);
+            renderQueued.wait(lock, [&] { return !rendered.empty() || running == 0; });
+            if (rendered.empty()) break;
+            auto [i, cloud] = std::move(rendered.front());
+            rendered.pop_front();
+            renderTaken.notify_one();
+            lock.unlock();
+
+            Job&          j = jobs[i];
+            QElapsedTimer timer;
+            timer.start();
+            qsizetype     frames = 0;
+            try {
+                frames = renderPreviews(j, cloud.release(), rendering, renderer, writer);
+            }
+            catch (const exception& e) {
+                j.error = e.what();
+            }
+
+            lock.lock();
+            if (!j.error.isEmpty()) cerr << qPrintable(j.input) << ": " << qPrintable(j.error) << endl;
+            else if (frames > 0)    cout << qPrintable(j.input) << ": " << frames << " frames rendered at "
+                                         << 1e3 * double(frames) / std::max<qint64>(timer.elapsed(), 1) << " fps" << endl;
+        }
+        for (thread& t: workers) t.join();
+        try {
+            writer.finish();
+        }
+        catch (const exception& e) {
+            cerr << e.what() << endl;
+            return 2;
+        }
+    }
+
+    if (parser.isSet(reportOption)) {
+        QFile file(parser.value(reportOption));
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            cerr << "cannot write " << qPrintable(parser.value(reportOption)) << endl;
+            return 1;
+        }
+        file.write(report(jobs, steps, threads, concurrent).toJson());
+    }
+
+    const qsizetype failed = std::count_if(jobs.begin(), jobs.end(), [](const Job& j) { return !j.error.isEmpty(); });
+    if (failed) cerr << failed << " of " << jobs.size() << " files failed" << endl;
+    return failed ? 2 : 0;
+}
@@ -8,6 +8,7 @@
 #include "KdTree.h"
 #include "OctTree.h"
 #include <numeric>
+#include <algorithm>
 
 #if defined(__APPLE__)
 // we're on macOS and according to their documentation Apple hates developers
@@ -31,13 +32,23 @@
 #include <QMouseEvent>
 #include <QFileDialog>
 #include <QMessageBox>
+#include <QPainter>
 
 #include <cassert>
 #include <iostream>
 
 #include "Axes.h"
 #include "Plane.h"
+#include "PerspectiveCamera.h"
+#include "StereoCamera.h"
 #include "PointCloud.h"
+#include "PointCloudFilters.h"
+#include "NormalEstimation.h"
+#include "PlaneSegmentation.h"
+#include "EuclideanClustering.h"
+#include "Registration.h"
+#include "PLYWriter.h"
+#include "Profiler.h"
 
 using namespace std;
 using namespace Qt;
@@ -53,40 +64,36 @@ GLWidget::GLWidget(QWidget* parent) : QOpenGLWidget(parent), pointSize(5)
     connect(renderer, &RenderCamera::changed, this, &GLWidget::onRendererChanged);
 
     // setup the scene
-    sceneManager.push_back(new Axes(E0,QMatrix4x4()));    // the global world coordinate system
-    sceneManager.push_back(new Plane(E0+4*E3,-E3));       // some plane
+    sceneManager.add(new Axes(E0,QMatrix4x4()));          // the global world coordinate system
+    sceneManager.add(new Plane(E0+4*E3,-E3));             // some plane
 
     // TODO: Assignment 1, Part 1
     //       Add here your own new 3d scene objects, e.g. cubes, hexahedra, etc.,
     //       analog to line 50 above and the respective Axes-class
     //
 
-    // TODO: Assignement 1, Part 2
-    //       Add here your own new scene object that represents a perspective camera.
-    //       Its draw-method should draw all relevant camera parameters, e.g. image plane, view axes, etc.
-    //
-
-    // TODO: Assignement 1, Part 3
-    //       Add to your perspective camera methods to project the other scene objects onto its image plane
-    //       and to draw the projected objects. These methods have to be invoked in Scene.cpp/Scene::draw.
-    //
+    sceneManager.add(new PerspectiveCamera(E0+3*E1));       // perspective camera looking along the negative x-axis
+    stereoRig = sceneManager.add(new StereoCamera(E0-3*E3)); // stereo rig looking along the z-axis
 
-    // TODO: Assignement 2, Part 1 - 3
-    //       Add here your own new scene object that represents a stereo camera pair.
-    //       - Part 1: Its draw-method should draw all relevant parameters of both cameras, e.g. image planes, view axes, etc.
-    //       - Part 1: Its projection method should project the other scene objects onto their image planes
-    //         and draw the projected objects.
-    //       - Part 2: Its reconstruction method should reconstruct the 3d geometry of the other scene objects from their stereo projections.
-    //       - Part 3: Its reconstruction method should reconstruct the 3d geometry of the other scene objects from misaligned stereo projections.
-    //       - This has to be used in Scene.cpp/Scene::draw.
-    //
+    // layers for the point clouds and everything derived from them
+    cloudLayer          = sceneManager.addGroup("point clouds");
+    kdLayer             = sceneManager.addGroup("kd planes");
+    octLayer            = sceneManager.addGroup("octree cubes");
+    segmentLayer        = sceneManager.addGroup("planes");
+    clusterLayer        = sceneManager.addGroup("clusters");
+    reconstructionLayer = sceneManager.addGroup("reconstruction");
 }
 
 //
-//  destructor has nothing to do, since it's under Qt control
+//  destructor frees the GL resources of the renderer, everything else is under Qt control
 //
 GLWidget::~GLWidget()
 {
+    makeCurrent();
+    renderer->releaseGL();
+    eyeDome.releaseGL();
+    doneCurrent();
+    delete octRoot;
 }
 
 //
@@ -109,13 +116,134 @@ void GLWidget::initializeGL()
 //
 void GLWidget::paintGL()
 {
-    // alle Puffer pro Frame löschen!
-    glClear(GL_COLOR_BUFFER_BIT
-            | GL_DEPTH_BUFFER_BIT
-            | GL_STENCIL_BUFFER_BIT);
+    {
+        PROFILE_SCOPE("paintGL");
+
+        // das Overlay (QPainter) verändert den GL-Zustand, daher pro Frame setzen
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_DEPTH_TEST);
+
+        // mit Eye-Dome-Lighting zuerst in dessen Framebuffer zeichnen (in Pixeln des Geräts)
+        const qreal ratio = devicePixelRatioF();
+        const bool  edl   = showEDL && eyeDome.begin(int(width() * ratio), int(height() * ratio));
+
+        // alle Puffer pro Frame löschen!
+        glClear(GL_COLOR_BUFFER_BIT
+                | GL_DEPTH_BUFFER_BIT
+                | GL_STENCIL_BUFFER_BIT);
+
+        renderer->setup();
+        renderer->releaseStaleBuffers();
+        sceneManager.draw(*renderer, COLOR_SCENE);
+        if (edl) eyeDome.end(renderer->getProjectionMatrix());
+        drawPicks();
+    }
+    Profiler::endFrame();
+
+    if (showProfiler || showMemory || !picks.isEmpty()) drawOverlay();
+}
+
+//
+//  draws the profiler's and/or the memory statistics on top of the scene
+//
+void GLWidget::drawOverlay()
+{
+    QStringList lines;
+    const auto section = [&lines](const QStringList& s) {
+        if (!lines.isEmpty()) lines << QString();
+        lines << s;
+    };
+    if (showProfiler)     section(profilerLines());
+    if (showMemory)       section(memoryLines());
+    if (!picks.isEmpty()) section(measureLines());
+    drawOverlayLines(lines);
+}
+
+//
+//  frame time, counters and stage timings of the profiler
+//
+QStringList GLWidget::profilerLines() const
+{
+    QStringList lines;
+    const std::vector<Profiler::SiteStats> stats = Profiler::siteStats();
+    for (const Profiler::SiteStats& s: stats)
+        if (s.name == "paintGL") lines << QString("frame %1 ms").arg(s.lastMs, 0, 'f', 2);
+    for (const auto& [name, value]: Profiler::frameCounters())
+        lines << QString("%1: %2").arg(name).arg(value);
+    lines << QString();
+    for (const Profiler::SiteStats& s: stats)
+        lines << QString("%1  %2 ms (mean %3 ms, %4x)").arg(s.name).arg(s.lastMs, 0, 'f', 2).arg(s.meanMs, 0, 'f', 2).arg(s.calls);
+    return lines;
+}
+
+//
+//  memory of the scene, the trees and the tracked categories
+//
+QStringList GLWidget::memoryLines() const
+{
+    const auto mb = [](qint64 bytes) { return QString::number(double(bytes) / (1 << 20), 'f', 1) + " MB"; };
+    const auto usage = [&mb](const QString& name, const MemoryUsage& m) {
+        return QString("%1: %2 used, %3 reserved").arg(name, mb(m.used), mb(m.reserved));
+    };
+
+    MemoryUsage clouds, kdTrees;
+    for (SceneHandle h: sceneManager.children(cloudLayer))
+        if (const PointCloud* pc = static_cast<const PointCloud*>(sceneManager.object(h))) {
+            clouds  += pc->memoryUsage();
+            kdTrees += pc->indexMemory();
+        }
 
-    renderer->setup();
-    sceneManager.draw(*renderer, COLOR_SCENE);
+    QStringList lines;
+    lines << usage(QString("point clouds (%1)").arg(sceneManager.childCount(cloudLayer)), clouds)
+          << usage("scene",        sceneManager.memoryUsage())
+          << usage("kd-trees",     kdTrees)
+          << usage("octree",       octMemory)
+          << QString();
+    for (const MemoryTracker::CategoryStats& c: MemoryTracker::stats())
+        lines << QString("%1: %2 (peak %3), %4 allocs, %5 frees").arg(c.name, mb(c.current), mb(c.peak)).arg(c.allocations).arg(c.releases);
+    return lines;
+}
+
+//
+//  global coordinates of the picked points, their distances and the angle at the middle one
+//
+QStringList GLWidget::measureLines() const
+{
+    // in double precision, so the readout keeps the precision of the original coordinates
+    QVector<GlobalPoint> g;
+    for (int i = 0; i < int(picks.size()); i++)
+        if (const PointCloud* pc = pickedCloud(i)) g.append(pc->globalPoint(picks[i].second));
+    const auto sub  = [](const GlobalPoint& a, const GlobalPoint& b) { return GlobalPoint{ a[0] - b[0], a[1] - b[1], a[2] - b[2] }; };
+    const auto dot  = [](const GlobalPoint& a, const GlobalPoint& b) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; };
+    const auto norm = [&dot](const GlobalPoint& a) { return std::sqrt(dot(a, a)); };
+
+    QStringList lines;
+    for (int i = 0; i < int(g.size()); i++)
+        lines << QString("P%1: %2 %3 %4").arg(i + 1).arg(g[i][0], 0, 'f', 4).arg(g[i][1], 0, 'f', 4).arg(g[i][2], 0, 'f', 4);
+    for (int i = 1; i < int(g.size()); i++)
+        lines << QString("distance P%1-P%2: %3").arg(i).arg(i + 1).arg(norm(sub(g[i], g[i - 1])), 0, 'f', 4);
+    if (g.size() == 3) {
+        const GlobalPoint u = sub(g[0], g[1]), v = sub(g[2], g[1]);
+        const double      c = dot(u, v) / std::max(norm(u) * norm(v), 1e-300);
+        lines << QString("angle P1-P2-P3: %1°").arg(qRadiansToDegrees(std::acos(std::clamp(c, -1.0, 1.0))), 0, 'f', 2);
+    }
+    return lines;
+}
+
+//
+//  draws lines of text on a dark box in the top left corner
+//
+void GLWidget::drawOverlayLines(const QStringList& lines)
+{
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    const int lineHeight = painter.fontMetrics().height();
+    painter.fillRect(QRect(8, 8, 480, lineHeight * int(lines.size()) + 12), QColor(0, 0, 0, 160));
+    painter.setPen(QColor(255, 255, 255));
+    for (int i = 0; i < int(lines.size()); i++)
+        painter.drawText(16, 14 + lineHeight * (i + 1) - painter.fontMetrics().descent(), lines[i]);
+    painter.end();
 }
 
 
@@ -184,7 +312,8 @@ void GLWidget::keyPressEvent(QKeyEvent * event)
     case Key_Z: {
         QMatrix4x4 A;
         A.translate(0.0f,0.0f,event->modifiers()&ShiftModifier?-0.1f:0.1f);
-        for (auto s: sceneManager) if (s->getType()==SceneObjectType::ST_POINT_CLOUD) s->affineMap(A);
+        sceneManager.transform(cloudLayer, A);
+        sceneManager.transform(reconstructionLayer, A);
         break;
     }
         // quit application
@@ -192,6 +321,70 @@ void GLWidget::keyPressEvent(QKeyEvent * event)
     case Key_Escape: QApplication::instance()->quit(); break;
         // for unhandled events call keyPressEvent of parent class
 
+    case Key_V:
+        downsamplePointCloud(event->modifiers()&ShiftModifier);
+        break;
+
+    case Key_O:
+        removeOutliers(event->modifiers()&ShiftModifier);
+        break;
+
+    case Key_N:                          // Normalen schätzen (PCA über kNN im KD-Tree)
+        // zur Sensorposition, d.h. zum Ursprung der Datei hin orientiert
+        if (PointCloud* pc = pointCloud()) estimateNormals(*pc, pc->getKdTree(), 16, pc->getFrame().toLocal({0.0, 0.0, 0.0}));
+        break;
+
+    case Key_P:                          // Ebenen segmentieren (RANSAC)
+        segmentPlanes();
+        break;
+
+    case Key_C:                          // euklidische Cluster extrahieren
+        extractClusters();
+        break;
+
+    case Key_I:                          // letzte an erster PointCloud ausrichten (ICP)
+        registerPointClouds();
+        break;
+
+    case Key_D:                          // dichte Stereo-Rekonstruktion (SGM), Shift: rechte Kamera verdrehen
+        reconstructStereo(event->modifiers()&ShiftModifier);
+        break;
+
+    case Key_F:                          // Profiler-Overlay an/aus, Shift: Chrome-Trace exportieren
+        if (event->modifiers()&ShiftModifier) exportTrace();
+        else {
+            showProfiler = !showProfiler;
+            Profiler::setEnabled(showProfiler);
+        }
+        break;
+
+    case Key_S:                          // PointCloud speichern, Shift: globale Koordinaten (double)
+        savePointCloud(event->modifiers()&ShiftModifier);
+        break;
+
+    case Key_A:                          // aktive PointCloud wechseln
+        nextPointCloud();
+        break;
+
+    case Key_K: {                        // Färbung der PointClouds durchschalten (Farbe, Normalen, Intensität, Höhe, Label)
+        const int mode = (int(renderer->getColorMode()) + 1) % (int(ColorMode::CM_LABEL) + 1);
+        renderer->setColorMode(ColorMode(mode));
+        break;
+    }
+
+    case Key_E:                          // Eye-Dome-Lighting an/aus, Shift: runde Splats an/aus
+        if (event->modifiers()&ShiftModifier) renderer->setSplatting(!renderer->getSplatting());
+        else                                  showEDL = !showEDL;
+        break;
+
+    case Key_Backspace:                  // Messung verwerfen
+        picks.clear();
+        break;
+
+    case Key_M:                          // Speicher-Overlay an/aus
+        showMemory = !showMemory;
+        break;
+
     case Qt::Key_T:
         showKd = !showKd;                // umschalten
         updateTreeVisualization();       // neu zeichnen
@@ -203,6 +396,20 @@ void GLWidget::keyPressEvent(QKeyEvent * event)
     update();
 }
 
+//
+//  reacts on mouse-press events
+//
+void GLWidget::mousePressEvent(QMouseEvent *event)
+{
+    prevMousePosition = event->pos();
+
+    // Ctrl + left-mouse-button picks the point under the cursor for measuring
+    if (event->button() == Qt::LeftButton && (event->modifiers() & ControlModifier)) {
+        pickPoint(event->pos());
+        update();
+    }
+}
+
 //
 //  reacts on mouse-move events
 //
@@ -241,7 +448,9 @@ void GLWidget::setPointSize(int size)
 {
     assert(size > 0);
     pointSize = size;
-    for (auto s: sceneManager) if (s->getType()==SceneObjectType::ST_POINT_CLOUD) reinterpret_cast<PointCloud*>(s)->setPointSize(unsigned(pointSize));
+    for (SceneHandle layer: {cloudLayer, reconstructionLayer})
+        for (SceneHandle h: sceneManager.children(layer))
+            static_cast<PointCloud*>(sceneManager.object(h))->setPointSize(unsigned(pointSize));
     update();
 }
 
@@ -256,104 +465,386 @@ void GLWidget::setPointSize(int size)
 // baut beide Baumstrukturen und hängt die PointCloud ans SceneManager.
 void GLWidget::openFileDialog()
 {
-    // Datei auswählen
-    const QString filePath = QFileDialog::getOpenFileName(
+    // Dateien auswählen, z.B. alle Kacheln einer Befliegung auf einmal
+    const QStringList filePaths = QFileDialog::getOpenFileNames(
+        this,
+        tr("Open PLY files"),
+        "./data",
+        tr("PLY Files (*.ply *.plyz)")
+        );
+    if (filePaths.isEmpty())
+        return;
+    PROFILE_SCOPE("openFileDialog");
+
+    bool loaded = false;
+    for (const QString& filePath: filePaths) {
+        // 0) Punktwolke anlegen und laden; weitere Scans bzw. Kacheln übernehmen den Koordinatenrahmen
+        //    der ersten PointCloud, damit ihre Lage zueinander erhalten bleibt (ICP, Abfragen über Kacheln)
+        //    Nicht lesbare Dateien werden gemeldet und übersprungen, die übrigen trotzdem geladen
+        PointCloud* pc = new PointCloud;
+        try {
+            pc->loadPLY(filePath);
+        } catch (const std::exception& e) {
+            delete pc;
+            QMessageBox::warning(this, "PLY", filePath + ": " + e.what());
+            continue;
+        }
+        cout << "number of points: " + to_string(pc->size()) << endl;
+        pc->setPointSize(static_cast<unsigned>(pointSize));
+        const std::vector<SceneHandle> clouds = sceneManager.children(cloudLayer);
+        if (!clouds.empty()) pc->moveToFrame(static_cast<PointCloud*>(sceneManager.object(clouds.front()))->getFrame());
+
+        // 1) Die PointCloud in die Szene hängen, sie wird die aktive; ihren KD-Tree baut sie bei Bedarf selbst
+        activeCloud  = sceneManager.add(pc, cloudLayer);
+        lastFilePath = filePath;
+        loaded       = true;
+    }
+    if (!loaded)
+        return;
+
+    // 2) Oct-Tree der aktiven PointCloud aufbauen, Szene bereinigen und _nur_ den gewählten Baum zeichnen
+    buildTrees(pointCloud());
+    updateTreeVisualization();
+
+    // 3) Neu zeichnen anstoßen
+    update();
+}
+
+// Schreibt die aufgezeichneten Zeiten als Chrome-Trace (chrome://tracing, Perfetto)
+void GLWidget::exportTrace()
+{
+    const QString filePath = QFileDialog::getSaveFileName(this, tr("Export trace"), "./trace.json", tr("Trace Files (*.json)"));
+    if (filePath.isEmpty())
+        return;
+    try {
+        Profiler::writeChromeTrace(filePath);
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, "Trace", e.what());
+    }
+}
+
+// Schreibt die aktuelle PointCloud (gefiltert, ausgedünnt, registriert) als PLY
+void GLWidget::savePointCloud(bool originalUnits)
+{
+    const PointCloud* pc = pointCloud();
+    if (!pc)
+        return;
+    const QString filePath = QFileDialog::getSaveFileName(
         this,
-        tr("Open PLY file"),
+        tr("Save PLY file"),
         "./data",
-        tr("PLY Files (*.ply)")
+        tr("PLY Files (*.ply);;Compressed PLY Files (*.plyz)")
         );
     if (filePath.isEmpty())
         return;
 
-    // 0) Punktwolke anlegen und laden
-    PointCloud* pc = new PointCloud;
-    pc->loadPLY(filePath);
-    pc->setPointSize(static_cast<unsigned>(pointSize));
+    PLYWriteOptions options;
+    options.encoding      = encodingForFile(filePath);
+    options.originalUnits = originalUnits;
+    try {
+        writePLY(filePath, *pc, {}, options);
+    } catch (const std::exception& e) {
+        QMessageBox::warning(this, "PLY", e.what());
+    }
+}
 
-    // 1) Punkte & Bounding-Box abrufen
+// Baut den Oct-Tree für die gegebene PointCloud neu auf (der alte wird freigegeben); ihr KD-Tree
+// wird hier schon gebaut, damit die Visualisierung und die erste Abfrage nicht darauf warten
+void GLWidget::buildTrees(const PointCloud* pc)
+{
+    delete octRoot; octRoot = nullptr;
+
+    // Punkte & Bounding-Box abrufen
     const QVector<QVector4D>& pts = *pc;
     int N = pc->size();
     QVector3D min3 = pc->getMin();
     QVector3D max3 = pc->getMax();
     QVector4D bbMin(min3, 1.0f), bbMax(max3, 1.0f);
 
-    // 2) KD‐Tree aufbauen
-    QVector<int> idxX(N), idxY(N), idxZ(N);
-    std::iota(idxX.begin(), idxX.end(), 0);
-    std::iota(idxY.begin(), idxY.end(), 0);
-    std::iota(idxZ.begin(), idxZ.end(), 0);
-
-    // sortiere idxX so, dass pts[idxX[i]].x monoton steigt
-    std::sort(idxX.begin(), idxX.end(),
-              [&](int a, int b){ return pts[a].x() < pts[b].x(); });
-    // sortiere idxY so, dass pts[idxY[i]].y monoton steigt
-    std::sort(idxY.begin(), idxY.end(),
-              [&](int a, int b){ return pts[a].y() < pts[b].y(); });
-    // sortiere idxZ so, dass pts[idxZ[i]].z monoton steigt
-    std::sort(idxZ.begin(), idxZ.end(),
-              [&](int a, int b){ return pts[a].z() < pts[b].z(); });
+    // KD‐Tree der PointCloud (sortiert die drei Index-Arrays vor und startet den Median-Split)
+    pc->getKdTree();
 
-    // jetzt den Median‐Split starten
-    kdRoot = buildKdTree(pts, idxX, idxY, idxZ,
-                         /*l=*/0, /*r=*/N-1, /*depth=*/0);
+    // Oct-Tree aufbauen
+    {
+        PROFILE_SCOPE("octree build");
+        QVector<int> allIdx(N);
+        std::iota(allIdx.begin(), allIdx.end(), 0);
 
+        octRoot = buildOctTree(pts, bbMin, bbMax, allIdx, /*depth=*/0, octTreeDepth);
+    }
 
-    // 3) Oct-Tree aufbauen
-    QVector<int> allIdx(N);
-    std::iota(allIdx.begin(), allIdx.end(), 0);
+    // Speicher des Oct-Trees fürs Overlay (ändert sich bis zum nächsten Aufbau nicht)
+    octMemory = octTreeMemory(octRoot);
 
-    octRoot = buildOctTree(pts, bbMin, bbMax, allIdx, /*depth=*/0, /*maxDepth=*/2);
+    // Visualisierungen der alten Bäume verwerfen, updateTreeVisualization legt sie neu an
+    sceneManager.clear(kdLayer);
+    sceneManager.clear(octLayer);
+    kdLevels .clear();
+    octLevels.clear();
+}
 
-    // 4) Die PointCloud zuerst in die Szene hängen
-    sceneManager.push_back(pc);
-    lastFilePath = filePath;
+// Entfernt Ausreißer aus der PointCloud (O: statistisch, Shift+O: Radius),
+// skaliert sie anhand der bereinigten Bounding-Box neu und baut die Bäume neu auf.
+void GLWidget::removeOutliers(bool radius)
+{
+    PointCloud* pc = pointCloud();
+    if (!pc)
+        return;
 
-    // 5) Dann Szene bereinigen und _nur_ den gewählten Baum zeichnen
+    float       r  = downsampleCellSize * (pc->getMax() - pc->getMin()).length();
+    qsizetype   removed = radius ? removeRadiusOutliers     (*pc, pc->getKdTree(), r, /*minNeighbors=*/4)
+                                 : removeStatisticalOutliers(*pc, pc->getKdTree());
+    cout << "removed " << removed << " outliers" << endl;
+
+    // mehrere PointClouds teilen ihren Rahmen, dann bleibt der Maßstab
+    if (sceneManager.childCount(cloudLayer) == 1) pc->rescale();
+    sceneManager.markDirty(pointCloudNode());
+    sceneManager.clear(segmentLayer);
+    sceneManager.clear(clusterLayer);
+    picks.clear();                                          // Indizes der Punkte sind verschoben
+    buildTrees(pc);
     updateTreeVisualization();
+}
 
-    // 6) Neu zeichnen anstoßen
-    update();
+// Segmentiert bis zu fünf Ebenen aus der PointCloud und ersetzt die zuvor segmentierten
+void GLWidget::segmentPlanes()
+{
+    PointCloud* pc = pointCloud();
+    if (!pc || pc->isEmpty())
+        return;
+
+    // Schwellwert relativ zur Diagonale der Bounding-Box, mindestens 1% der Punkte pro Ebene
+    PlaneRansacParams params;
+    params.threshold  = 0.5f * downsampleCellSize * (pc->getMax() - pc->getMin()).length();
+    params.minInliers = std::max<int>(3, int(pc->size() / 100));
+
+    // Label je Punkt: Index der Ebene, -1 für keine
+    sceneManager.clear(segmentLayer);
+    QVector<int> labels(pc->size(), -1);
+    int          plane = 0;
+    for (const PlaneSegment& seg: ::segmentPlanes(*pc, params)) {
+        cout << "plane " << seg.plane[0] << " " << seg.plane[1] << " " << seg.plane[2] << " " << seg.plane[3]
+             << " with " << seg.inliers.size() << " inliers" << endl;
+        sceneManager.add(seg.toPlane(), segmentLayer);
+        for (int i: seg.inliers) labels[i] = plane;
+        plane++;
+    }
+    pc->setLabels(std::move(labels));
 }
 
+// Extrahiert die euklidischen Cluster der PointCloud und ersetzt die Boxen der zuvor extrahierten
+void GLWidget::extractClusters()
+{
+    PointCloud* pc = pointCloud();
+    if (!pc)
+        return;
 
+    // Abstand relativ zur Diagonale der Bounding-Box, mindestens 0.1% der Punkte pro Cluster
+    ClusterParams params;
+    params.tolerance = 2.0f * downsampleCellSize * (pc->getMax() - pc->getMin()).length();
+    params.minSize   = std::max<int>(1, int(pc->size() / 1000));
+
+    sceneManager.clear(clusterLayer);
+    QVector<int>         labels;
+    std::vector<Cluster> clusters = euclideanClusters(*pc, pc->getKdTree(), params, &labels);
+    cout << clusters.size() << " clusters" << endl;
+    for (const Cluster& c: clusters) sceneManager.add(c.toHexahedron(), clusterLayer);
+    pc->setLabels(std::move(labels));
+}
 
+// Richtet die zuletzt geladene PointCloud per ICP (Punkt-zu-Ebene) an der zuerst geladenen aus
+void GLWidget::registerPointClouds()
+{
+    const std::vector<SceneHandle> clouds = sceneManager.children(cloudLayer);
+    if (clouds.size() < 2)
+        return;
 
+    // Voxel-Pyramide und Korrespondenzabstand relativ zur Diagonale der Bounding-Box
+    PointCloud* source = static_cast<PointCloud*>(sceneManager.object(clouds.back()));
+    PointCloud* target = static_cast<PointCloud*>(sceneManager.object(clouds.front()));
+    float       diag   = (target->getMax() - target->getMin()).length();
+    IcpParams   params;
+    params.voxelSize   = 2.0f * downsampleCellSize * diag;
+    params.maxDistance = 4.0f * downsampleCellSize * diag;
+
+    IcpResult result = alignIcp(*source, *target, params);
+    cout << "ICP: " << result.iterations << " iterations, rmse " << result.rmse
+         << (result.converged ? "" : " (not converged)") << endl;
+    source->affineMap(result.transform);
+    sceneManager.markDirty(clouds.back());
+    buildTrees(pointCloud());
+    updateTreeVisualization();
+}
 
-// Löscht alle alten Baum-Ebenen (Planes & Cubes) und zeichnet
-// genau einen Baum (KD oder Oct) abhängig von showKd.
-void GLWidget::updateTreeVisualization()
+// Rendert ein VGA-Bildpaar der PointCloud mit der Stereokamera, berechnet die Disparitäten
+// per SGM und hängt die Rekonstruktion (ersetzt die vorherige) in die Szene
+void GLWidget::reconstructStereo(bool toggleMisalignment)
 {
-    // 1) Entferne alle bisherigen Ebenen-Objekte
-    for (auto it = sceneManager.begin(); it != sceneManager.end(); )
-    {
-        SceneObject* obj = *it;
-        SceneObjectType t = obj->getType();
-        if (t == SceneObjectType::ST_PLANE || t == SceneObjectType::ST_CUBE)
-        {
-            delete obj;
-            it = sceneManager.erase(it);
+    StereoCamera* cam = static_cast<StereoCamera*>(sceneManager.object(stereoRig));
+    PointCloud*   pc  = pointCloud();
+    if (!pc || !cam)
+        return;
+
+    if (toggleMisalignment) {
+        QMatrix4x4 R;
+        if (cam->getMisalignment().isIdentity()) {
+            R.rotate(-3.0f, 0.0f, 1.0f, 0.0f);
+            R.rotate( 1.0f, 1.0f, 0.0f, 0.0f);
+            R.rotate( 2.0f, 0.0f, 0.0f, 1.0f);
         }
-        else
-        {
-            ++it;
+        cam->setMisalignment(R);
+    }
+
+    const int W = 640, H = 480;
+    QImage left, right;
+    cam->renderImages(*pc, W, H, left, right);
+
+    StereoParams params;
+    params.numDisparities = 128;
+    PointCloud* rec = nullptr;
+    if (cam->getMisalignment().isIdentity())
+        rec = cam->reconstructDense(left, right, params);
+    else {
+        // einmalige Kalibrierung aus Punktkorrespondenzen, danach nur noch die LUT-Warps
+        if (!cam->isCalibrated()) {
+            QVector<QVector2D> l, r;
+            cam->imageCorrespondences(*pc, W, H, 2000, l, r);
+            if (!cam->calibrate(l, r, W, H)) {
+                cout << "stereo pair cannot be rectified" << endl;
+                return;
+            }
         }
+        rec = cam->reconstructRectified(left, right, params);
     }
 
-    // 2) Bounding-Box der geladenen PointCloud neu berechnen
-    PointCloud* pc = static_cast<PointCloud*>(sceneManager.back());
-    QVector3D mn = pc->getMin(), mx = pc->getMax();
-    QVector4D bbMin(mn, 1.0f), bbMax(mx, 1.0f);
+    sceneManager.clear(reconstructionLayer);
+    sceneManager.add(rec, reconstructionLayer);
+    cout << "reconstructed " << rec->size() << " points" << endl;
+}
 
-    // 3) Zeichne entweder KD-Tree-Ebenen oder Oct-Tree-Würfel
-    if (showKd)
-    {
-        visualizeKdTree(kdRoot, /*depth=*/0, /*maxDepth=*/3, bbMin, bbMax);
-    }
-    else
-    {
-        visualizeOctTree(octRoot, /*depth=*/0, /*maxDepth=*/2, sceneManager);
+SceneHandle GLWidget::pointCloudNode() const
+{
+    if (sceneManager.isValid(activeCloud)) return activeCloud;
+    const std::vector<SceneHandle> clouds = sceneManager.children(cloudLayer);
+    return clouds.empty() ? SceneHandle() : clouds.back();
+}
+
+PointCloud* GLWidget::pointCloud() const
+{
+    return static_cast<PointCloud*>(sceneManager.object(pointCloudNode()));
+}
+
+// Pickt den Punkt unter pos: Kegel vom Auge durch die Pixelmitte, so breit wie ein Punkt auf dem
+// Bildschirm (mindestens pickTolerance Pixel), durch das BVH der Szene und die kd-Trees der Wolken.
+// Splats werden mit der Entfernung kleiner, haben also überall denselben Radius in der Welt; der
+// Kegel ist dann mindestens so breit wie dieser.
+void GLWidget::pickPoint(const QPoint& pos)
+{
+    const float x      = 2.0f * (float(pos.x()) + 0.5f) / float(width())  - 1.0f;
+    const float y      = 1.0f - 2.0f * (float(pos.y()) + 0.5f) / float(height());
+    const float ratio  = float(devicePixelRatioF());
+    const float radius = renderer->getSplatting() ? pickTolerance : std::max(0.5f * float(pointSize) / ratio, pickTolerance);
+    PickRay     ray    = PickRay::fromMatrix(renderer->getRenderMatrix(), x, y, 2.0f * radius / float(width()));
+    if (renderer->getSplatting())
+        ray.radius = std::max(ray.radius, renderer->splatRadius(float(pointSize), int(float(height()) * ratio)));
+
+    const auto [cloud, index] = sceneManager.pick(ray);
+    if (index < 0) return;
+    if (picks.size() == 3) picks.clear();       // nächste Messung beginnen
+    picks.append({ cloud, index });
+}
+
+const PointCloud* GLWidget::pickedCloud(int i) const
+{
+    const SceneObject* obj = sceneManager.object(picks[i].first);
+    if (!obj || obj->getType() != SceneObjectType::ST_POINT_CLOUD) return nullptr;
+    const PointCloud* pc = static_cast<const PointCloud*>(obj);
+    return picks[i].second < pc->size() ? pc : nullptr;
+}
+
+// Gepickte Punkte als Marker und ihre Verbindungen, ohne Tiefentest, damit sie nicht in der Wolke verschwinden
+void GLWidget::drawPicks() const
+{
+    QVector<QVector3D> p;
+    for (int i = 0; i < int(picks.size()); i++)
+        if (const PointCloud* pc = pickedCloud(i)) p.append((*pc)[picks[i].second].toVector3D());
+    if (p.isEmpty()) return;
+
+    glDisable(GL_DEPTH_TEST);
+    for (int i = 0; i < int(p.size()); i++) {
+        if (i > 0) renderer->renderLine(p[i - 1], p[i], COLOR_PICK, 2.0f);
+        renderer->renderPoint(p[i], COLOR_PICK, float(pointSize) + 6.0f);
     }
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Macht die nächste geladene PointCloud zur aktiven und baut die Visualisierung ihrer Bäume auf
+void GLWidget::nextPointCloud()
+{
+    const std::vector<SceneHandle> clouds = sceneManager.children(cloudLayer);
+    if (clouds.size() < 2)
+        return;
+
+    const auto it = std::find(clouds.begin(), clouds.end(), pointCloudNode());
+    activeCloud   = (it == clouds.end() || it + 1 == clouds.end()) ? clouds.front() : *(it + 1);
+    cout << "active point cloud " << (std::find(clouds.begin(), clouds.end(), activeCloud) - clouds.begin()) + 1
+         << " of " << clouds.size() << endl;
+    sceneManager.clear(segmentLayer);
+    sceneManager.clear(clusterLayer);
+    buildTrees(pointCloud());
+    updateTreeVisualization();
+}
+
+// Ersetzt die PointCloud in der Szene durch eine ausgedünnte Version
+// (V: Voxel-Grid, Shift+V: Poisson-Disk) und baut die Bäume dafür neu auf.
+void GLWidget::downsamplePointCloud(bool poisson)
+{
+    PointCloud* pc = pointCloud();
+    if (!pc)
+        return;
+
+    // Zellgröße relativ zur Diagonale der Bounding-Box
+    float       cell = downsampleCellSize * (pc->getMax() - pc->getMin()).length();
+    if (cell <= 0.0f)
+        return;
+
+    PointCloud* thin = poisson ? poissonDiskDownsample(*pc, cell)
+                               : voxelGridDownsample (*pc, cell);
+    cout << "downsampled " << pc->size() << " -> " << thin->size() << " points" << endl;
+
+    sceneManager.replace(pointCloudNode(), thin);           // gibt pc frei
+    sceneManager.clear(segmentLayer);
+    sceneManager.clear(clusterLayer);
+    picks.clear();                                          // Indizes beziehen sich auf pc
+    buildTrees(thin);
+    updateTreeVisualization();
+}
+
+
+
+
+
+// Blendet genau einen Baum (KD oder Oct) abhängig von showKd bis zur Tiefe visualDepth ein. Jedes
+// Level ist ein eigenes, einmal angelegtes Objekt; Umschalten von Baum oder Tiefe schaltet danach nur
+// die Sichtbarkeit der gecachten Level, nur noch nie gezeigte Level werden neu erzeugt.
+void GLWidget::updateTreeVisualization()
+{
+    // 1) Sichtbarkeit der beiden Baum-Ebenen umschalten
+    sceneManager.setVisible(kdLayer,   showKd);
+    sceneManager.setVisible(octLayer, !showKd);
+
+    if (!pointCloud())
+        return;
+
+    // 2) fehlende Level des gezeigten Baums anlegen (leere Level bekommen ein ungültiges Handle)
+    std::vector<SceneHandle>& levels = showKd ? kdLevels : octLevels;
+    while (int(levels.size()) <= visualDepth)
+        levels.push_back(showKd ? visualizeKdLevel (int(levels.size()))
+                                : visualizeOctLevel(int(levels.size())));
+
+    // 3) Level bis visualDepth ein-, tiefere ausblenden
+    for (size_t level = 0; level < levels.size(); level++)
+        sceneManager.setVisible(levels[level], int(level) <= visualDepth);
 
     // 4) Anzeige aktualisieren
     update();
@@ -369,11 +860,12 @@ void GLWidget::checkBoxClicked()
 }
 
 //
-// controls spin box changes
+// controls spin box changes: depth of the tree visualization
 //
-void GLWidget::spinBoxValueChanged(int)
+void GLWidget::spinBoxValueChanged(int value)
 {
-    QMessageBox::warning(this, "Feature" ,"ups hier fehlt noch was");
+    visualDepth = qMax(0, value);
+    updateTreeVisualization();
 }
 
 
@@ -388,23 +880,17 @@ void GLWidget::radioButtonClicked()
 
 
 // verbindet den Member mit der freien Funktion aus KdTree.cpp
-void GLWidget::visualizeKdTree(KdNode* node,
-                               int depth,
-                               int maxDepth,
-                               QVector4D bbMin,
-                               QVector4D bbMax)
+SceneHandle GLWidget::visualizeKdLevel(int level)
 {
-    // ruft die freie Funktion auf
-    ::visualizeKdTree(node, depth, maxDepth, bbMin, bbMax, sceneManager);
+    const PointCloud* pc = pointCloud();
+    QVector4D bbMin(pc->getMin(), 1.0f), bbMax(pc->getMax(), 1.0f);
+    return ::visualizeKdTree(pc->getKdTree(), level, level, bbMin, bbMax, sceneManager, kdLayer);
 }
 
 
 
 // verbindet den Member mit der freien Funktion aus OctTree.cpp
-void GLWidget::visualizeOctTree(OctNode* node,
-                                int depth,
-                                int maxDepth,
-                                SceneManager& scene)
+SceneHandle GLWidget::visualizeOctLevel(int level)
 {
-    ::visualizeOctTree(node, depth, maxDepth, scene);
+    return ::visualizeOctTree(octRoot, level, level, sceneManager, octLayer);
 }
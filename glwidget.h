@@ -7,14 +7,18 @@
 #pragma once
 
 #include <QOpenGLWidget>
+#include <QPair>
 
 #include "RenderCamera.h"           // containes declaration of Renderer
+#include "EyeDomeLighting.h"
 #include "SceneManager.h"       // containes declaration of Scene Manager
 
 
 #include "KdTree.h"
 #include "OctTree.h"
 
+class PointCloud;
+
 class GLWidget : public QOpenGLWidget
 {
     Q_OBJECT
@@ -22,39 +26,116 @@ private:
     // Toggle zwischen KD-Tree und Oct-Tree (true = KD, false = Oct)
     bool        showKd        = true;
 
+    // Profiler aktiv und als Overlay eingeblendet (Taste F)
+    bool        showProfiler  = false;
+
+    // Speicherverbrauch als Overlay eingeblendet (Taste M)
+    bool        showMemory    = false;
+
+    // Eye-Dome-Lighting der Szene (Taste E); Shift+E schaltet die runden Splats des Renderers ein (anfangs aus)
+    bool            showEDL   = true;
+    EyeDomeLighting eyeDome;
+
     // Szene und Render-Steuerung
     int         pointSize;                // Punktgröße in der PointCloud
     SceneManager sceneManager;            // verwaltet alle Szeneobjekte
 
-    // Wurzeln der Bäume
-    KdNode*     kdRoot        = nullptr;  // KD-Tree
-    OctNode*    octRoot       = nullptr;  // Oct-Tree
+    // Oct-Tree der aktiven PointCloud (nur zur Visualisierung) und sein Speicher; den KD-Tree
+    // besitzt jede PointCloud selbst (PointCloud::getKdTree)
+    OctNode*    octRoot       = nullptr;
+    MemoryUsage octMemory;
 
     // zuletzt geladene Datei merken (erlaubt Umschalten ohne Neuladen)
     QString     lastFilePath;
 
-    // Zeichnet je nach showKd nur den ausgewählten Baum
+    // Zellgröße der Ausdünnung relativ zur Diagonale der Bounding-Box
+    const float downsampleCellSize = 0.005f;
+
+    // Tiefe des Oct-Trees bzw. maximale angezeigte Tiefe der Baum-Visualisierungen (Spin-Box)
+    const int   octTreeDepth  = 6;
+    int         visualDepth   = 3;
+
+    // gecachte Visualisierung je Level (ein InstancedBoxes-Objekt pro Level, ungültig für leere Level)
+    std::vector<SceneHandle> kdLevels, octLevels;
+
+    // Ebenen des Szenegraphen: geladene PointClouds, Baum-Visualisierungen und die von
+    // segmentPlanes, extractClusters bzw. reconstructStereo angelegten Objekte
+    SceneHandle cloudLayer, kdLayer, octLayer, segmentLayer, clusterLayer, reconstructionLayer;
+    SceneHandle stereoRig;                // Stereokamera
+
+    // aktive PointCloud, auf die Filter, Segmentierung und Baum-Visualisierung wirken (Taste A wechselt,
+    // sonst die zuletzt geladene; Rekonstruktionen zählen nicht) bzw. ihr Knoten
+    SceneHandle activeCloud;
+    SceneHandle pointCloudNode() const;
+    PointCloud* pointCloud() const;
+
+    // Wechselt die aktive PointCloud zur nächsten geladenen
+    void nextPointCloud();
+
+    // Messung (Strg+Linksklick pickt, Backspace verwirft): bis zu drei gepickte Punkte als (Knoten der
+    // PointCloud, Punktindex); zwei ergeben den Abstand, drei zusätzlich den Winkel am mittleren Punkt
+    QVector<QPair<SceneHandle, int>> picks;
+    const float pickTolerance = 3.0f;     // Mindestradius des Pick-Kegels in Pixeln
+
+    // Pickt den Punkt unter pos per Kegel durch BVH und kd-Trees und hängt ihn an die Messung an
+    void pickPoint(const QPoint& pos);
+
+    // PointCloud des i-ten gepickten Punktes, nullptr, falls sie gelöscht oder verkleinert wurde
+    const PointCloud* pickedCloud(int i) const;
+
+    // Zeichnet die gepickten Punkte und ihre Verbindungslinien über die Szene
+    void drawPicks() const;
+
+    // Blendet je nach showKd nur den ausgewählten Baum ein (und legt dessen Visualisierung bei Bedarf an)
     void updateTreeVisualization();
 
-    // Rekursive Visualisierung der ersten drei Ebenen des KD-Trees
-    void visualizeKdTree(KdNode* node,
-                         int depth,
-                         int maxDepth,
-                         QVector4D bbMin,
-                         QVector4D bbMax);
-
-    // Rekursive Visualisierung der ersten drei Ebenen des Oct-Trees
-    void visualizeOctTree(OctNode*       node,
-                          int            depth,
-                          int            maxDepth,
-                          SceneManager&  scene);
+    // Baut den Oct-Tree für die PointCloud neu auf und verwirft die Visualisierungen der Bäume
+    void buildTrees(const PointCloud* pc);
+
+    // Dünnt die PointCloud aus (Voxel-Grid bzw. Poisson-Disk)
+    void downsamplePointCloud(bool poisson);
+
+    // Entfernt Ausreißer (statistisch bzw. über Radius) und skaliert neu
+    void removeOutliers(bool radius);
+
+    // Segmentiert Ebenen per RANSAC und hängt sie als Planes in die Szene
+    void segmentPlanes();
+
+    // Zerlegt die PointCloud in euklidische Cluster und zeigt deren Bounding-Boxen
+    void extractClusters();
+
+    // Richtet die zuletzt geladene PointCloud per ICP an der zuerst geladenen aus
+    void registerPointClouds();
+
+    // Rendert die PointCloud mit der Stereokamera und rekonstruiert sie dicht per SGM;
+    // toggleMisalignment verdreht die rechte Kamera (bzw. richtet sie wieder aus), dann wird
+    // über geschätzte Fundamentalmatrix und Rektifizierung rekonstruiert
+    void reconstructStereo(bool toggleMisalignment);
+
+    // Zeichnet die Statistiken von Profiler (Frame-Zeit, Zähler, Stufen-Zeiten) bzw. Speicher über die Szene
+    void        drawOverlay     ();
+    void        drawOverlayLines(const QStringList& lines);
+    QStringList profilerLines   () const;
+    QStringList memoryLines     () const;
+    QStringList measureLines    () const;       // globale Koordinaten (double), Abstände und Winkel der Messung
+
+    // Exportiert die Zeiten des Profilers als Chrome-Trace-JSON
+    void exportTrace();
+
+    // Speichert die PointCloud als binäres (.ply) bzw. komprimiertes (.plyz) PLY, mit Normalen;
+    // originalUnits schreibt die globalen Koordinaten (double) statt lokaler mit ihrem Rahmen
+    void savePointCloud(bool originalUnits);
+
+    // Visualisierung genau eines Levels des KD- bzw. Oct-Trees
+    SceneHandle visualizeKdLevel (int level);
+    SceneHandle visualizeOctLevel(int level);
 public:
     GLWidget(QWidget* parent = nullptr);
     ~GLWidget() Q_DECL_OVERRIDE;
 
 public slots:
     // button + slider controls
-    void openFileDialog     ();    // opens and loads a PLY file to a point cloud
+    void openFileDialog     ();    // opens and loads PLY files to point clouds
     void radioButtonClicked ();    // handles radio buttons
     void checkBoxClicked    ();    // handle check boxes
     void spinBoxValueChanged(int); // handles spin  boxes changes
@@ -71,6 +152,7 @@ protected:
     void keyPressEvent  (QKeyEvent   *event) Q_DECL_OVERRIDE;   // handles key-press   events
     void keyReleaseEvent(QKeyEvent   *event) Q_DECL_OVERRIDE;   // handles key-release events
     void wheelEvent     (QWheelEvent *event) Q_DECL_OVERRIDE;   // handles wheel       events
+    void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;   // handles mouse-press events
     void mouseMoveEvent (QMouseEvent *event) Q_DECL_OVERRIDE;   // handles mouse-move  events
 
 private slots: